@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* CullKernelTest checks every CullKernel implementation the CPU supports
+ * against CullInfo, which is the reference, and with --bench times them.
+ *
+ * usage: xpmp-cull-test [--bench] [--count N] [--iterations N]
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CullInfo.h"
+#include "CullKernel.h"
+
+using namespace std;
+
+static const CullKernel::Isa kAllIsas[] = {
+	CullKernel::Isa::Scalar,
+	CullKernel::Isa::SSE2,
+	CullKernel::Isa::AVX2,
+	CullKernel::Isa::NEON,
+};
+
+struct Camera {
+	float	modelView[16];
+	float	projection[16];
+};
+
+// builds a camera in the same way the simulator does - see StubXPLM.
+static Camera
+makeCamera(float x, float y, float z, float headingDeg, float pitchDeg, float fovDeg, float zFar)
+{
+	Camera cam = {};
+	const float h = headingDeg * static_cast<float>(M_PI / 180.0);
+	const float p = pitchDeg * static_cast<float>(M_PI / 180.0);
+	const float ch = cos(h), sh = sin(h);
+	const float cp = cos(p), sp = sin(p);
+	const float r[9] = {
+		ch,		sp * sh,	-cp * sh,
+		0.0f,	cp,			sp,
+		sh,		-sp * ch,	cp * ch,
+	};
+	for (int col = 0; col < 3; col++) {
+		for (int row = 0; row < 3; row++) {
+			cam.modelView[col * 4 + row] = r[col * 3 + row];
+		}
+	}
+	for (int row = 0; row < 3; row++) {
+		cam.modelView[12 + row] = -(r[row] * x + r[3 + row] * y + r[6 + row] * z);
+	}
+	cam.modelView[15] = 1.0f;
+
+	const float zNear = 1.0f;
+	const float f = static_cast<float>(1.0 / tan((fovDeg * M_PI / 180.0) / 2.0));
+	cam.projection[0] = f / (16.0f / 9.0f);
+	cam.projection[5] = f;
+	cam.projection[10] = (zFar + zNear) / (zNear - zFar);
+	cam.projection[11] = -1.0f;
+	cam.projection[14] = (2.0f * zFar * zNear) / (zNear - zFar);
+	return cam;
+}
+
+/* returns true if the sphere at x,y,z is so close to a clip plane that
+ * rounding could legitimately put it either side.
+ */
+static bool
+isBorderline(const CullKernelParams &params, float x, float y, float z, float radius)
+{
+	const float *mv = params.modelView;
+	double e[4];
+	for (int row = 0; row < 4; row++) {
+		e[row] = double(x) * mv[row] + double(y) * mv[row + 4] + double(z) * mv[row + 8] + mv[row + 12];
+	}
+	if (e[3] != 0.0) {
+		e[0] /= e[3];
+		e[1] /= e[3];
+		e[2] /= e[3];
+	}
+	for (const auto &clip: params.clip) {
+		const double d = e[0] * clip[0] + e[1] * clip[1] + e[2] * clip[2] + clip[3] + radius;
+		if (fabs(d) < 1e-2) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static int
+checkIsa(CullKernel::Isa isa, const CullInfo &cullInfo, const CullKernelParams &params,
+         const vector<float> &x, const vector<float> &y, const vector<float> &z,
+         const vector<float> &radius)
+{
+	const size_t count = x.size();
+	vector<float> distanceSqr(count);
+	vector<uint8_t> visibility(count), lod(count);
+	// an empty radius vector tests the kernel's default radius.
+	CullKernel::runWith(isa, params, x.data(), y.data(), z.data(), radius.empty() ? nullptr : radius.data(), count,
+	                    distanceSqr.data(), visibility.data(), lod.data());
+
+	int failures = 0;
+	for (size_t i = 0; i < count; i++) {
+		const float r = radius.empty() ? params.radius : radius[i];
+		const float refDistanceSqr = cullInfo.SphereDistanceSqr(x[i], y[i], z[i]);
+		const bool refInFrustum = cullInfo.SphereIsVisible(x[i], y[i], z[i], r);
+		const bool refInRange = params.visibilityDistanceSqr <= 0.0f || !(refDistanceSqr > params.visibilityDistanceSqr);
+		const uint8_t refLod = (refDistanceSqr > params.fullDetailDistanceSqr) ? CullLod_Reduced : CullLod_Full;
+
+		// targets that fuse multiply-adds may differ in the last bit or so.
+		const bool distanceOk = fabs(distanceSqr[i] - refDistanceSqr) <= 1e-6f * fabs(refDistanceSqr);
+		const bool exact = distanceSqr[i] == refDistanceSqr;
+		const bool inFrustum = (visibility[i] & CullVisibility_InFrustum) != 0;
+		const bool inRange = (visibility[i] & CullVisibility_InRange) != 0;
+
+		bool ok = distanceOk;
+		if (inFrustum != refInFrustum && !isBorderline(params, x[i], y[i], z[i], r)) {
+			ok = false;
+		}
+		if ((inRange != refInRange || lod[i] != refLod) && exact) {
+			ok = false;
+		}
+		if (!ok) {
+			if (failures < 10) {
+				fprintf(stderr, "  %s mismatch at (%g, %g, %g): distSqr %g vs %g, frustum %d vs %d, range %d vs %d, lod %d vs %d\n",
+					CullKernel::getIsaName(isa), x[i], y[i], z[i],
+					distanceSqr[i], refDistanceSqr, inFrustum, refInFrustum, inRange, refInRange, lod[i], refLod);
+			}
+			failures++;
+		}
+	}
+	return failures;
+}
+
+static void
+makePoints(mt19937 &rng, size_t count, float extent, vector<float> &x, vector<float> &y, vector<float> &z)
+{
+	uniform_real_distribution<float> horizontal(-extent, extent);
+	uniform_real_distribution<float> vertical(-100.0f, 12000.0f);
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		x[i] = horizontal(rng);
+		y[i] = vertical(rng);
+		z[i] = horizontal(rng);
+	}
+}
+
+static int
+runEquivalence(size_t count)
+{
+	mt19937 rng(8643);
+	uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	int failures = 0;
+	for (int scenario = 0; scenario < 32; scenario++) {
+		const Camera cam = makeCamera(
+			(unit(rng) - 0.5f) * 20000.0f, unit(rng) * 3000.0f, (unit(rng) - 0.5f) * 20000.0f,
+			unit(rng) * 360.0f, (unit(rng) - 0.5f) * 90.0f,
+			30.0f + unit(rng) * 60.0f, 20000.0f + unit(rng) * 80000.0f);
+		const CullInfo cullInfo(cam.modelView, cam.projection);
+
+		CullKernelParams params;
+		cullInfo.getKernelParams(params);
+		params.radius = unit(rng) * 100.0f;
+		const float fullDetail = unit(rng) * 10000.0f;
+		params.fullDetailDistanceSqr = fullDetail * fullDetail;
+		// every fourth scenario has unlimited visibility
+		const float visibility = (scenario % 4 == 0) ? 0.0f : unit(rng) * 50000.0f;
+		params.visibilityDistanceSqr = visibility * visibility;
+
+		vector<float> x, y, z;
+		// an odd count, so the SIMD kernels' tails are exercised too.
+		makePoints(rng, count | 1, 100000.0f, x, y, z);
+		// and every other scenario has a radius per plane.
+		vector<float> radius;
+		if (scenario % 2 == 1) {
+			radius.resize(x.size());
+			for (auto &r: radius) {
+				r = unit(rng) * 100.0f;
+			}
+		}
+		for (auto isa: kAllIsas) {
+			if (CullKernel::isSupported(isa)) {
+				failures += checkIsa(isa, cullInfo, params, x, y, z, radius);
+			}
+		}
+	}
+	return failures;
+}
+
+static void
+runBenchmark(size_t count, int iterations)
+{
+	mt19937 rng(1);
+	const Camera cam = makeCamera(0.0f, 100.0f, 0.0f, 45.0f, -5.0f, 60.0f, 100000.0f);
+	const CullInfo cullInfo(cam.modelView, cam.projection);
+	CullKernelParams params;
+	cullInfo.getKernelParams(params);
+	params.radius = 50.0f;
+	params.fullDetailDistanceSqr = 3000.0f * 3000.0f;
+	params.visibilityDistanceSqr = 40000.0f * 40000.0f;
+
+	vector<float> x, y, z;
+	makePoints(rng, count, 100000.0f, x, y, z);
+	vector<float> distanceSqr(count);
+	vector<uint8_t> visibility(count), lod(count);
+
+	printf("%zu planes, %d iterations\n", count, iterations);
+	printf("  %-16s %10s %10s\n", "implementation", "ms/batch", "ns/plane");
+
+	auto report = [&](const char *name, double totalMs) {
+		const double perBatch = totalMs / iterations;
+		printf("  %-16s %10.4f %10.3f\n", name, perBatch, (perBatch * 1e6) / count);
+	};
+
+	// the original one-plane-at-a-time CullInfo calls, as the baseline.
+	{
+		const auto start = chrono::steady_clock::now();
+		for (int it = 0; it < iterations; it++) {
+			for (size_t i = 0; i < count; i++) {
+				distanceSqr[i] = cullInfo.SphereDistanceSqr(x[i], y[i], z[i]);
+				visibility[i] = cullInfo.SphereIsVisible(x[i], y[i], z[i], params.radius) ? 1 : 0;
+			}
+		}
+		const chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+		report("CullInfo", elapsed.count());
+	}
+	for (auto isa: kAllIsas) {
+		if (!CullKernel::isSupported(isa)) {
+			continue;
+		}
+		const auto start = chrono::steady_clock::now();
+		for (int it = 0; it < iterations; it++) {
+			CullKernel::runWith(isa, params, x.data(), y.data(), z.data(), nullptr, count,
+			                    distanceSqr.data(), visibility.data(), lod.data());
+		}
+		const chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+		report(CullKernel::getIsaName(isa), elapsed.count());
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	bool bench = false;
+	size_t count = 4096;
+	int iterations = 200;
+	for (int i = 1; i < argc; i++) {
+		const string arg = argv[i];
+		if (arg == "--bench") {
+			bench = true;
+		} else if (arg == "--count" && i + 1 < argc) {
+			count = static_cast<size_t>(atol(argv[++i]));
+		} else if (arg == "--iterations" && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [--bench] [--count N] [--iterations N]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	printf("cull kernels:");
+	for (auto isa: kAllIsas) {
+		if (CullKernel::isSupported(isa)) {
+			printf(" %s", CullKernel::getIsaName(isa));
+		}
+	}
+	printf(" (active: %s)\n", CullKernel::getIsaName(CullKernel::getActiveIsa()));
+
+	const int failures = runEquivalence(count);
+	if (failures != 0) {
+		printf("FAILED: %d mismatches against CullInfo\n", failures);
+		return 1;
+	}
+	printf("all kernels match CullInfo\n");
+
+	if (bench) {
+		runBenchmark(count, iterations);
+	}
+	return 0;
+}
@@ -0,0 +1,616 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/* RenderBench drives the libxplanemp frame loop against StubXPLM with a
+ * configurable number of synthetic aircraft, and reports the per-frame
+ * timings.
+ *
+ * usage: xpmp-bench [--frames N] [--warmup N] [--counts a,b,c] [--budget ms]
+ *                   [--moving fraction] [--cull none|suspend|release]
+ *                   [--map-width km] [--feed-rate hz] [--post threads]
+ *                   [--probe-budget N] [--clamp-all] [--jitter m]
+ *                   [--lod-dwell s] [--turnover N] [--create-budget N]
+ *                   [--max-loads N] [--max-objects N] [--csl-models N]
+ *                   [--no-map] [--verbose]
+ *
+ * With --post, the planes are created, updated and destroyed through the
+ * XPMPPost functions, with each frame's updates split between the given
+ * number of producer threads.
+ *
+ * --clamp-all asks for every plane to be clamped to the surface, not just
+ * the ones on the ground, as some clients do.
+ *
+ * --jitter adds up to the given number of meters of noise to every position
+ * sent, like a noisy network feed, which keeps planes near the level of
+ * detail boundaries crossing back and forth.
+ *
+ * --turnover destroys N planes each frame and creates new ones in their
+ * place, like traffic arriving and leaving a busy network.
+ *
+ * --create-budget limits the new instances created per frame.  The peak
+ * backlog reported is the most planes left waiting for theirs in any frame,
+ * including the warmup - when every plane is new.
+ *
+ * --csl-models adds N synthetic models, spread over 50 packages, to the CSL
+ * library, and reports how long the library took to load.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <XPLMProcessing.h>
+
+#include "XPMPMultiplayer.h"
+#include "StubXPLM.h"
+
+using namespace std;
+
+static const double kRefLat = 47.0;
+static const double kRefLon = 8.0;
+static const double kMetersPerDegree = 111319.49;
+static const double kFeetPerMeter = 3.28084;
+
+struct BenchOptions {
+	int				frames = 300;
+	int				warmup = 30;
+	vector<int>		counts = {100, 1000, 5000, 20000};
+	float			budgetMs = 1.0f;
+	double			movingFraction = 0.3;
+	XPMPCullMode	cullMode = xpmpCullMode_None;
+	double			mapWidthKm = 100.0;
+	double			feedRateHz = 0.0;		// 0 pushes every plane's position every frame
+	int				postThreads = 0;		// 0 updates the planes directly
+	int				probeBudget = 0;
+	bool			clampAll = false;
+	double			jitterM = 0.0;
+	float			lodMinDwell = 1.0f;
+	int				turnover = 0;			// planes replaced per frame
+	int				createBudget = 0;
+	int				maxLoads = 4;			// OBJ8 loads in flight
+	int				maxObjects = 0;			// OBJ8 files kept loaded
+	int				cslModels = 0;			// synthetic models added to the library
+	bool			mapOpen = true;
+	bool			verbose = false;
+};
+
+struct SyntheticPlane {
+	XPMPPlaneID				id;
+	const char *			icao;
+	XPMPPlanePosition_t		position;
+	XPMPPlanePosition_t		sent;		// the position last sent, with any jitter
+	XPMPPlaneSurfaces_t		surfaces;
+	XPMPPlaneSurveillance_t	surveillance;
+	XPMPPlaneKinematics_t	kinematics;
+	bool					moving;
+	double					speedDegPerFrame;
+};
+
+static void
+usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [--frames N] [--warmup N] [--counts a,b,c] [--budget ms]\n"
+		"          [--moving fraction] [--cull none|suspend|release]\n"
+		"          [--map-width km] [--feed-rate hz] [--post threads]\n"
+		"          [--probe-budget N] [--clamp-all] [--jitter m]\n"
+		"          [--lod-dwell s] [--turnover N] [--create-budget N]\n"
+		"          [--max-loads N] [--max-objects N] [--csl-models N]\n"
+		"          [--no-map] [--verbose]\n",
+		argv0);
+}
+
+static bool
+parseArgs(int argc, char **argv, BenchOptions &opts)
+{
+	for (int i = 1; i < argc; i++) {
+		const string arg = argv[i];
+		const bool hasValue = (i + 1) < argc;
+		if (arg == "--frames" && hasValue) {
+			opts.frames = atoi(argv[++i]);
+		} else if (arg == "--warmup" && hasValue) {
+			opts.warmup = atoi(argv[++i]);
+		} else if (arg == "--budget" && hasValue) {
+			opts.budgetMs = static_cast<float>(atof(argv[++i]));
+		} else if (arg == "--moving" && hasValue) {
+			opts.movingFraction = atof(argv[++i]);
+		} else if (arg == "--counts" && hasValue) {
+			opts.counts.clear();
+			string list = argv[++i];
+			size_t start = 0;
+			while (start < list.size()) {
+				size_t end = list.find(',', start);
+				if (end == string::npos) {
+					end = list.size();
+				}
+				opts.counts.push_back(atoi(list.substr(start, end - start).c_str()));
+				start = end + 1;
+			}
+		} else if (arg == "--cull" && hasValue) {
+			const string mode = argv[++i];
+			if (mode == "none") {
+				opts.cullMode = xpmpCullMode_None;
+			} else if (mode == "suspend") {
+				opts.cullMode = xpmpCullMode_Suspend;
+			} else if (mode == "release") {
+				opts.cullMode = xpmpCullMode_Release;
+			} else {
+				return false;
+			}
+		} else if (arg == "--map-width" && hasValue) {
+			opts.mapWidthKm = atof(argv[++i]);
+		} else if (arg == "--feed-rate" && hasValue) {
+			opts.feedRateHz = atof(argv[++i]);
+		} else if (arg == "--post" && hasValue) {
+			opts.postThreads = atoi(argv[++i]);
+			if (opts.postThreads <= 0) {
+				return false;
+			}
+		} else if (arg == "--probe-budget" && hasValue) {
+			opts.probeBudget = atoi(argv[++i]);
+		} else if (arg == "--jitter" && hasValue) {
+			opts.jitterM = atof(argv[++i]);
+		} else if (arg == "--lod-dwell" && hasValue) {
+			opts.lodMinDwell = static_cast<float>(atof(argv[++i]));
+		} else if (arg == "--create-budget" && hasValue) {
+			opts.createBudget = atoi(argv[++i]);
+		} else if (arg == "--max-objects" && hasValue) {
+			opts.maxObjects = atoi(argv[++i]);
+		} else if (arg == "--max-loads" && hasValue) {
+			opts.maxLoads = atoi(argv[++i]);
+		} else if (arg == "--turnover" && hasValue) {
+			opts.turnover = atoi(argv[++i]);
+		} else if (arg == "--csl-models" && hasValue) {
+			opts.cslModels = atoi(argv[++i]);
+		} else if (arg == "--clamp-all") {
+			opts.clampAll = true;
+		} else if (arg == "--no-map") {
+			opts.mapOpen = false;
+		} else if (arg == "--verbose") {
+			opts.verbose = true;
+		} else {
+			return false;
+		}
+	}
+	return opts.frames > 0 && !opts.counts.empty();
+}
+
+static void
+writeFile(const string &path, const string &contents)
+{
+	ofstream out(path);
+	out << contents;
+}
+
+/* writes models synthetic models, spread over packageCount packages, to
+ * cslDir.  Each has an ICAO, AIRLINE and LIVERY line, as most real models
+ * do.  The objects are never loaded, so they aren't written.
+ */
+static void
+makeSyntheticPackages(const string &cslDir, int models, int packageCount)
+{
+	static const char *icaos[] = {"B738", "A320", "B744", "C172"};
+	for (int p = 0; p < packageCount; p++) {
+		char name[32];
+		snprintf(name, sizeof(name), "SYNTH%02d", p);
+		const string pkgDir = cslDir + name + "/";
+		mkdir(pkgDir.c_str(), 0755);
+
+		string xsb = string("EXPORT_NAME ") + name + "\n\n";
+		for (int m = p; m < models; m += packageCount) {
+			const char *icao = icaos[m % 4];
+			char airline[8];
+			snprintf(airline, sizeof(airline), "A%02d", (m / 4) % 100);
+			char model[64];
+			snprintf(model, sizeof(model), "%s_%s_L%d", icao, airline, m);
+
+			xsb += string("OBJ8_AIRCRAFT ") + model + "\n";
+			xsb += string("OBJ8 SOLID YES ") + name + "/" + model + ".obj\n";
+			xsb += string("OBJ8 LIGHTS YES ") + name + "/lights.obj\n";
+			xsb += "VERT_OFFSET 1.5\n";
+			xsb += string("LIVERY ") + icao + " " + airline + " L" + to_string(m) + "\n\n";
+		}
+		writeFile(pkgDir + "xsb_aircraft.txt", xsb);
+	}
+}
+
+/* builds a minimal resource folder with a doc8643, related.txt and a single
+ * CSL package with a few OBJ8 aircraft.  The stub never reads the objects
+ * themselves, so they're empty.
+ */
+static string
+makeResources(const BenchOptions &opts)
+{
+	char tmpl[] = "/tmp/xpmp-bench-XXXXXX";
+	if (mkdtemp(tmpl) == nullptr) {
+		perror("mkdtemp");
+		exit(1);
+	}
+	const string root = string(tmpl) + "/";
+	const string cslDir = root + "CSL/";
+	const string pkgDir = cslDir + "Bench/";
+	mkdir(cslDir.c_str(), 0755);
+	mkdir(pkgDir.c_str(), 0755);
+
+	writeFile(root + "doc8643.txt",
+		"BOEING\t737-800\tB738\tL2J\tM\n"
+		"AIRBUS\tA-320\tA320\tL2J\tM\n"
+		"BOEING\t747-400\tB744\tL4J\tH\n"
+		"CESSNA\t172 Skyhawk\tC172\tL1P\tL\n");
+	writeFile(root + "related.txt",
+		"; related aircraft\n"
+		"B738 A320\n");
+
+	string xsb =
+		"EXPORT_NAME BENCH\n"
+		"\n";
+	const char *icaos[] = {"B738", "A320", "B744", "C172"};
+	for (const char *icao: icaos) {
+		xsb += string("OBJ8_AIRCRAFT ") + icao + "\n";
+		xsb += string("OBJ8 SOLID YES BENCH/") + icao + ".obj\n";
+		xsb += "OBJ8 LIGHTS YES BENCH/lights.obj\n";
+		xsb += string("ICAO ") + icao + "\n\n";
+		writeFile(pkgDir + icao + ".obj", "");
+	}
+	writeFile(pkgDir + "lights.obj", "");
+	writeFile(pkgDir + "xsb_aircraft.txt", xsb);
+
+	if (opts.cslModels > 0) {
+		makeSyntheticPackages(cslDir, opts.cslModels, 50);
+	}
+
+	return root;
+}
+
+static void
+removeResources(const string &root)
+{
+	const string cmd = "rm -rf '" + root + "'";
+	if (system(cmd.c_str()) != 0) {
+		fprintf(stderr, "warning: couldn't remove %s\n", root.c_str());
+	}
+}
+
+static void
+createPlanes(int count, const BenchOptions &opts, vector<SyntheticPlane> &outPlanes)
+{
+	static const char *icaos[] = {"B738", "A320", "B744", "C172"};
+	mt19937 rng(static_cast<unsigned>(count));
+	uniform_real_distribution<double> unit(0.0, 1.0);
+
+	outPlanes.resize(count);
+	for (int i = 0; i < count; i++) {
+		auto &p = outPlanes[i];
+		p.icao = icaos[i % 4];
+		if (opts.postThreads > 0) {
+			p.id = XPMPPostCreatePlane(p.icao, "", "");
+		} else {
+			p.id = XPMPCreatePlane(p.icao, "", "");
+		}
+
+		// scatter planes out to ~150km, denser near the origin - roughly
+		// what a busy network looks like.
+		const double range = 150000.0 * unit(rng) * unit(rng);
+		const double bearing = unit(rng) * 2.0 * M_PI;
+		p.moving = unit(rng) < opts.movingFraction;
+
+		memset(&p.position, 0, sizeof(p.position));
+		p.position.size = sizeof(p.position);
+		p.position.lat = kRefLat + (range * cos(bearing)) / kMetersPerDegree;
+		p.position.lon = kRefLon + (range * sin(bearing)) / (kMetersPerDegree * cos(kRefLat * M_PI / 180.0));
+		p.position.elevation = p.moving ? (3000.0 + unit(rng) * 35000.0) : 0.0;
+		p.position.heading = static_cast<float>(unit(rng) * 360.0);
+		p.position.offsetScale = 1.0f;
+		p.position.clampToGround = opts.clampAll || !p.moving;
+		snprintf(p.position.label, sizeof(p.position.label), "BNC%05d", i);
+		// 250kts at 60fps is roughly 1.2e-5 degrees per frame.
+		p.speedDegPerFrame = p.moving ? 1.2e-5 : 0.0;
+
+		memset(&p.surfaces, 0, sizeof(p.surfaces));
+		p.surfaces.size = sizeof(p.surfaces);
+		p.surfaces.gearPosition = p.moving ? 0.0f : 1.0f;
+		p.surfaces.lights.timeOffset = static_cast<unsigned>(rng() & 0xffff);
+		p.surfaces.lights.navLights = 1;
+		p.surfaces.lights.bcnLights = 1;
+		p.surfaces.lights.strbLights = p.moving ? 1 : 0;
+
+		p.surveillance.size = sizeof(p.surveillance);
+		p.surveillance.code = 1200;
+		p.surveillance.mode = p.moving ? xpmpTransponderMode_ModeC : xpmpTransponderMode_Standby;
+	}
+}
+
+/* pushUpdates moves the planes on by a frame and sends them to the library.
+ *
+ * With a feed rate, each plane is only sent (with kinematics) when it's due,
+ * the way a network client would, and the library interpolates in between.
+ */
+static void
+pushUpdates(vector<SyntheticPlane> &planes, vector<XPMPUpdate_t> &updates, const BenchOptions &opts, int frame)
+{
+	const int framesPerFeed = (opts.feedRateHz > 0.0) ? max(1, static_cast<int>(lround(60.0 / opts.feedRateHz))) : 1;
+	const double now = XPLMGetElapsedTime();
+	static mt19937 rng(1);
+	uniform_real_distribution<double> noise(-opts.jitterM / kMetersPerDegree, opts.jitterM / kMetersPerDegree);
+
+	updates.clear();
+	for (size_t i = 0; i < planes.size(); i++) {
+		auto &p = planes[i];
+		const double h = p.position.heading * M_PI / 180.0;
+		if (p.moving) {
+			p.position.lat += p.speedDegPerFrame * cos(h);
+			p.position.lon += p.speedDegPerFrame * sin(h);
+		}
+		if ((frame + static_cast<int>(i)) % framesPerFeed != 0) {
+			continue;
+		}
+		p.sent = p.position;
+		if (opts.jitterM > 0.0) {
+			p.sent.lat += noise(rng);
+			p.sent.lon += noise(rng) / cos(kRefLat * M_PI / 180.0);
+		}
+		XPMPUpdate_t update = {};
+		update.plane = p.id;
+		update.position = &p.sent;
+		update.surfaces = &p.surfaces;
+		update.surveillance = &p.surveillance;
+		if (opts.feedRateHz > 0.0) {
+			const double speedMs = p.speedDegPerFrame * 60.0 * kMetersPerDegree;
+			p.kinematics.size = sizeof(p.kinematics);
+			p.kinematics.timestamp = now;
+			p.kinematics.lat = p.sent.lat;
+			p.kinematics.lon = p.sent.lon;
+			p.kinematics.elevation = p.position.elevation;
+			p.kinematics.pitch = p.position.pitch;
+			p.kinematics.roll = p.position.roll;
+			p.kinematics.heading = p.position.heading;
+			p.kinematics.velocityNorth = static_cast<float>(speedMs * cos(h));
+			p.kinematics.velocityEast = static_cast<float>(speedMs * sin(h) * cos(p.position.lat * M_PI / 180.0));
+			update.kinematics = &p.kinematics;
+		}
+		updates.push_back(update);
+	}
+	if (opts.postThreads <= 0) {
+		XPMPUpdatePlanes(updates.data(), sizeof(XPMPUpdate_t), updates.size());
+		return;
+	}
+
+	// post a slice of the updates from each producer.
+	vector<thread> producers;
+	const size_t slice = (updates.size() + opts.postThreads - 1) / opts.postThreads;
+	for (size_t begin = 0; begin < updates.size(); begin += slice) {
+		const size_t count = min(slice, updates.size() - begin);
+		producers.emplace_back([&updates, begin, count]() {
+			XPMPPostUpdatePlanes(updates.data() + begin, sizeof(XPMPUpdate_t), count);
+		});
+	}
+	for (auto &producer: producers) {
+		producer.join();
+	}
+}
+
+/* replacePlanes destroys opts.turnover planes, round robin, and creates new
+ * ones of the same type in their place.
+ */
+static void
+replacePlanes(vector<SyntheticPlane> &planes, const BenchOptions &opts, size_t &ioNext)
+{
+	for (int n = 0; n < opts.turnover && !planes.empty(); n++) {
+		auto &p = planes[ioNext++ % planes.size()];
+		if (opts.postThreads > 0) {
+			XPMPPostDestroyPlane(p.id);
+			p.id = XPMPPostCreatePlane(p.icao, "", "");
+		} else {
+			XPMPDestroyPlane(p.id);
+			p.id = XPMPCreatePlane(p.icao, "", "");
+		}
+	}
+}
+
+static void
+summarise(vector<double> &samples, double &outMin, double &outAvg, double &outP99)
+{
+	sort(samples.begin(), samples.end());
+	outMin = samples.front();
+	double total = 0.0;
+	for (auto s: samples) {
+		total += s;
+	}
+	outAvg = total / samples.size();
+	outP99 = samples[min(samples.size() - 1, (samples.size() * 99) / 100)];
+}
+
+static int
+instanceBacklog()
+{
+	XPMPRenderStats_t stats;
+	stats.size = sizeof(stats);
+	XPMPGetRenderStats(&stats);
+	return stats.instanceBacklog;
+}
+
+static void
+runCount(int count, const BenchOptions &opts)
+{
+	vector<SyntheticPlane> planes;
+	vector<XPMPUpdate_t> updates;
+	createPlanes(count, opts, planes);
+	size_t nextReplaced = 0;
+	int peakBacklog = 0;
+
+	for (int f = 0; f < opts.warmup; f++) {
+		replacePlanes(planes, opts, nextReplaced);
+		pushUpdates(planes, updates, opts, f);
+		StubXPLM::runFrame();
+		peakBacklog = max(peakBacklog, instanceBacklog());
+	}
+
+	StubXPLM::resetCounters();
+	vector<double> frameMs;
+	frameMs.reserve(opts.frames);
+	for (int f = 0; f < opts.frames; f++) {
+		const auto start = chrono::steady_clock::now();
+		replacePlanes(planes, opts, nextReplaced);
+		pushUpdates(planes, updates, opts, opts.warmup + f);
+		StubXPLM::runFrame();
+		const chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+		frameMs.push_back(elapsed.count());
+		peakBacklog = max(peakBacklog, instanceBacklog());
+	}
+
+	XPMPRenderStats_t stats;
+	stats.size = sizeof(stats);
+	XPMPGetRenderStats(&stats);
+	const auto &counters = StubXPLM::getCounters();
+
+	double minMs, avgMs, p99Ms;
+	summarise(frameMs, minMs, avgMs, p99Ms);
+	printf("\n%d aircraft, %d frames\n", count, opts.frames);
+	printf("  %-16s %9s %9s %9s\n", "phase", "min ms", "avg ms", "p99 ms");
+	printf("  %-16s %9.3f %9.3f %9.3f\n", "frame (total)", minMs, avgMs, p99Ms);
+
+	const struct {
+		const char *				name;
+		const XPMPPhaseStats_t &	stats;
+	} phases[] = {
+		{"prep lists", stats.prepLists},
+		{"world to local", stats.worldToLocal},
+		{"prepare", stats.prepare},
+		{"terrain probe", stats.terrainProbe},
+		{"instance update", stats.instanceUpdate},
+		{"tcas", stats.tcas},
+		{"map icons", stats.mapIcons},
+		{"map labels", stats.mapLabels},
+		{"obj8 load", stats.obj8Load},
+		{"kinematics", stats.kinematics},
+	};
+	for (const auto &phase: phases) {
+		printf("  %-16s %9.3f %9.3f %9.3f\n",
+			phase.name, phase.stats.minMs, phase.stats.avgMs, phase.stats.p99Ms);
+	}
+	printf("  last frame: %d planes, %d updated, %d full updates, %d suspended, %d waiting for instances\n",
+		stats.planeCount, stats.updatedCount, stats.fullUpdateCount, stats.suspendedCount, stats.instanceBacklog);
+	printf("  instances: %ld created, %ld destroyed, peak backlog %d planes\n",
+		counters.instancesCreated, counters.instancesDestroyed, peakBacklog);
+	printf("  objects: %ld loaded, %ld unloaded\n",
+		counters.objectsLoaded, counters.objectsUnloaded);
+	printf("  model matches (since start): %d from the cache, %d searched\n",
+		stats.matchCacheHits, stats.matchCacheMisses);
+	printf("  per frame: %.1f instance moves, %.1f probes, %.1f world to local, %.1f map icons, %.1f labels\n",
+		static_cast<double>(counters.instancePositionsSet) / opts.frames,
+		static_cast<double>(counters.terrainProbes) / opts.frames,
+		static_cast<double>(counters.worldToLocalCalls) / opts.frames,
+		static_cast<double>(counters.mapIconsDrawn) / opts.frames,
+		static_cast<double>(counters.mapLabelsDrawn) / opts.frames);
+
+	for (const auto &p: planes) {
+		if (opts.postThreads > 0) {
+			XPMPPostDestroyPlane(p.id);
+		} else {
+			XPMPDestroyPlane(p.id);
+		}
+	}
+	// let the instance teardown settle before the next run.
+	StubXPLM::runFrame();
+}
+
+int
+main(int argc, char **argv)
+{
+	BenchOptions opts;
+	if (!parseArgs(argc, argv, opts)) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	const string root = makeResources(opts);
+	StubXPLM::setLogEnabled(opts.verbose);
+	StubXPLM::setSystemPath(root);
+	StubXPLM::setReferencePoint(kRefLat, kRefLon);
+	// a tower-ish view from 100m up, looking north and slightly down.
+	StubXPLM::setCamera(0.0f, 100.0f, 0.0f, 0.0f, -5.0f, 1.0f);
+	StubXPLM::setUserElevation(3000.0 / kFeetPerMeter);
+	StubXPLM::setVisibility(40000.0f);
+	StubXPLM::setMapOpen(opts.mapOpen);
+	StubXPLM::setMapView(kRefLat, kRefLon, opts.mapWidthKm * 1000.0);
+
+	XPMPConfiguration_t config;
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+	config.maxFullAircraftRenderingDistance = 5.0f;
+	config.enableSurfaceClamping = true;
+	config.updateBudgetMs = opts.budgetMs;
+	config.cullMode = opts.cullMode;
+	config.terrainProbeBudget = opts.probeBudget;
+	config.lodMinDwell = opts.lodMinDwell;
+	config.instanceCreationBudget = opts.createBudget;
+	config.maxObjectLoadsInFlight = opts.maxLoads;
+	config.maxLoadedObjects = opts.maxObjects;
+	config.prefetchDistance = 1.0f;
+	config.prefetchLeadTime = 30.0f;
+
+	const string related = root + "related.txt";
+	const string doc8643 = root + "doc8643.txt";
+	// the init functions return an empty string on success.
+	const char *err = XPMPMultiplayerInit(&config, related.c_str(), doc8643.c_str());
+	if (*err == '\0') {
+		const auto loadStart = chrono::steady_clock::now();
+		err = XPMPLoadCSLPackages((root + "CSL").c_str());
+		const chrono::duration<double, milli> loadMs = chrono::steady_clock::now() - loadStart;
+		if (opts.cslModels > 0) {
+			printf("xpmp-bench: loaded the CSL library in %.1fms\n", loadMs.count());
+		}
+	}
+	if (*err == '\0') {
+		err = XPMPMultiplayerEnable();
+	}
+	if (*err != '\0') {
+		fprintf(stderr, "initialisation failed: %s\n", err);
+		removeResources(root);
+		return 1;
+	}
+	XPMPSetMapIcon("Resources/plugins/bench/icons.png", 0, 0, 1, 1, 40.0f);
+
+	printf("xpmp-bench: %d installed models, budget %.2fms, %.0f%% moving\n",
+		XPMPGetNumberOfInstalledModels(), opts.budgetMs, opts.movingFraction * 100.0);
+
+	for (int count: opts.counts) {
+		runCount(count, opts);
+	}
+
+	XPMPMultiplayerDisable();
+	XPMPMultiplayerCleanup();
+	removeResources(root);
+	return 0;
+}
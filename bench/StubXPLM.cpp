@@ -0,0 +1,821 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "StubXPLM.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+
+#include <XPLMCamera.h>
+#include <XPLMDataAccess.h>
+#include <XPLMDisplay.h>
+#include <XPLMGraphics.h>
+#include <XPLMInstance.h>
+#include <XPLMMap.h>
+#include <XPLMPlanes.h>
+#include <XPLMPlugin.h>
+#include <XPLMProcessing.h>
+#include <XPLMScenery.h>
+#include <XPLMUtilities.h>
+
+using namespace std;
+
+static const double kPi = 3.14159265358979323846;
+static const double kMetersPerDegree = 111319.49;
+
+/********************************************************************************
+ * STATE
+ ********************************************************************************/
+
+struct StubDataRef {
+    XPLMDataTypeID  type = 0;
+    bool            owned = true;    // value lives here, rather than in accessors
+
+    int             intValue = 0;
+    float           floatValue = 0.0f;
+    double          doubleValue = 0.0;
+    vector<float>   floatArray;
+
+    XPLMGetDatai_f  readInt = nullptr;
+    XPLMSetDatai_f  writeInt = nullptr;
+    XPLMGetDataf_f  readFloat = nullptr;
+    XPLMSetDataf_f  writeFloat = nullptr;
+    XPLMGetDatad_f  readDouble = nullptr;
+    XPLMSetDatad_f  writeDouble = nullptr;
+    XPLMGetDatavf_f readFloatArray = nullptr;
+    void *          readRefcon = nullptr;
+    void *          writeRefcon = nullptr;
+};
+
+struct StubObject {
+    string  path;
+};
+
+struct StubInstance {
+    StubObject *    object;
+    XPLMDrawInfo_t  position;
+};
+
+struct PendingLoad {
+    string              path;
+    XPLMObjectLoaded_f  callback;
+    void *              refcon;
+};
+
+struct FlightLoop {
+    XPLMFlightLoop_f    callback;
+    void *              refcon;
+};
+
+struct DrawCallback {
+    XPLMDrawCallback_f  callback;
+    XPLMDrawingPhase    phase;
+    int                 before;
+    void *              refcon;
+};
+
+struct MapLayer {
+    XPLMCreateMapLayer_t    params;
+};
+
+static unordered_map<string, unique_ptr<StubDataRef>>  gDataRefs;
+static deque<PendingLoad>           gPendingLoads;
+static vector<FlightLoop>           gFlightLoops;
+static vector<DrawCallback>         gDrawCallbacks;
+static vector<unique_ptr<MapLayer>> gMapLayers;
+static vector<XPLMMapCreatedCallback_f> gMapCreationHooks;
+
+static string               gSystemPath = "./";
+static bool                 gLogEnabled = false;
+static int                  gCycle = 0;
+static float                gElapsed = 0.0f;
+static bool                 gMapOpen = false;
+static XPLMPluginID         gPlanesController = XPLM_NO_PLUGIN_ID;
+static int                  gActiveAircraft = 1;
+static XPLMCameraPosition_t gCamera = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+static StubXPLM::Counters   gCounters;
+
+// the projection the map callbacks are given - it's never dereferenced.
+static int                  gMapProjection = 0;
+// the map's view - the whole world unless setMapView() is used.
+static float                gMapBounds[4] = {
+    static_cast<float>(-180.0 * kMetersPerDegree), static_cast<float>(90.0 * kMetersPerDegree),
+    static_cast<float>(180.0 * kMetersPerDegree), static_cast<float>(-90.0 * kMetersPerDegree),
+};
+
+static StubDataRef *
+simDataRef(const char *name, XPLMDataTypeID type)
+{
+    auto &dr = gDataRefs[name];
+    if (!dr) {
+        dr.reset(new StubDataRef);
+        dr->type = type;
+    }
+    return dr.get();
+}
+
+static StubDataRef *
+latRef()
+{
+    return simDataRef("sim/flightmodel/position/lat_ref", xplmType_Float);
+}
+
+static StubDataRef *
+lonRef()
+{
+    return simDataRef("sim/flightmodel/position/lon_ref", xplmType_Float);
+}
+
+// builds the column-major modelview and projection matrices for the camera.
+static void
+updateViewMatrices()
+{
+    const float h = static_cast<float>(gCamera.heading * kPi / 180.0);
+    const float p = static_cast<float>(gCamera.pitch * kPi / 180.0);
+    const float ch = cos(h), sh = sin(h);
+    const float cp = cos(p), sp = sin(p);
+
+    // R = Rx(pitch) * Ry(heading), then translate by -camera.
+    const float r[9] = {
+        ch,         sp * sh,    -cp * sh,
+        0.0f,       cp,         sp,
+        sh,         -sp * ch,   cp * ch,
+    };
+    auto &mv = simDataRef("sim/graphics/view/modelview_matrix", xplmType_FloatArray)->floatArray;
+    mv.assign(16, 0.0f);
+    for (int col = 0; col < 3; col++) {
+        for (int row = 0; row < 3; row++) {
+            mv[col * 4 + row] = r[col * 3 + row];
+        }
+    }
+    for (int row = 0; row < 3; row++) {
+        mv[12 + row] = -(r[row] * gCamera.x + r[3 + row] * gCamera.y + r[6 + row] * gCamera.z);
+    }
+    mv[15] = 1.0f;
+
+    // 60 degree vertical FOV, 16:9, 1m - 100km
+    const float zNear = 1.0f, zFar = 100000.0f;
+    const float f = static_cast<float>(1.0 / tan((60.0 * kPi / 180.0) / 2.0)) * gCamera.zoom;
+    auto &proj = simDataRef("sim/graphics/view/projection_matrix", xplmType_FloatArray)->floatArray;
+    proj.assign(16, 0.0f);
+    proj[0] = f / (16.0f / 9.0f);
+    proj[5] = f;
+    proj[10] = (zFar + zNear) / (zNear - zFar);
+    proj[11] = -1.0f;
+    proj[14] = (2.0f * zFar * zNear) / (zNear - zFar);
+}
+
+static void
+initSimDataRefs()
+{
+    static bool initialised = false;
+    if (initialised) {
+        return;
+    }
+    initialised = true;
+
+    simDataRef("sim/graphics/view/visibility_effective_m", xplmType_Float)->floatValue = 40000.0f;
+    simDataRef("sim/flightmodel/position/elevation", xplmType_Double);
+    latRef();
+    lonRef();
+    // the sim has 19 multiplayer slots.
+    char buf[100];
+    for (int n = 1; n <= 19; n++) {
+        snprintf(buf, sizeof(buf), "sim/multiplayer/position/plane%d_x", n);
+        simDataRef(buf, xplmType_Float);
+        snprintf(buf, sizeof(buf), "sim/multiplayer/position/plane%d_y", n);
+        simDataRef(buf, xplmType_Float);
+        snprintf(buf, sizeof(buf), "sim/multiplayer/position/plane%d_z", n);
+        simDataRef(buf, xplmType_Float);
+    }
+    updateViewMatrices();
+}
+
+/********************************************************************************
+ * HARNESS CONTROL
+ ********************************************************************************/
+
+void
+StubXPLM::setSystemPath(const std::string &path)
+{
+    gSystemPath = path;
+}
+
+void
+StubXPLM::setLogEnabled(bool enabled)
+{
+    gLogEnabled = enabled;
+}
+
+void
+StubXPLM::setMapView(double lat, double lon, double widthM)
+{
+    // the projection is a plain equirectangular one, in meters at the equator.
+    const double halfWidth = widthM / 2.0;
+    gMapBounds[0] = static_cast<float>(lon * kMetersPerDegree - halfWidth);
+    gMapBounds[1] = static_cast<float>(lat * kMetersPerDegree + halfWidth);
+    gMapBounds[2] = static_cast<float>(lon * kMetersPerDegree + halfWidth);
+    gMapBounds[3] = static_cast<float>(lat * kMetersPerDegree - halfWidth);
+}
+
+void
+StubXPLM::setReferencePoint(double lat, double lon)
+{
+    initSimDataRefs();
+    latRef()->floatValue = static_cast<float>(lat);
+    lonRef()->floatValue = static_cast<float>(lon);
+}
+
+void
+StubXPLM::setCamera(float x, float y, float z, float headingDeg, float pitchDeg, float zoom)
+{
+    initSimDataRefs();
+    gCamera.x = x;
+    gCamera.y = y;
+    gCamera.z = z;
+    gCamera.heading = headingDeg;
+    gCamera.pitch = pitchDeg;
+    gCamera.roll = 0.0f;
+    gCamera.zoom = zoom;
+    updateViewMatrices();
+}
+
+void
+StubXPLM::setUserElevation(double elevationM)
+{
+    initSimDataRefs();
+    simDataRef("sim/flightmodel/position/elevation", xplmType_Double)->doubleValue = elevationM;
+}
+
+void
+StubXPLM::setVisibility(float visibilityM)
+{
+    initSimDataRefs();
+    simDataRef("sim/graphics/view/visibility_effective_m", xplmType_Float)->floatValue = visibilityM;
+}
+
+void
+StubXPLM::setMapOpen(bool open)
+{
+    gMapOpen = open;
+}
+
+void
+StubXPLM::runFrame()
+{
+    initSimDataRefs();
+    gCycle++;
+    gElapsed += 1.0f / 60.0f;
+
+    // object loads complete on the frame after they were requested.
+    auto loads = std::move(gPendingLoads);
+    gPendingLoads.clear();
+    for (auto &load: loads) {
+        auto *obj = new StubObject{load.path};
+        gCounters.objectsLoaded++;
+        load.callback(obj, load.refcon);
+    }
+
+    // callbacks can (un)register flight loops, so run from a copy.
+    auto loops = gFlightLoops;
+    for (const auto &fl: loops) {
+        fl.callback(1.0f / 60.0f, 1.0f / 60.0f, gCycle, fl.refcon);
+    }
+
+    auto draws = gDrawCallbacks;
+    for (int before = 1; before >= 0; before--) {
+        for (const auto &dc: draws) {
+            if (dc.phase == xplm_Phase_Gauges && dc.before == before) {
+                dc.callback(dc.phase, dc.before, dc.refcon);
+            }
+        }
+    }
+
+    if (gMapOpen) {
+        const float *bounds = gMapBounds;
+        for (const auto &layer: gMapLayers) {
+            if (layer->params.iconCallback) {
+                layer->params.iconCallback(layer.get(), bounds, 1.0f, 1.0f, xplm_MapStyle_VFR_Sectional,
+                                           &gMapProjection, layer->params.refcon);
+            }
+            if (layer->params.labelCallback) {
+                layer->params.labelCallback(layer.get(), bounds, 1.0f, 1.0f, xplm_MapStyle_VFR_Sectional,
+                                            &gMapProjection, layer->params.refcon);
+            }
+        }
+    }
+}
+
+const StubXPLM::Counters &
+StubXPLM::getCounters()
+{
+    return gCounters;
+}
+
+void
+StubXPLM::resetCounters()
+{
+    gCounters = Counters();
+}
+
+/********************************************************************************
+ * XPLMUtilities / XPLMPlugin
+ ********************************************************************************/
+
+void
+XPLMDebugString(const char *inString)
+{
+    if (gLogEnabled) {
+        fputs(inString, stderr);
+    }
+}
+
+void
+XPLMGetSystemPath(char *outSystemPath)
+{
+    // the SDK specifies a 512 byte buffer.
+    strncpy(outSystemPath, gSystemPath.c_str(), 511);
+    outSystemPath[511] = '\0';
+}
+
+int
+XPLMGetDirectoryContents(const char *inDirectoryPath,
+                         int inFirstReturn,
+                         char *outFileNames,
+                         int inFileNameBufSize,
+                         char **outIndices,
+                         int inIndexCount,
+                         int *outTotalFiles,
+                         int *outReturnedFiles)
+{
+    vector<string> names;
+    DIR *dir = opendir(inDirectoryPath);
+    if (dir != nullptr) {
+        while (auto *ent = readdir(dir)) {
+            if (strcmp(ent->d_name, ".") != 0 && strcmp(ent->d_name, "..") != 0) {
+                names.emplace_back(ent->d_name);
+            }
+        }
+        closedir(dir);
+    }
+    sort(names.begin(), names.end());
+
+    int returned = 0;
+    int bufUsed = 0;
+    bool complete = true;
+    for (size_t i = inFirstReturn; i < names.size(); i++) {
+        const int len = static_cast<int>(names[i].size()) + 1;
+        if (returned >= inIndexCount || bufUsed + len > inFileNameBufSize) {
+            complete = false;
+            break;
+        }
+        memcpy(outFileNames + bufUsed, names[i].c_str(), len);
+        if (outIndices) {
+            outIndices[returned] = outFileNames + bufUsed;
+        }
+        bufUsed += len;
+        returned++;
+    }
+    if (outTotalFiles) {
+        *outTotalFiles = static_cast<int>(names.size());
+    }
+    if (outReturnedFiles) {
+        *outReturnedFiles = returned;
+    }
+    return complete ? 1 : 0;
+}
+
+XPLMPluginID
+XPLMGetMyID(void)
+{
+    return 1;
+}
+
+/********************************************************************************
+ * XPLMDataAccess
+ ********************************************************************************/
+
+XPLMDataRef
+XPLMFindDataRef(const char *inDataRefName)
+{
+    initSimDataRefs();
+    auto it = gDataRefs.find(inDataRefName);
+    if (it == gDataRefs.end()) {
+        return nullptr;
+    }
+    return it->second.get();
+}
+
+int
+XPLMGetDatai(XPLMDataRef inDataRef)
+{
+    auto *dr = static_cast<StubDataRef *>(inDataRef);
+    if (dr == nullptr) {
+        return 0;
+    }
+    return dr->readInt ? dr->readInt(dr->readRefcon) : dr->intValue;
+}
+
+void
+XPLMSetDatai(XPLMDataRef inDataRef, int inValue)
+{
+    auto *dr = static_cast<StubDataRef *>(inDataRef);
+    if (dr == nullptr) {
+        return;
+    }
+    if (dr->writeInt) {
+        dr->writeInt(dr->writeRefcon, inValue);
+    } else if (dr->owned) {
+        dr->intValue = inValue;
+    }
+}
+
+float
+XPLMGetDataf(XPLMDataRef inDataRef)
+{
+    auto *dr = static_cast<StubDataRef *>(inDataRef);
+    if (dr == nullptr) {
+        return 0.0f;
+    }
+    return dr->readFloat ? dr->readFloat(dr->readRefcon) : dr->floatValue;
+}
+
+void
+XPLMSetDataf(XPLMDataRef inDataRef, float inValue)
+{
+    auto *dr = static_cast<StubDataRef *>(inDataRef);
+    if (dr == nullptr) {
+        return;
+    }
+    if (dr->writeFloat) {
+        dr->writeFloat(dr->writeRefcon, inValue);
+    } else if (dr->owned) {
+        dr->floatValue = inValue;
+    }
+}
+
+double
+XPLMGetDatad(XPLMDataRef inDataRef)
+{
+    auto *dr = static_cast<StubDataRef *>(inDataRef);
+    if (dr == nullptr) {
+        return 0.0;
+    }
+    return dr->readDouble ? dr->readDouble(dr->readRefcon) : dr->doubleValue;
+}
+
+int
+XPLMGetDatavf(XPLMDataRef inDataRef, float *outValues, int inOffset, int inMax)
+{
+    auto *dr = static_cast<StubDataRef *>(inDataRef);
+    if (dr == nullptr) {
+        return 0;
+    }
+    if (dr->readFloatArray) {
+        return dr->readFloatArray(dr->readRefcon, outValues, inOffset, inMax);
+    }
+    const int size = static_cast<int>(dr->floatArray.size());
+    if (outValues == nullptr) {
+        return size;
+    }
+    int count = 0;
+    for (int i = inOffset; i < size && count < inMax; i++, count++) {
+        outValues[count] = dr->floatArray[i];
+    }
+    return count;
+}
+
+XPLMDataRef
+XPLMRegisterDataAccessor(const char *inDataName,
+                         XPLMDataTypeID inDataType,
+                         int inIsWritable,
+                         XPLMGetDatai_f inReadInt,
+                         XPLMSetDatai_f inWriteInt,
+                         XPLMGetDataf_f inReadFloat,
+                         XPLMSetDataf_f inWriteFloat,
+                         XPLMGetDatad_f inReadDouble,
+                         XPLMSetDatad_f inWriteDouble,
+                         XPLMGetDatavi_f /*inReadIntArray*/,
+                         XPLMSetDatavi_f /*inWriteIntArray*/,
+                         XPLMGetDatavf_f inReadFloatArray,
+                         XPLMSetDatavf_f /*inWriteFloatArray*/,
+                         XPLMGetDatab_f /*inReadData*/,
+                         XPLMSetDatab_f /*inWriteData*/,
+                         void *inReadRefcon,
+                         void *inWriteRefcon)
+{
+    unique_ptr<StubDataRef> dr(new StubDataRef);
+    dr->type = inDataType;
+    dr->owned = false;
+    dr->readInt = inReadInt;
+    dr->readFloat = inReadFloat;
+    dr->readDouble = inReadDouble;
+    dr->readFloatArray = inReadFloatArray;
+    if (inIsWritable) {
+        dr->writeInt = inWriteInt;
+        dr->writeFloat = inWriteFloat;
+        dr->writeDouble = inWriteDouble;
+    }
+    dr->readRefcon = inReadRefcon;
+    dr->writeRefcon = inWriteRefcon;
+    auto *drPtr = dr.get();
+    gDataRefs[inDataName] = std::move(dr);
+    return drPtr;
+}
+
+void
+XPLMUnregisterDataAccessor(XPLMDataRef inDataRef)
+{
+    for (auto it = gDataRefs.begin(); it != gDataRefs.end(); ++it) {
+        if (it->second.get() == inDataRef) {
+            gDataRefs.erase(it);
+            return;
+        }
+    }
+}
+
+int
+XPLMShareData(const char *inDataName,
+              XPLMDataTypeID inDataType,
+              XPLMDataChanged_f /*inNotificationFunc*/,
+              void * /*inNotificationRefcon*/)
+{
+    auto it = gDataRefs.find(inDataName);
+    if (it != gDataRefs.end()) {
+        return (it->second->type == inDataType) ? 1 : 0;
+    }
+    simDataRef(inDataName, inDataType);
+    return 1;
+}
+
+/********************************************************************************
+ * XPLMProcessing / XPLMDisplay / XPLMCamera
+ ********************************************************************************/
+
+int
+XPLMGetCycleNumber(void)
+{
+    return gCycle;
+}
+
+float
+XPLMGetElapsedTime(void)
+{
+    return gElapsed;
+}
+
+void
+XPLMRegisterFlightLoopCallback(XPLMFlightLoop_f inFlightLoop, float /*inInterval*/, void *inRefcon)
+{
+    gFlightLoops.push_back(FlightLoop{inFlightLoop, inRefcon});
+}
+
+void
+XPLMUnregisterFlightLoopCallback(XPLMFlightLoop_f inFlightLoop, void *inRefcon)
+{
+    gFlightLoops.erase(remove_if(gFlightLoops.begin(), gFlightLoops.end(),
+        [=](const FlightLoop &fl) {
+            return fl.callback == inFlightLoop && fl.refcon == inRefcon;
+        }), gFlightLoops.end());
+}
+
+int
+XPLMRegisterDrawCallback(XPLMDrawCallback_f inCallback, XPLMDrawingPhase inPhase, int inWantsBefore, void *inRefcon)
+{
+    gDrawCallbacks.push_back(DrawCallback{inCallback, inPhase, inWantsBefore, inRefcon});
+    return 1;
+}
+
+int
+XPLMUnregisterDrawCallback(XPLMDrawCallback_f inCallback, XPLMDrawingPhase inPhase, int inWantsBefore, void *inRefcon)
+{
+    auto oldSize = gDrawCallbacks.size();
+    gDrawCallbacks.erase(remove_if(gDrawCallbacks.begin(), gDrawCallbacks.end(),
+        [=](const DrawCallback &dc) {
+            return dc.callback == inCallback && dc.phase == inPhase &&
+                   dc.before == inWantsBefore && dc.refcon == inRefcon;
+        }), gDrawCallbacks.end());
+    return (gDrawCallbacks.size() != oldSize) ? 1 : 0;
+}
+
+void
+XPLMReadCameraPosition(XPLMCameraPosition_t *outCameraPosition)
+{
+    *outCameraPosition = gCamera;
+}
+
+/********************************************************************************
+ * XPLMGraphics
+ ********************************************************************************/
+
+void
+XPLMWorldToLocal(double inLatitude, double inLongitude, double inAltitude,
+                 double *outX, double *outY, double *outZ)
+{
+    gCounters.worldToLocalCalls++;
+    const double refLat = latRef()->floatValue;
+    const double refLon = lonRef()->floatValue;
+    *outX = (inLongitude - refLon) * kMetersPerDegree * cos(refLat * kPi / 180.0);
+    *outY = inAltitude;
+    *outZ = -(inLatitude - refLat) * kMetersPerDegree;
+}
+
+/********************************************************************************
+ * XPLMScenery / XPLMInstance
+ ********************************************************************************/
+
+XPLMProbeRef
+XPLMCreateProbe(XPLMProbeType /*inProbeType*/)
+{
+    static int probe;
+    return &probe;
+}
+
+XPLMProbeResult
+XPLMProbeTerrainXYZ(XPLMProbeRef /*inProbe*/, float inX, float /*inY*/, float inZ, XPLMProbeInfo_t *outInfo)
+{
+    gCounters.terrainProbes++;
+    outInfo->locationX = inX;
+    outInfo->locationY = 0.0f;
+    outInfo->locationZ = inZ;
+    outInfo->normalX = 0.0f;
+    outInfo->normalY = 1.0f;
+    outInfo->normalZ = 0.0f;
+    outInfo->velocityX = outInfo->velocityY = outInfo->velocityZ = 0.0f;
+    outInfo->is_wet = 0;
+    return xplm_ProbeHitTerrain;
+}
+
+void
+XPLMLoadObjectAsync(const char *inPath, XPLMObjectLoaded_f inCallback, void *inRefcon)
+{
+    gPendingLoads.push_back(PendingLoad{inPath, inCallback, inRefcon});
+}
+
+void
+XPLMUnloadObject(XPLMObjectRef inObject)
+{
+    gCounters.objectsUnloaded++;
+    delete static_cast<StubObject *>(inObject);
+}
+
+XPLMInstanceRef
+XPLMCreateInstance(XPLMObjectRef obj, const char ** /*datarefs*/)
+{
+    gCounters.instancesCreated++;
+    return new StubInstance{static_cast<StubObject *>(obj), XPLMDrawInfo_t{}};
+}
+
+void
+XPLMDestroyInstance(XPLMInstanceRef instance)
+{
+    if (instance != nullptr) {
+        gCounters.instancesDestroyed++;
+        delete static_cast<StubInstance *>(instance);
+    }
+}
+
+void
+XPLMInstanceSetPosition(XPLMInstanceRef instance, const XPLMDrawInfo_t *new_position, const float * /*data*/)
+{
+    gCounters.instancePositionsSet++;
+    static_cast<StubInstance *>(instance)->position = *new_position;
+}
+
+/********************************************************************************
+ * XPLMPlanes
+ ********************************************************************************/
+
+void
+XPLMCountAircraft(int *outTotalAircraft, int *outActiveAircraft, XPLMPluginID *outController)
+{
+    if (outTotalAircraft) {
+        *outTotalAircraft = 20;
+    }
+    if (outActiveAircraft) {
+        *outActiveAircraft = gActiveAircraft;
+    }
+    if (outController) {
+        *outController = gPlanesController;
+    }
+}
+
+int
+XPLMAcquirePlanes(char ** /*inAircraft*/, XPLMPlanesAvailable_f /*inCallback*/, void * /*inRefcon*/)
+{
+    gPlanesController = XPLMGetMyID();
+    return 1;
+}
+
+void
+XPLMReleasePlanes(void)
+{
+    gPlanesController = XPLM_NO_PLUGIN_ID;
+}
+
+void
+XPLMSetActiveAircraftCount(int inCount)
+{
+    gActiveAircraft = inCount;
+}
+
+/********************************************************************************
+ * XPLMMap
+ ********************************************************************************/
+
+XPLMMapLayerID
+XPLMCreateMapLayer(XPLMCreateMapLayer_t *inParams)
+{
+    unique_ptr<MapLayer> layer(new MapLayer{*inParams});
+    auto *layerPtr = layer.get();
+    gMapLayers.push_back(std::move(layer));
+    return layerPtr;
+}
+
+int
+XPLMDestroyMapLayer(XPLMMapLayerID inLayer)
+{
+    for (auto it = gMapLayers.begin(); it != gMapLayers.end(); ++it) {
+        if (it->get() == inLayer) {
+            gMapLayers.erase(it);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void
+XPLMRegisterMapCreationHook(XPLMMapCreatedCallback_f callback, void * /*refcon*/)
+{
+    gMapCreationHooks.push_back(callback);
+}
+
+int
+XPLMMapExists(const char *mapIdentifier)
+{
+    return (strcmp(mapIdentifier, XPLM_MAP_USER_INTERFACE) == 0) ? 1 : 0;
+}
+
+void
+XPLMMapProject(XPLMMapProjectionID /*projection*/, double latitude, double longitude, float *outX, float *outY)
+{
+    *outX = static_cast<float>(longitude * kMetersPerDegree);
+    *outY = static_cast<float>(latitude * kMetersPerDegree);
+}
+
+void
+XPLMMapUnproject(XPLMMapProjectionID /*projection*/, float mapX, float mapY, double *outLatitude, double *outLongitude)
+{
+    *outLatitude = mapY / kMetersPerDegree;
+    *outLongitude = mapX / kMetersPerDegree;
+}
+
+float
+XPLMMapGetNorthHeading(XPLMMapProjectionID /*projection*/, float /*mapX*/, float /*mapY*/)
+{
+    return 0.0f;
+}
+
+void
+XPLMDrawMapIconFromSheet(XPLMMapLayerID /*layer*/, const char * /*inPngPath*/, int /*s*/, int /*t*/,
+                         int /*ds*/, int /*dt*/, float /*mapX*/, float /*mapY*/,
+                         XPLMMapOrientation /*orientation*/, float /*rotationDegrees*/, float /*mapWidth*/)
+{
+    gCounters.mapIconsDrawn++;
+}
+
+void
+XPLMDrawMapLabel(XPLMMapLayerID /*layer*/, const char * /*inText*/, float /*mapX*/, float /*mapY*/,
+                 XPLMMapOrientation /*orientation*/, float /*rotationDegrees*/)
+{
+    gCounters.mapLabelsDrawn++;
+}
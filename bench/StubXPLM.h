@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef STUBXPLM_H
+#define STUBXPLM_H
+
+#include <string>
+
+/** StubXPLM is a minimal, single threaded, in-process implementation of the
+ * parts of the XPLM that libxplanemp uses, so the library can be driven
+ * without a running simulator.
+ *
+ * It is built against the real SDK headers so the signatures can't drift.
+ * The terrain is a flat plane at 0m, the world to local projection is a
+ * simple equirectangular projection about lat_ref/lon_ref, and objects
+ * "load" on the frame after they were requested.
+ */
+namespace StubXPLM {
+    /** counters for the calls that are interesting to the benchmark */
+    struct Counters {
+        long    instancesCreated = 0;
+        long    instancesDestroyed = 0;
+        long    instancePositionsSet = 0;
+        long    terrainProbes = 0;
+        long    worldToLocalCalls = 0;
+        long    mapIconsDrawn = 0;
+        long    mapLabelsDrawn = 0;
+        long    objectsLoaded = 0;
+        long    objectsUnloaded = 0;
+    };
+
+    /** sets the folder XPLMGetSystemPath() reports.  Must end in a '/'. */
+    void    setSystemPath(const std::string &path);
+
+    /** enables or disables echoing XPLMDebugString to stderr */
+    void    setLogEnabled(bool enabled);
+
+    /** moves the local coordinate origin */
+    void    setReferencePoint(double lat, double lon);
+
+    /** places the camera in local coordinates */
+    void    setCamera(float x, float y, float z, float headingDeg, float pitchDeg, float zoom);
+
+    /** sets the user aircraft's elevation (in meters) */
+    void    setUserElevation(double elevationM);
+
+    /** sets the horizontal visibility reported to the library (in meters) */
+    void    setVisibility(float visibilityM);
+
+    /** controls whether the map layer callbacks are run by runFrame() */
+    void    setMapOpen(bool open);
+
+    /** sets the area the map layers are asked to draw - a square widthM
+     * meters (at the equator) across.
+     */
+    void    setMapView(double lat, double lon, double widthM);
+
+    /** runFrame simulates a single simulator frame: completes any pending
+     * object loads, runs the flight loops, then the TCAS draw callbacks and,
+     * if the map is open, the map layers.
+     */
+    void    runFrame();
+
+    const Counters &getCounters();
+    void    resetCounters();
+}
+
+#endif //STUBXPLM_H
@@ -85,19 +85,46 @@ extern "C" {
  * an existing project.
 */
 
+/**
+ * XPMPCullMode
+ *
+ * These enumerations define what is done with the instances of aircraft that
+ * are outside of the camera's view, or hidden by the horizontal visibility.
+ */
+enum {
+	xpmpCullMode_None,		// keep updating every aircraft's instance
+	xpmpCullMode_Suspend,	// stop updating the instances of aircraft that can't be seen
+	xpmpCullMode_Release	// as Suspend, and release instances that stay unseen for a while
+};
+typedef	int	XPMPCullMode;
+
 /** XPMPConfiguration_t contains all of the configurable paramaters for
  * libxplanemp
  *
- * This is not size-keyed as libxplanemp /should/ be directly linked to it's
- * main consumer, and so there shouldn't be any way for this to be out of step
- * with it's actual use.
+ * The members ahead of size are always read and written.  The ones after it
+ * were added later, and are only read and written if size is set to
+ * sizeof(XPMPConfiguration_t) - set it before calling XPMPGetConfiguration
+ * or XPMPSetConfiguration.  Otherwise the library keeps it's own values for
+ * them.
  */
 typedef struct XPMPConfiguration_s {
 	float					maxFullAircraftRenderingDistance;	/// Beyond what distance do we start using lights-only rendering?
 	bool 					enableSurfaceClamping;		/// do we clamp all aircraft to the surface?
 	struct {
 		bool modelMatching;								/// Enable Verbose Debugging about Model matching
+		bool localProjection;							/// Check the library's world to local conversion against XPLMWorldToLocal and log any discrepancies (slow)
 	} debug;
+	size_t					size;						/// sizeof(XPMPConfiguration_t), if the members below are to be used.
+	float					updateBudgetMs;				/// per-frame time budget for aircraft updates in milliseconds.  Aircraft within maxFullAircraftRenderingDistance always update every frame; more distant aircraft are updated less often when over budget.  0 (the default) updates every aircraft every frame.
+	XPMPCullMode			cullMode;					/// what to do with the instances of aircraft that can't be seen.  See XPMPCullMode.
+	float					interpolationDelay;			/// how far (in seconds) behind the simulator's clock aircraft fed with XPMPPlaneKinematics_t are drawn.  Set this to about the interval between your updates to interpolate rather than extrapolate.
+	int						terrainProbeBudget;			/// the most terrain probes the surface clamping may run per frame, closest aircraft first.  Aircraft that miss out keep their last height until their turn comes.  0 is unlimited.
+	float					lodMinDwell;				/// the least time (in seconds) an aircraft stays in a level of detail band once it's moved into it.  0 lets aircraft change band as soon as they're clear of the boundary.
+	int						instanceCreationBudget;		/// the most new object instances created per frame, closest aircraft first.  Aircraft that miss out keep drawing as they were (or not at all, if they're new) until their turn comes.  0 is unlimited.
+	int						maxObjectLoadsInFlight;		/// the most OBJ8 files loaded at once.  Waiting loads are started closest aircraft first.  0 is unlimited.
+	int						maxLoadedObjects;			/// the most OBJ8 files kept loaded.  Beyond this, the least recently used of the objects no aircraft is using are unloaded (and loaded again when they're next needed).  0 is unlimited.
+	float					prefetchDistance;			/// how far beyond maxFullAircraftRenderingDistance (in the same units) aircraft have their full detail models loaded ahead of time, so they're ready when they come into range.  0 disables this.
+	float					prefetchLeadTime;			/// aircraft closing on maxFullAircraftRenderingDistance fast enough to reach it within this many seconds have their full detail models loaded ahead of time too.  0 disables this.
 } XPMPConfiguration_t;
 
 
@@ -229,9 +256,42 @@ typedef	struct {
 	XPMPTransponderMode		mode;
 } XPMPPlaneSurveillance_t;
 
+/**
+ * XPMPPlaneKinematics_t is a timestamped position sample, with the rates of
+ * change needed to project it forwards.
+ *
+ * Planes fed with kinematics don't need an update every frame - the library
+ * keeps the last few samples and each frame interpolates between them, or
+ * extrapolates from the newest, to find the position, attitude and surfaces
+ * to draw.  Samples can arrive at network rates (a few per second).
+ *
+ * The surfaces of the plane when a sample is given (including any in the
+ * same XPMPUpdate_t) are recorded with it, and the continuous ones (gear,
+ * flaps and so on) are interpolated too.  Lights are always used as-is.
+ *
+ * A XPMPPlanePosition_t in the same update still sets the label, offsetScale
+ * and clampToGround, but the position and attitude come from the samples.
+ */
+typedef struct {
+	size_t	size;
+	double	timestamp;		/// when the sample was taken, in seconds on the XPLMGetElapsedTime() clock
+	double	lat;
+	double	lon;
+	double	elevation;		/// feet above mean sea level
+	float	pitch;
+	float	roll;
+	float	heading;
+	float	velocityNorth;	/// meters per second
+	float	velocityEast;	/// meters per second
+	float	verticalSpeed;	/// feet per minute
+	float	headingRate;	/// degrees per second, positive is clockwise
+} XPMPPlaneKinematics_t;
+
 /**
  * XPMPPlaneID is a unique ID for an aircraft created by a plug-in.
  *
+ * It is an opaque handle, not a pointer.  IDs of destroyed aircraft are never
+ * reissued (until the handle space wraps), so stale IDs can be detected.
  */
 typedef	void *		XPMPPlaneID;
 
@@ -244,6 +304,9 @@ typedef struct {
 	XPMPPlanePosition_t		*position;
 	XPMPPlaneSurfaces_t		*surfaces;
 	XPMPPlaneSurveillance_t *surveillance;
+	/// kinematics can be set to a position sample to interpolate from - see
+	/// XPMPPlaneKinematics_t.  Leave it null to position the plane directly.
+	XPMPPlaneKinematics_t	*kinematics;
 } XPMPUpdate_t;
 
 /************************************************************************************
@@ -400,6 +463,51 @@ XPMPPlaneID	XPMPCreatePlaneWithModelName(
  */
 void			XPMPDestroyPlane(XPMPPlaneID inID);
 
+/** XPMPPostCreatePlane works like XPMPCreatePlane, only it may be called from
+ * any thread.
+ *
+ * The returned ID can be used with the other XPMPPost functions straight
+ * away, but the plane itself (and it's model matching) is only created on
+ * the main thread at the start of the next frame.  Until then the other
+ * functions treat the ID as if the plane doesn't exist.
+ *
+ * Posted planes are only brought to life whilst the library is enabled (see
+ * XPMPMultiplayerEnable()).  They should be destroyed with
+ * XPMPPostDestroyPlane().
+ *
+ * @param inICAOCode ICAO code for the new aircraft
+ * @param inAirline Airline code for the new aircraft
+ * @param inLivery Livery code for the new aircraft
+ * @return an opaque ID for the plane
+ */
+XPMPPlaneID	XPMPPostCreatePlane(
+		const char *			inICAOCode,
+		const char *			inAirline,
+		const char *			inLivery);
+
+/** XPMPPostCreatePlaneWithModelName works like XPMPCreatePlaneWithModelName,
+ * only it may be called from any thread.  See XPMPPostCreatePlane().
+ *
+ * @param inModelName the name of the model to use
+ * @param inICAOCode ICAO code for the new aircraft
+ * @param inAirline Airline code for the new aircraft
+ * @param inLivery Livery code for the new aircraft
+ * @return an opaque ID for the plane
+ */
+XPMPPlaneID	XPMPPostCreatePlaneWithModelName(
+		const char *			inModelName,
+		const char *			inICAOCode,
+		const char *			inAirline,
+		const char *			inLivery);
+
+/** XPMPPostDestroyPlane works like XPMPDestroyPlane, only it may be called
+ * from any thread.  The plane is destroyed at the start of the next frame,
+ * along with any updates posted for it that haven't been applied.
+ *
+ * @param inID the plane to destroy
+ */
+void			XPMPPostDestroyPlane(XPMPPlaneID inID);
+
 /** XPMPChangePlaneModel changes the active model for a plane.
  *
  * @note the Match quality is an integer - lower numbers (greater than 0) are
@@ -436,6 +544,28 @@ void	XPMPSetDefaultPlaneICAO(
  */
 long			XPMPCountPlanes(void);
 
+/** XPMPGetNearestPlanes finds the planes nearest to a point on the earth.
+ *
+ * Only the planes near the point are examined, so this is cheap even with
+ * a large number of planes.  Positions are those from the last
+ * XPMPUpdatePlanes().
+ *
+ * @param inLat the latitude of the point in degrees
+ * @param inLon the longitude of the point in degrees
+ * @param outPlanes receives the IDs of the planes found, nearest first
+ * @param outDistances if not NULL, receives the great circle distance (in
+ *    meters) to each plane found
+ * @param inMaxPlanes the most planes to find - outPlanes and outDistances
+ *    must have room for this many
+ * @return the number of planes found
+ */
+size_t			XPMPGetNearestPlanes(
+	double						inLat,
+	double						inLon,
+	XPMPPlaneID *				outPlanes,
+	double *					outDistances,
+	size_t						inMaxPlanes);
+
 /** XPMPUpdatePlanes performs a bulk update on a number of aircraft positions or
  * states
  *
@@ -448,6 +578,25 @@ void		XPMPUpdatePlanes(
 	size_t						inUpdateSize,
 	size_t						inCount);
 
+/** XPMPPostUpdatePlanes works like XPMPUpdatePlanes, only it may be called
+ * from any thread, and never blocks.
+ *
+ * The updates (and the records they point to) are copied, so the caller can
+ * reuse them as soon as this returns.  They're applied on the main thread at
+ * the start of the next frame - if a plane is posted more than one update in
+ * that time, the newest of each record (position, surfaces and surveillance)
+ * wins.  Kinematics samples aren't coalesced - every one is added, in the
+ * order they were posted.
+ *
+ * @param inUpdates a pointer to the first element of an array of XPMPUpdate_t
+ * @param inUpdateSize the size of a single XPMPUpdate_t structure
+ * @param inCount the total count of elements to process.
+ */
+void		XPMPPostUpdatePlanes(
+	XPMPUpdate_t *				inUpdates,
+	size_t						inUpdateSize,
+	size_t						inCount);
+
 /** XPMPIsICAOValid searches the models loaded to see if
  *
  * This functions searches through our global vector of valid ICAO codes and returns true if there
@@ -497,6 +646,52 @@ int			XPMPModelMatchQuality(
  */
 void		XPMPDumpOneCycle(void);
 
+/** XPMPPhaseStats_t contains the rolling timing statistics for a single phase
+ * of the renderer.
+ *
+ * All times are in milliseconds of wall-clock time per frame, and are taken
+ * over the last 256 frames in which the phase ran.
+ */
+typedef struct {
+	float	lastMs;		/// time taken in the most recent frame
+	float	minMs;		/// fastest frame in the window
+	float	avgMs;		/// mean of the window
+	float	p99Ms;		/// 99th percentile of the window
+} XPMPPhaseStats_t;
+
+/** XPMPRenderStats_t contains the renderer's timing instrumentation.
+ *
+ * The same values are published as read-only datarefs under
+ * `libxplanemp/stats/`.
+ */
+typedef struct {
+	size_t				size;
+	XPMPPhaseStats_t	prepLists;		/// the whole per-frame update
+	XPMPPhaseStats_t	worldToLocal;	/// world to local coordinate conversion
+	XPMPPhaseStats_t	prepare;		/// instance preparation (on the worker pool)
+	XPMPPhaseStats_t	terrainProbe;	/// surface clamping terrain probes
+	XPMPPhaseStats_t	instanceUpdate;	/// pushing instances into the simulator, excluding probes
+	XPMPPhaseStats_t	tcas;			/// selecting and publishing TCAS targets
+	XPMPPhaseStats_t	mapIcons;		/// map icon layer callback
+	XPMPPhaseStats_t	mapLabels;		/// map label layer callback
+	XPMPPhaseStats_t	obj8Load;		/// OBJ8 asynchronous load completion callbacks
+	int					planeCount;		/// planes registered in the most recent frame
+	int					updatedCount;	/// planes updated in the most recent frame
+	int					fullUpdateCount;	/// planes that needed a full update in the most recent frame
+	int					suspendedCount;	/// planes whose instance updates were suspended in the most recent frame
+	XPMPPhaseStats_t	kinematics;		/// interpolating the planes fed with kinematics
+	int					instanceBacklog;	/// planes updated in the most recent frame that are still waiting for the creation budget to make their instances
+	int					matchCacheHits;		/// model matches answered from the match cache since initialisation
+	int					matchCacheMisses;	/// model matches that had to search the CSL packages since initialisation
+} XPMPRenderStats_t;
+
+/** XPMPGetRenderStats gets the renderer's current timing statistics.
+ *
+ * @param outStats location to write the statistics to.  outStats->size must
+ *    be set to sizeof(XPMPRenderStats_t) as known by the caller.
+ */
+void		XPMPGetRenderStats(XPMPRenderStats_t *outStats);
+
 /************************************************************************************
  * MAP RENDERING API
  ************************************************************************************/
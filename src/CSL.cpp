@@ -22,6 +22,7 @@
  *
  */
 
+#include <cmath>
 #include <string>
 #include <cstring>
 #include <XPLMDataAccess.h>
@@ -30,7 +31,9 @@
 #include "CSL.h"
 #include "XPMPMultiplayerVars.h"
 #include "Renderer.h"
+#include "RenderStats.h"
 #include "TCASHack.h"
+#include "TerrainCache.h"
 
 using namespace std;
 
@@ -63,6 +66,39 @@ CSL::getVertOffset() const
 	return 0.0;
 }
 
+double
+CSL::getScaledVertOffset(float offsetScale) const
+{
+	if (offsetScale < 0.0) {
+		return 0.0;
+	}
+	return offsetScale * getVertOffset();
+}
+
+float
+CSL::getBoundingRadius() const
+{
+	// we don't know the extents of the models themselves, but the wake
+	// turbulence category puts a reasonable bound on the size of the aircraft.
+	const auto codeIter = gAircraftCodes.find(mICAO);
+	if (codeIter == gAircraftCodes.end()) {
+		return kBoundingRadiusUnknown;
+	}
+	switch (codeIter->second.category) {
+	case 'L':
+		return 12.0f;
+	case 'M':
+		return 30.0f;
+	case 'V':
+		return 16.0f;
+	case 'H':
+	case 'J':
+		return 45.0f;
+	default:
+		return kBoundingRadiusUnknown;
+	}
+}
+
 VerticalOffsetSource
 CSL::getVertOffsetSource() const
 {
@@ -154,18 +190,17 @@ CSL::drawPlane(CSLInstanceData *instanceData, bool is_blend, int data) const
 }
 
 void
-CSL::updateInstance(const CullInfo &cullInfo,
-                    double &x,
-                    double &y,
-                    double &z,
-                    double roll,
-                    double heading,
-                    double pitch,
-                    bool clampToSurface,
-                    float offsetScale,
-                    xpmp_LightStatus lights,
-                    CSLInstanceData *&instanceData,
-                    XPLMPlaneDrawState_t *state)
+CSL::prepareInstance(const FrameContext &frame,
+                     const CullResult &cull,
+                     double x,
+                     double y,
+                     double z,
+                     double roll,
+                     double heading,
+                     double pitch,
+                     xpmp_LightStatus lights,
+                     CSLInstanceData *&instanceData,
+                     XPLMPlaneDrawState_t *state)
 {
 	if (instanceData == nullptr) {
 		newInstanceData(instanceData);
@@ -174,32 +209,32 @@ CSL::updateInstance(const CullInfo &cullInfo,
 		return;
 	}
 
-	double appliedOffset = 0.0;
-	if (offsetScale >= 0.0) {
-        appliedOffset = offsetScale*getVertOffset();
-	    y += appliedOffset;
-	}
+	instanceData->mX = x;
+	instanceData->mY = y;
+	instanceData->mZ = z;
 
-	// clamp to the surface if enabled
-	if (gConfiguration.enableSurfaceClamping && clampToSurface) {
-		XPLMProbeInfo_t	probeResult = {
-			sizeof(XPLMProbeInfo_t),
-		};
-		XPLMProbeResult r = XPLMProbeTerrainXYZ(gTerrainProbe, x, y, z, &probeResult);
-		if (r == xplm_ProbeHitTerrain) {
-			float minY = probeResult.locationY + getVertOffset();
-			if (y < minY) {
-				y = minY;
-				instanceData->mClamped = true;
-			} else {
-				instanceData->mClamped = false;
-			}
-		}
-	} else {
-	    instanceData->mClamped = false;
+	// distance is taken before surface clamping as the probe can't be run
+	// here - the clamp is never more than a few meters, so it doesn't matter.
+	updateDistanceState(frame, cull, instanceData);
+	instanceData->prepareInstance(this, frame, pitch, roll, heading, lights, state);
+}
+
+bool
+CSL::refreshInstance(const FrameContext &frame, const CullResult &cull, CSLInstanceData *instanceData)
+{
+	if (instanceData == nullptr) {
+		return true;
 	}
+	updateDistanceState(frame, cull, instanceData);
+	return instanceData->needsPrepare(this, frame);
+}
 
-	instanceData->mDistanceSqr = cullInfo.SphereDistanceSqr(x, y, z);
+void
+CSL::updateDistanceState(const FrameContext &frame, const CullResult &cull, CSLInstanceData *instanceData)
+{
+	instanceData->mDistanceSqr = cull.distanceSqr;
+	instanceData->mLod.update(frame, cull);
+	instanceData->mInView = (cull.visibility & CullVisibility_InFrustum) != 0;
 
 	// TCAS checks.
 	instanceData->mTCAS = true;
@@ -209,13 +244,142 @@ CSL::updateInstance(const CullInfo &cullInfo,
 	}
 
 	// we need to assess cull state so we can work out if we need to render labels or not
-	instanceData->mCulled = false;
 	// cull if the aircraft is not visible due to poor horizontal visibility
-	if (gVisDataRef) {
-		float horizVis = XPLMGetDataf(gVisDataRef);
-		if (instanceData->mDistanceSqr > horizVis*horizVis) {
-			instanceData->mCulled = true;
+	instanceData->mCulled = (cull.visibility & CullVisibility_InRange) == 0;
+}
+
+// a plane that's moved less than this (in meters) since it's terrain height
+// was found just reuses it.
+static const double	kTerrainReuseDistance = 0.5;
+// a plane more than kTerrainClearHeight meters above a terrain height found
+// within kTerrainClearRange meters of it can't need clamping.
+static const double	kTerrainClearHeight = 150.0;
+static const double	kTerrainClearRange = 1000.0;
+
+enum class TerrainSource {
+	Sample,		// the plane's own last height
+	Cache,		// the TerrainCache
+	Clear,		// the plane is well clear of the terrain
+	Probe,		// nothing known - the terrain has to be probed
+};
+
+/** findTerrain works out where the terrain height under a prepared instance
+ * can come from without probing, if anywhere.
+ */
+static TerrainSource
+findTerrain(const CSLInstanceData *instanceData, float &outY)
+{
+	if (instanceData->mTerrainEpoch == gTerrainCache.getEpoch()) {
+		const float age = gTerrainCache.getNow() - instanceData->mTerrainTime;
+		if (age >= 0.0f && age < TerrainCache::kMaxAge) {
+			const double dx = instanceData->mX - instanceData->mTerrainX;
+			const double dz = instanceData->mZ - instanceData->mTerrainZ;
+			if (fabs(dx) <= kTerrainReuseDistance && fabs(dz) <= kTerrainReuseDistance) {
+				outY = instanceData->mTerrainY;
+				return TerrainSource::Sample;
+			}
+			if ((dx * dx + dz * dz) <= (kTerrainClearRange * kTerrainClearRange) &&
+			    (instanceData->mY - instanceData->mTerrainY) > kTerrainClearHeight) {
+				return TerrainSource::Clear;
+			}
+		}
+	}
+	if (gTerrainCache.lookup(instanceData->mX, instanceData->mZ, outY)) {
+		return TerrainSource::Cache;
+	}
+	return TerrainSource::Probe;
+}
+
+static void
+recordTerrain(CSLInstanceData *instanceData, float terrainY)
+{
+	instanceData->mTerrainX = instanceData->mX;
+	instanceData->mTerrainZ = instanceData->mZ;
+	instanceData->mTerrainY = terrainY;
+	instanceData->mTerrainTime = gTerrainCache.getNow();
+	instanceData->mTerrainEpoch = gTerrainCache.getEpoch();
+}
+
+bool
+CSL::needsTerrainProbe(const FrameContext &frame, bool clampToSurface, const CSLInstanceData *instanceData) const
+{
+	if (instanceData == nullptr || !frame.config.enableSurfaceClamping || !clampToSurface) {
+		return false;
+	}
+	float terrainY;
+	return findTerrain(instanceData, terrainY) == TerrainSource::Probe;
+}
+
+int
+CSL::countNewInstances(const CSLInstanceData *instanceData)
+{
+	if (instanceData == nullptr) {
+		return 0;
+	}
+	return instanceData->countNewInstances(this);
+}
+
+void
+CSL::applyInstance(const FrameContext &frame, bool clampToSurface, CSLInstanceData *instanceData)
+{
+	if (instanceData == nullptr) {
+		return;
+	}
+
+	// clamp to the surface if enabled
+	instanceData->mTerrainDeferred = false;
+	if (frame.config.enableSurfaceClamping && clampToSurface) {
+		float terrainY = 0.0f;
+		bool found = false;
+		switch (findTerrain(instanceData, terrainY)) {
+		case TerrainSource::Sample:
+			found = true;
+			break;
+		case TerrainSource::Cache:
+			recordTerrain(instanceData, terrainY);
+			found = true;
+			break;
+		case TerrainSource::Clear:
+			break;
+		case TerrainSource::Probe:
+			if (gTerrainCache.canProbe(instanceData->mDistanceSqr)) {
+				found = gTerrainCache.probe(instanceData->mX, instanceData->mY, instanceData->mZ, terrainY);
+				if (found) {
+					recordTerrain(instanceData, terrainY);
+				}
+			} else {
+				// over the budget - make do with the last height we had, and
+				// come back for a probe next frame.
+				instanceData->mTerrainDeferred = true;
+				found = (instanceData->mTerrainEpoch == gTerrainCache.getEpoch());
+				terrainY = instanceData->mTerrainY;
+			}
+			break;
+		}
+		instanceData->mClamped = false;
+		if (found) {
+			float minY = terrainY + getVertOffset();
+			if (instanceData->mY < minY) {
+				instanceData->mY = minY;
+				instanceData->mClamped = true;
+			}
 		}
+	} else {
+	    instanceData->mClamped = false;
 	}
-	instanceData->updateInstance(this, x, y, z, pitch, roll, heading, lights, state);
-}
\ No newline at end of file
+	instanceData->applyInstance(this);
+	instanceData->mReleased = false;
+	instanceData->mDrawnX = static_cast<float>(instanceData->mX);
+	instanceData->mDrawnY = static_cast<float>(instanceData->mY);
+	instanceData->mDrawnZ = static_cast<float>(instanceData->mZ);
+}
+
+void
+CSL::releaseInstance(CSLInstanceData *instanceData)
+{
+	if (instanceData == nullptr || instanceData->mReleased) {
+		return;
+	}
+	instanceData->releaseInstance(this);
+	instanceData->mReleased = true;
+}
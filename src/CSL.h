@@ -25,12 +25,14 @@
 #ifndef CSL_H
 #define CSL_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <XPLMPlanes.h>
 #include <XPMPMultiplayer.h>
 
-#include "CullInfo.h"
+#include "FrameContext.h"
+#include "LodState.h"
 
 // forward declare XPMPPlane - we can't access it's details, but we can record info.
 class XPMPPlane;
@@ -50,6 +52,34 @@ public:
     bool mTCAS = false;
     bool mCulled = false;
     bool mClamped = false;
+    bool mPending = false;     // some parts could not be instanced yet (e.g. still loading)
+    bool mInView = false;      // the plane's bounding sphere is within the view frustum
+    LodState mLod;             // the level of detail band, with hysteresis
+
+    // culling state - see XPMPPlane::updateSuspension
+    bool mSuspended = false;   // instance updates are suspended as the plane can't be seen
+    bool mReleased = false;    // the instance has been released while suspended
+    float mCulledSince = -1.0f;    // simulator time the plane was first found culled, or < 0 if it's visible
+
+    // the local (OpenGL) position the instance will be drawn at this frame.
+    double mX = 0.0;
+    double mY = 0.0;
+    double mZ = 0.0;
+
+    // the position the instance was last pushed into the simulator at.
+    float mDrawnX = 0.0f;
+    float mDrawnY = 0.0f;
+    float mDrawnZ = 0.0f;
+
+    // the last terrain height found for the plane by the surface clamping,
+    // and where and when it was found - see CSL::applyInstance.
+    double mTerrainX = 0.0;
+    double mTerrainZ = 0.0;
+    float mTerrainY = 0.0f;
+    float mTerrainTime = 0.0f;
+    uint32_t mTerrainEpoch = 0;    // the TerrainCache epoch of the height, 0 if there isn't one
+    bool mTerrainDeferred = false; // the plane needed a probe, but the budget had run out
+    bool mCreationDeferred = false; // the plane needed new instances, but the creation budget had run out
 
     virtual ~CSLInstanceData() = default;
 
@@ -58,29 +88,72 @@ public:
 protected:
     CSLInstanceData() = default;
 
-    /** the CSL parent class uses this method to update the individual
-     * instances
+    /** the CSL parent class uses this method to prepare the individual
+     * instances for update.
+     *
+     * This is called from the renderer's worker threads, so it must only
+     * perform calculations - it must not call into the XPLM.  The position
+     * to draw at is available in mX, mY and mZ.
      *
      * @param csl the CSL record performing the update
-     * @param x X coordinate of the instance (in world units)
-     * @param y Y coordinate of the instance (in world units)
-     * @param z Z coordinate of the instance (in world units)
+     * @param frame the FrameContext for this frame
      * @param pitch
      * @param roll
      * @param heading
      * @param lights xpmp_LightStatus containing the light states for this instance
      * @param state XPLMPlaneDrawState_t containing the aircraft state for this instance
      */
-    virtual void updateInstance(
+    virtual void prepareInstance(
         CSL *csl,
-        double x,
-        double y,
-        double z,
+        const FrameContext &frame,
         double pitch,
         double roll,
         double heading,
         xpmp_LightStatus lights,
         XPLMPlaneDrawState_t *state) = 0;
+
+    /** the CSL parent class uses this method to push the prepared state into
+     * the simulator.  This is always called from the main thread.
+     *
+     * @param csl the CSL record performing the update
+     */
+    virtual void applyInstance(CSL *csl) = 0;
+
+    /** the CSL parent class uses this method to release the simulator's
+     * instances while keeping the prepared state.  The next applyInstance
+     * must create them again.  This is always called from the main thread.
+     *
+     * @param csl the CSL record performing the update
+     */
+    virtual void releaseInstance(CSL * /*csl*/)
+    {
+    }
+
+    /** the CSL parent class uses this method to find out if the instance
+     * must be prepared again as a result of the distance changing (e.g.
+     * because a different level of detail is now required).
+     *
+     * This is called from the renderer's worker threads.
+     *
+     * @param csl the CSL record performing the update
+     * @param frame the FrameContext for this frame
+     * @return true if the instance needs to be prepared again.
+     */
+    virtual bool needsPrepare(CSL * /*csl*/, const FrameContext & /*frame*/) const
+    {
+        return false;
+    }
+
+    /** the CSL parent class uses this method to find out how many new
+     * simulator instances applyInstance would have to create for the
+     * prepared state.  This is always called from the main thread.
+     *
+     * @param csl the CSL record performing the update
+     */
+    virtual int countNewInstances(CSL * /*csl*/) const
+    {
+        return 0;
+    }
 };
 
 /** a CSL represents a single multiplayer aircraft model with livery that can be
@@ -116,6 +189,29 @@ public:
 
     void setVerticalOffset(VerticalOffsetSource src, double offset);
 
+    /** getModelVertOffset returns the vertical offset given in the model
+     * definition, whether or not it's the one in use.
+     */
+    double getModelVertOffset() const { return mModelVertOffset; }
+
+    /** getDirNames returns the relative path components to the location of
+     * the CSL's xsb_aircraft.txt.
+     */
+    const std::vector<std::string> &getDirNames() const { return mDirNames; }
+
+    /** getScaledVertOffset returns the vertical offset to apply for a plane
+     * with the given offsetScale.  A negative scale disables the offset.
+     */
+    double getScaledVertOffset(float offsetScale) const;
+
+    /** getBoundingRadius returns the radius (in meters) of a sphere that
+     * contains the aircraft, for culling.
+     *
+     * This looks up the CSL's ICAO type in doc8643, so must only be called
+     * from the main thread.
+     */
+    float getBoundingRadius() const;
+
     /** getModelName should return a meaningful name to reference the CSL in question
      *
      * @returns a string identifying the particular model in use
@@ -167,33 +263,94 @@ public:
 
     std::string getLivery() const;
 
-    /** updateInstance updates the instanceData for rendering this frame.  If
-     * the instanceData is not initialised, this method invokes the
+    /** prepareInstance prepares the instanceData for rendering this frame.
+     * If the instanceData is not initialised, this method invokes the
      * newInstanceData virtual method to produce it.
      *
-     * @param cullInfo the CullInfo to use to cull objects
+     * This only performs calculations and is safe to call from the
+     * renderer's worker threads.
+     *
+     * @param frame the FrameContext for this frame
+     * @param cull the CullKernel results for the plane at x, y, z
      * @param x
      * @param y
-     * @param z
+     * @param z the position to draw at, including the vertical offset
      * @param pitch
      * @param roll
      * @param heading
      * @param lights
-     * @param state
      * @param instanceData the instanceData pointer in the XPMPPlane for this plane
+     * @param state
+     */
+    virtual void prepareInstance(const FrameContext &frame,
+                                 const CullResult &cull,
+                                 double x,
+                                 double y,
+                                 double z,
+                                 double roll,
+                                 double heading,
+                                 double pitch,
+                                 xpmp_LightStatus lights,
+                                 CSLInstanceData *&instanceData,
+                                 XPLMPlaneDrawState_t *state);
+
+    /** refreshInstance updates the distance dependent state (distance,
+     * TCAS range and culling) of an already prepared instance for the
+     * current camera, without preparing it again.
+     *
+     * This only performs calculations and is safe to call from the
+     * renderer's worker threads.
+     *
+     * @param frame the FrameContext for this frame
+     * @param cull the CullKernel results for the instance's current position
+     * @param instanceData the instanceData previously prepared by prepareInstance
+     * @return true if the instance needs to be fully prepared again.
+     */
+    virtual bool refreshInstance(const FrameContext &frame,
+                                 const CullResult &cull,
+                                 CSLInstanceData *instanceData);
+
+    /** applyInstance performs the surface clamping for the prepared
+     * instanceData and then pushes it into the simulator.
+     *
+     * This calls into the XPLM, and must only be called from the main thread.
+     *
+     * @param frame the FrameContext for this frame
+     * @param clampToSurface true if the plane wants to be clamped to the surface
+     * @param instanceData the instanceData prepared by prepareInstance
      */
-    virtual void updateInstance(const CullInfo &cullInfo,
-                                double &x,
-                                double &y,
-                                double &z,
-                                double roll,
-                                double heading,
-                                double pitch,
-                                bool clampToSurface,
-                                float offsetScale,
-                                xpmp_LightStatus lights,
-                                CSLInstanceData *&instanceData,
-                                XPLMPlaneDrawState_t *state);
+    virtual void applyInstance(const FrameContext &frame,
+                               bool clampToSurface,
+                               CSLInstanceData *instanceData);
+
+    /** needsTerrainProbe returns true if applyInstance would have to probe
+     * the terrain to clamp the prepared instanceData to the surface.
+     *
+     * @param frame the FrameContext for this frame
+     * @param clampToSurface true if the plane wants to be clamped to the surface
+     * @param instanceData the instanceData prepared by prepareInstance
+     */
+    bool needsTerrainProbe(const FrameContext &frame,
+                           bool clampToSurface,
+                           const CSLInstanceData *instanceData) const;
+
+    /** countNewInstances returns the number of simulator instances
+     * applyInstance would have to create (rather than reuse) for the
+     * prepared instanceData.
+     *
+     * @param instanceData the instanceData prepared by prepareInstance
+     */
+    int countNewInstances(const CSLInstanceData *instanceData);
+
+    /** releaseInstance releases the simulator's instances for the
+     * instanceData, but keeps the prepared state, so the next applyInstance
+     * recreates them.
+     *
+     * This calls into the XPLM, and must only be called from the main thread.
+     *
+     * @param instanceData the instanceData to release
+     */
+    virtual void releaseInstance(CSLInstanceData *instanceData);
 
     /* drawPlane is responsible for rendering the plane.
      */
@@ -210,6 +367,13 @@ public:
 protected:
     CSL();
 
+    /** updateDistanceState records the distance, TCAS range, cull and LOD
+     * state for the instance from the CullKernel results.
+     */
+    static void updateDistanceState(const FrameContext &frame,
+                                    const CullResult &cull,
+                                    CSLInstanceData *instanceData);
+
     /** Initialise the common internal structures in the CSL abstract.
      *
      * @param dirNames Relative path components (POSIX style) to the location
@@ -0,0 +1,449 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "CSLIndex.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#include <sys/stat.h>
+
+#include "obj8/Obj8CSL.h"
+
+using namespace std;
+
+const char *	CSLIndex::kFileName = "xpmp_csl_index.bin";
+
+// bump kVersion whenever the layout changes.  The index is written in the
+// machine's own byte order - kByteOrder catches it being moved to another.
+static const char		kMagic[8] = {'X', 'P', 'M', 'P', 'C', 'S', 'L', 'I'};
+static const uint32_t	kVersion = 2;
+static const uint32_t	kByteOrder = 0x01020304;
+
+// the draw types, in the order their attachments are written.
+static const Obj8DrawType	kDrawTypes[] = {
+	Obj8DrawType::LightsOnly,
+	Obj8DrawType::LowLevelOfDetail,
+	Obj8DrawType::Solid,
+};
+
+static uint64_t
+fnv1a(const string &str, uint64_t hash = 14695981039346656037ULL)
+{
+	for (const char c: str) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ULL;
+	}
+	// include the terminator, so "ab","c" and "a","bc" differ.
+	hash *= 1099511628211ULL;
+	return hash;
+}
+
+namespace {
+	/** IndexReader reads values out of the index, checking it doesn't run
+	 * off the end.  Once a read has failed, every read after it fails too.
+	 */
+	class IndexReader {
+	public:
+		IndexReader(const char *data, size_t size) :
+			mData(data),
+			mSize(size),
+			mPos(0),
+			mOk(true)
+		{
+		}
+
+		template<typename T>
+		T	read()
+		{
+			T value{};
+			if (!mOk || sizeof(T) > mSize - mPos) {
+				mOk = false;
+				return value;
+			}
+			memcpy(&value, mData + mPos, sizeof(T));
+			mPos += sizeof(T);
+			return value;
+		}
+
+		void	readString(string &outString)
+		{
+			const auto length = read<uint32_t>();
+			if (!mOk || length > mSize - mPos) {
+				mOk = false;
+				return;
+			}
+			outString.assign(mData + mPos, length);
+			mPos += length;
+		}
+
+		/** reads a string table id, and checks it against the table */
+		const string &	readStringId(const vector<string> &strings)
+		{
+			static const string kEmpty;
+			const auto id = read<uint32_t>();
+			if (!mOk || id >= strings.size()) {
+				mOk = false;
+				return kEmpty;
+			}
+			return strings[id];
+		}
+
+		bool	ok() const { return mOk; }
+		size_t	position() const { return mPos; }
+
+	private:
+		const char *	mData;
+		size_t			mSize;
+		size_t			mPos;
+		bool			mOk;
+	};
+
+	/** IndexWriter builds up the index, interning the strings as it goes. */
+	class IndexWriter {
+	public:
+		template<typename T>
+		void	write(vector<char> &out, T value)
+		{
+			const auto *bytes = reinterpret_cast<const char *>(&value);
+			out.insert(out.end(), bytes, bytes + sizeof(T));
+		}
+
+		void	writeString(vector<char> &out, const string &str)
+		{
+			write<uint32_t>(out, static_cast<uint32_t>(str.size()));
+			out.insert(out.end(), str.begin(), str.end());
+		}
+
+		void	writeStringId(vector<char> &out, const string &str)
+		{
+			auto id = mStringIds.find(str);
+			if (id == mStringIds.end()) {
+				id = mStringIds.emplace(str, static_cast<uint32_t>(mStrings.size())).first;
+				mStrings.push_back(&id->first);
+			}
+			write<uint32_t>(out, id->second);
+		}
+
+		const vector<const string *> &	getStrings() const { return mStrings; }
+
+	private:
+		unordered_map<string, uint32_t>	mStringIds;
+		vector<const string *>			mStrings;	// in id order
+	};
+}
+
+bool
+CSLIndex::getFileKey(const string &path, FileKey &outKey)
+{
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) {
+		return false;
+	}
+	outKey.mtime = static_cast<int64_t>(info.st_mtime);
+	outKey.size = static_cast<uint64_t>(info.st_size);
+	return true;
+}
+
+uint64_t
+CSLIndex::fingerprintGroups(const unordered_map<string, string> &groups)
+{
+	// summed, so the map's order doesn't matter.
+	uint64_t fingerprint = groups.size();
+	for (const auto &group: groups) {
+		fingerprint += fnv1a(group.second, fnv1a(group.first));
+	}
+	return fingerprint;
+}
+
+uint64_t
+CSLIndex::fingerprintPackages(const vector<CSLPackage_t> &packages)
+{
+	uint64_t fingerprint = fnv1a(string());
+	for (const auto &package: packages) {
+		fingerprint = fnv1a(package.path, fnv1a(package.name, fingerprint));
+	}
+	return fingerprint;
+}
+
+bool
+CSLIndex::load(const string &path, const string &systemPath, uint64_t groupsFingerprint)
+{
+	mData.clear();
+	mStrings.clear();
+	mEntries.clear();
+	mPackagesFingerprint = 0;
+
+	ifstream in(path, ios::in | ios::binary | ios::ate);
+	if (!in) {
+		return false;
+	}
+	const auto size = static_cast<size_t>(in.tellg());
+	in.seekg(0);
+	mData.resize(size);
+	if (!in.read(mData.data(), static_cast<streamsize>(size))) {
+		mData.clear();
+		return false;
+	}
+
+	IndexReader reader(mData.data(), mData.size());
+	char magic[sizeof(kMagic)];
+	for (auto &c: magic) {
+		c = reader.read<char>();
+	}
+	const auto version = reader.read<uint32_t>();
+	const auto byteOrder = reader.read<uint32_t>();
+	const auto fileGroupsFingerprint = reader.read<uint64_t>();
+	mPackagesFingerprint = reader.read<uint64_t>();
+	string fileSystemPath;
+	reader.readString(fileSystemPath);
+	if (!reader.ok() || memcmp(magic, kMagic, sizeof(kMagic)) != 0 || version != kVersion ||
+	    byteOrder != kByteOrder || fileGroupsFingerprint != groupsFingerprint || fileSystemPath != systemPath) {
+		mData.clear();
+		return false;
+	}
+
+	const auto stringCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; i < stringCount && reader.ok(); i++) {
+		mStrings.emplace_back();
+		reader.readString(mStrings.back());
+	}
+
+	const auto packageCount = reader.read<uint32_t>();
+	vector<pair<const string *, Entry>> entries;
+	for (uint32_t i = 0; i < packageCount && reader.ok(); i++) {
+		Entry entry;
+		const auto &packagePath = reader.readStringId(mStrings);
+		entry.name = reader.readStringId(mStrings);
+		entry.key.mtime = reader.read<int64_t>();
+		entry.key.size = reader.read<uint64_t>();
+		entry.bodyOffset = static_cast<size_t>(reader.read<uint64_t>());
+		entry.bodySize = static_cast<size_t>(reader.read<uint64_t>());
+		entries.emplace_back(&packagePath, move(entry));
+	}
+	// the bodies follow the entries - their offsets are from there.
+	const size_t bodiesStart = reader.position();
+	if (!reader.ok()) {
+		mData.clear();
+		mStrings.clear();
+		return false;
+	}
+	for (auto &entry: entries) {
+		entry.second.bodyOffset += bodiesStart;
+		if (entry.second.bodyOffset > mData.size() || entry.second.bodySize > mData.size() - entry.second.bodyOffset) {
+			continue;
+		}
+		mEntries[*entry.first] = move(entry.second);
+	}
+	return true;
+}
+
+const CSLIndex::Entry *
+CSLIndex::find(const string &packagePath, const FileKey &key) const
+{
+	auto entry = mEntries.find(packagePath);
+	if (entry == mEntries.end() || !(entry->second.key == key)) {
+		return nullptr;
+	}
+	return &entry->second;
+}
+
+bool
+CSLIndex::readPackage(const Entry &entry, CSLPackage_t &outPackage) const
+{
+	IndexReader reader(mData.data() + entry.bodyOffset, entry.bodySize);
+
+	// the CSLs are owned by the package once they're in it - until then,
+	// they're thrown away if anything goes wrong.
+	vector<unique_ptr<Obj8CSL>> planes;
+	const auto planeCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; i < planeCount && reader.ok(); i++) {
+		vector<string> dirNames(reader.read<uint32_t>());
+		if (!reader.ok() || dirNames.size() > entry.bodySize) {
+			return false;
+		}
+		for (auto &dirName: dirNames) {
+			dirName = reader.readStringId(mStrings);
+		}
+		const auto &objectName = reader.readStringId(mStrings);
+		const auto &icao = reader.readStringId(mStrings);
+		const auto &airline = reader.readStringId(mStrings);
+		const auto &livery = reader.readStringId(mStrings);
+		const auto hasModelOffset = reader.read<uint8_t>() != 0;
+		const auto modelOffset = reader.read<double>();
+		const auto movingGear = reader.read<uint8_t>() != 0;
+		if (!reader.ok()) {
+			return false;
+		}
+
+		auto csl = unique_ptr<Obj8CSL>(new Obj8CSL(move(dirNames), objectName));
+		csl->setLivery(icao, airline, livery);
+		if (hasModelOffset) {
+			csl->setVerticalOffset(VerticalOffsetSource::Model, modelOffset);
+		}
+		csl->setMovingGear(movingGear);
+		for (const auto drawType: kDrawTypes) {
+			const auto attachmentCount = reader.read<uint32_t>();
+			for (uint32_t j = 0; j < attachmentCount && reader.ok(); j++) {
+				const auto &file = reader.readStringId(mStrings);
+				if (reader.ok()) {
+					csl->addAttachment(drawType, Obj8Attachment::getAttachmentForFile(file));
+				}
+			}
+		}
+		planes.push_back(move(csl));
+	}
+
+	// the keys are stored as strings, as the MatchIds differ from run to run.
+	MatchTable matches[match_count];
+	for (auto &table: matches) {
+		const auto matchCount = reader.read<uint32_t>();
+		for (uint32_t i = 0; i < matchCount && reader.ok(); i++) {
+			const auto &type = reader.readStringId(mStrings);
+			const auto &airline = reader.readStringId(mStrings);
+			const auto &livery = reader.readStringId(mStrings);
+			const auto planeIndex = reader.read<int32_t>();
+			if (planeIndex < 0 || static_cast<size_t>(planeIndex) >= planes.size()) {
+				return false;
+			}
+			table.add(MatchKey{MatchIds::intern(type), MatchIds::intern(airline), MatchIds::intern(livery)}, planeIndex);
+		}
+	}
+	if (!reader.ok()) {
+		return false;
+	}
+
+	for (auto &csl: planes) {
+		outPackage.planes.push_back(csl.release());
+	}
+	for (int i = 0; i < match_count; i++) {
+		outPackage.matches[i] = move(matches[i]);
+	}
+	return true;
+}
+
+bool
+CSLIndex::write(const string &path,
+                const string &systemPath,
+                uint64_t groupsFingerprint,
+                uint64_t packagesFingerprint,
+                const vector<PackageRecord> &packages)
+{
+	IndexWriter writer;
+
+	// the bodies go first, so the string table has everything in it.
+	vector<char> bodies;
+	vector<pair<size_t, size_t>> bodyRanges;
+	for (const auto &record: packages) {
+		const size_t bodyStart = bodies.size();
+		const auto &package = *record.package;
+		writer.write<uint32_t>(bodies, static_cast<uint32_t>(package.planes.size()));
+		for (const auto *plane: package.planes) {
+			const auto *csl = dynamic_cast<const Obj8CSL *>(plane);
+			if (csl == nullptr) {
+				return false;
+			}
+			writer.write<uint32_t>(bodies, static_cast<uint32_t>(csl->getDirNames().size()));
+			for (const auto &dirName: csl->getDirNames()) {
+				writer.writeStringId(bodies, dirName);
+			}
+			writer.writeStringId(bodies, csl->getObjectName());
+			writer.writeStringId(bodies, csl->getICAO());
+			writer.writeStringId(bodies, csl->getAirline());
+			writer.writeStringId(bodies, csl->getLivery());
+			// only the model's own offset comes from the package - the others
+			// are filled in after it's loaded.
+			writer.write<uint8_t>(bodies, (csl->getVertOffsetSource() != VerticalOffsetSource::None) ? 1 : 0);
+			writer.write<double>(bodies, csl->getModelVertOffset());
+			writer.write<uint8_t>(bodies, csl->getMovingGear() ? 1 : 0);
+			for (const auto drawType: kDrawTypes) {
+				const auto *attachments = csl->getAttachmentsFor(drawType);
+				const size_t attachmentCount = (attachments != nullptr) ? attachments->size() : 0;
+				writer.write<uint32_t>(bodies, static_cast<uint32_t>(attachmentCount));
+				for (size_t j = 0; j < attachmentCount; j++) {
+					writer.writeStringId(bodies, (*attachments)[j]->getFile());
+				}
+			}
+		}
+		for (const auto &table: package.matches) {
+			writer.write<uint32_t>(bodies, static_cast<uint32_t>(table.size()));
+			for (const auto &match: table.getEntries()) {
+				writer.writeStringId(bodies, MatchIds::getName(match.key.type));
+				writer.writeStringId(bodies, MatchIds::getName(match.key.airline));
+				writer.writeStringId(bodies, MatchIds::getName(match.key.livery));
+				writer.write<int32_t>(bodies, match.plane);
+			}
+		}
+		bodyRanges.emplace_back(bodyStart, bodies.size() - bodyStart);
+	}
+
+	// the entries' names and paths are interned before the table is written.
+	vector<char> entries;
+	for (size_t i = 0; i < packages.size(); i++) {
+		const auto &record = packages[i];
+		writer.writeStringId(entries, record.package->path);
+		writer.writeStringId(entries, record.package->name);
+		writer.write<int64_t>(entries, record.key.mtime);
+		writer.write<uint64_t>(entries, record.key.size);
+		writer.write<uint64_t>(entries, bodyRanges[i].first);
+		writer.write<uint64_t>(entries, bodyRanges[i].second);
+	}
+
+	vector<char> data(kMagic, kMagic + sizeof(kMagic));
+	writer.write<uint32_t>(data, kVersion);
+	writer.write<uint32_t>(data, kByteOrder);
+	writer.write<uint64_t>(data, groupsFingerprint);
+	writer.write<uint64_t>(data, packagesFingerprint);
+	writer.writeString(data, systemPath);
+	writer.write<uint32_t>(data, static_cast<uint32_t>(writer.getStrings().size()));
+	for (const auto *str: writer.getStrings()) {
+		writer.writeString(data, *str);
+	}
+	writer.write<uint32_t>(data, static_cast<uint32_t>(packages.size()));
+	data.insert(data.end(), entries.begin(), entries.end());
+	data.insert(data.end(), bodies.begin(), bodies.end());
+
+	// written alongside and then moved into place, so a reader never sees
+	// half an index.
+	const string tempPath = path + ".tmp";
+	{
+		ofstream out(tempPath, ios::out | ios::binary | ios::trunc);
+		if (!out || !out.write(data.data(), static_cast<streamsize>(data.size()))) {
+			out.close();
+			remove(tempPath.c_str());
+			return false;
+		}
+	}
+	if (rename(tempPath.c_str(), path.c_str()) != 0) {
+		// Windows won't rename over an existing file.
+		remove(path.c_str());
+		if (rename(tempPath.c_str(), path.c_str()) != 0) {
+			remove(tempPath.c_str());
+			return false;
+		}
+	}
+	return true;
+}
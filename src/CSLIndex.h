@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef CSLINDEX_H
+#define CSLINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "XPMPMultiplayerVars.h"
+
+/** CSLIndex is a binary cache of parsed CSL packages, so an unchanged
+ * library doesn't have to be parsed from text every time it's loaded.
+ *
+ * There's one index file per folder passed to CSL_LoadCSL.  Each package's
+ * entry is keyed by the modification time and size of it's
+ * xsb_aircraft.txt, and the index as a whole is only used if the X-Plane
+ * system path, the related.txt groups and the names and paths of all the
+ * loaded packages are the same as when it was written - any of these
+ * change the results of the parse.
+ *
+ * Strings are interned in a single table shared by all of the entries.
+ * The file is read in one go when it's loaded, and the entries are only
+ * decoded for the packages that are actually used.
+ */
+class CSLIndex {
+public:
+	/** the name of the index file in the CSL folder */
+	static const char *	kFileName;
+
+	/** the modification time and size of a package's xsb_aircraft.txt */
+	struct FileKey {
+		int64_t		mtime = 0;
+		uint64_t	size = 0;
+
+		bool operator==(const FileKey &rhs) const { return mtime == rhs.mtime && size == rhs.size; }
+	};
+
+	/** a package from the index */
+	struct Entry {
+		std::string	name;
+		FileKey		key;
+		size_t		bodyOffset;
+		size_t		bodySize;
+	};
+
+	/** a package to write to the index */
+	struct PackageRecord {
+		const CSLPackage_t *	package;
+		FileKey					key;
+	};
+
+	/** getFileKey finds the FileKey for the file at path.
+	 *
+	 * @return false if the file couldn't be found.
+	 */
+	static bool		getFileKey(const std::string &path, FileKey &outKey);
+
+	/** fingerprintGroups returns a hash of the related.txt groups.  It doesn't
+	 * depend on the order of the map.
+	 */
+	static uint64_t	fingerprintGroups(const std::unordered_map<std::string, std::string> &groups);
+
+	/** fingerprintPackages returns a hash of the names and paths of the
+	 * packages.
+	 */
+	static uint64_t	fingerprintPackages(const std::vector<CSLPackage_t> &packages);
+
+	/** load reads the index file at path.
+	 *
+	 * @param path the index file
+	 * @param systemPath the X-Plane system path
+	 * @param groupsFingerprint the fingerprintGroups() of the related.txt groups
+	 * @return true if the index was read and was written for the same
+	 *   system path and groups.  Otherwise, the index is left empty.
+	 */
+	bool			load(const std::string &path, const std::string &systemPath, uint64_t groupsFingerprint);
+
+	/** returns the fingerprintPackages() of the packages loaded when the
+	 * index was written.
+	 */
+	uint64_t		getPackagesFingerprint() const { return mPackagesFingerprint; }
+
+	/** find returns the entry for the package at packagePath, if there is one
+	 * and it's xsb_aircraft.txt hasn't changed since.
+	 */
+	const Entry *	find(const std::string &packagePath, const FileKey &key) const;
+
+	/** readPackage decodes an entry's planes and match tables into
+	 * outPackage.  The package's name and path are left alone.
+	 *
+	 * This doesn't change the index, so can be used by several threads at
+	 * once.
+	 *
+	 * @return false if the entry is damaged, in which case outPackage is left
+	 *   alone.
+	 */
+	bool			readPackage(const Entry &entry, CSLPackage_t &outPackage) const;
+
+	/** write writes an index for packages to path.
+	 *
+	 * @return false if the packages couldn't all be written, or the file
+	 *   couldn't be written.
+	 */
+	static bool		write(const std::string &path,
+	                      const std::string &systemPath,
+	                      uint64_t groupsFingerprint,
+	                      uint64_t packagesFingerprint,
+	                      const std::vector<PackageRecord> &packages);
+
+private:
+	std::vector<char>						mData;
+	std::vector<std::string>				mStrings;
+	std::unordered_map<std::string, Entry>	mEntries;		// by package path
+	uint64_t								mPackagesFingerprint = 0;
+};
+
+#endif //CSLINDEX_H
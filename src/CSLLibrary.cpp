@@ -24,12 +24,11 @@
 
 #include <algorithm>
 #include <fstream>
-#include <sstream>
-#include <functional>
 #include <string>
 #include <unordered_map>
 
 #include <cstdio>
+#include <cstdlib>
 #include <cerrno>
 #include <cstring>
 #include <cctype>
@@ -39,6 +38,9 @@
 
 #include "XPMPMultiplayer.h"
 #include "CSLLibrary.h"
+#include "CSLIndex.h"
+#include "RenderStats.h"
+#include "WorkerPool.h"
 #include "XStringUtils.h"
 #include "XUtils.h"
 #include "obj8/Obj8CSL.h"
@@ -61,6 +63,10 @@ enum
 	pass_Depend, pass_Load, pass_Count
 };
 
+// the simulator's system path, looked up once per CSL_LoadCSL as the
+// packages are parsed off the main thread.
+static string		gSystemPath;
+
 /************************************************************************
  * UTILITY ROUTINES
  ************************************************************************/
@@ -76,6 +82,19 @@ MakePartialPathNativeObj(string &io_str)
 	}
 }
 
+// returns the related.txt group for icao, or an empty string if it isn't
+// in one.  This doesn't add to gGroupings, so it's safe to use whilst the
+// packages are parsed in parallel.
+static std::string
+GetGroup(const std::string &icao)
+{
+	auto group = gGroupings.find(icao);
+	if (group == gGroupings.end()) {
+		return std::string();
+	}
+	return group->second;
+}
+
 static bool
 DoPackageSub(std::string &ioPath)
 {
@@ -93,9 +112,157 @@ DoPackageSub(std::string &ioPath)
  * CSL LOADING
  ************************************************************************/
 
+/** GetFileContent reads the whole of a file into outContent.
+ *
+ * @return false if the file couldn't be read.
+ */
+static bool
+GetFileContent(const std::string &filename, std::string &outContent)
+{
+	std::ifstream in(filename, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!in) {
+		return false;
+	}
+	const auto size = in.tellg();
+	if (size < 0) {
+		return false;
+	}
+	in.seekg(0);
+	outContent.resize(static_cast<size_t>(size));
+	return static_cast<bool>(in.read(&outContent[0], size));
+}
+
+/** PackageLine is a single line of an xsb_aircraft.txt.  It's tokens are
+ * the tokenCount from firstToken in it's PackageFile's tokens.
+ */
+struct PackageLine {
+	int			lineNum;
+	StringRef	line;
+	size_t		firstToken;
+	size_t		tokenCount;
+};
+
+/** PackageFile is an xsb_aircraft.txt, read and tokenized - once - for both
+ * the header and the full parse.  The lines and tokens all refer to
+ * content, so aren't copied.  Packages with an up to date entry in the
+ * CSLIndex aren't read at all.
+ */
+struct PackageFile {
+	std::string					packagePath;
+	std::string					filePath;
+	std::string					content;
+	std::vector<StringRef>		tokens;
+	std::vector<PackageLine>	lines;
+	CSLIndex::FileKey			key;
+	const CSLIndex::Entry *		cached;
+};
+
+/** PackageTokens are the tokens of a single PackageLine. */
+class PackageTokens {
+public:
+	PackageTokens(const PackageFile &file, const PackageLine &line) :
+		mTokens(file.tokens.data() + line.firstToken),
+		mCount(line.tokenCount)
+	{
+	}
+
+	size_t				size() const { return mCount; }
+	const StringRef &	operator[](size_t i) const { return mTokens[i]; }
+
+private:
+	const StringRef *	mTokens;
+	size_t				mCount;
+};
+
+/** TokenizePackage splits file's content into lines and tokens, skipping
+ * the blank lines and comments.
+ */
+static void
+TokenizePackage(PackageFile &file)
+{
+	LineScanner scanner(file.content);
+	StringRef line;
+	int lineNum = 0;
+	while (scanner.next(line)) {
+		++lineNum;
+		line = trim(line);
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		const size_t firstToken = file.tokens.size();
+		tokenize(line, " \t\r\n", file.tokens);
+		if (file.tokens.size() > firstToken) {
+			file.lines.push_back(PackageLine{lineNum, line, firstToken, file.tokens.size() - firstToken});
+		}
+	}
+}
+
+/** ReadPackage reads and tokenizes a package's xsb_aircraft.txt */
+static void
+ReadPackage(PackageFile &file)
+{
+	if (GetFileContent(file.filePath, file.content)) {
+		TokenizePackage(file);
+	}
+}
+
+enum class PackageCommand {
+	Unknown,
+	ExportName,
+	Dependency,
+	Object,
+	Texture,
+	Obj8Aircraft,
+	Obj8,
+	VertOffset,
+	HasGear,
+	Icao,
+	Airline,
+	Livery,
+	Aircraft,
+};
+
+static constexpr unsigned
+PackageKeywordHash(size_t length, char first)
+{
+	return static_cast<unsigned>(length << 8) | static_cast<unsigned char>(first);
+}
+
+/** LookupPackageCommand finds the command for a keyword.  No two keywords
+ * have the same length and first character, so that's a perfect hash of
+ * them, and only the one candidate has to be compared in full.
+ */
+static PackageCommand
+LookupPackageCommand(StringRef keyword)
+{
+	if (keyword.empty()) {
+		return PackageCommand::Unknown;
+	}
+
+	const char *name;
+	PackageCommand command;
+	switch (PackageKeywordHash(keyword.size(), keyword[0])) {
+	case PackageKeywordHash(11, 'E'):	name = "EXPORT_NAME";	command = PackageCommand::ExportName;	break;
+	case PackageKeywordHash(10, 'D'):	name = "DEPENDENCY";	command = PackageCommand::Dependency;	break;
+	case PackageKeywordHash(6, 'O'):	name = "OBJECT";		command = PackageCommand::Object;		break;
+	case PackageKeywordHash(7, 'T'):	name = "TEXTURE";		command = PackageCommand::Texture;		break;
+	case PackageKeywordHash(13, 'O'):	name = "OBJ8_AIRCRAFT";	command = PackageCommand::Obj8Aircraft;	break;
+	case PackageKeywordHash(4, 'O'):	name = "OBJ8";			command = PackageCommand::Obj8;			break;
+	case PackageKeywordHash(11, 'V'):	name = "VERT_OFFSET";	command = PackageCommand::VertOffset;	break;
+	case PackageKeywordHash(7, 'H'):	name = "HASGEAR";		command = PackageCommand::HasGear;		break;
+	case PackageKeywordHash(4, 'I'):	name = "ICAO";			command = PackageCommand::Icao;			break;
+	case PackageKeywordHash(7, 'A'):	name = "AIRLINE";		command = PackageCommand::Airline;		break;
+	case PackageKeywordHash(6, 'L'):	name = "LIVERY";		command = PackageCommand::Livery;		break;
+	case PackageKeywordHash(8, 'A'):	name = "AIRCRAFT";		command = PackageCommand::Aircraft;		break;
+	default:
+		return PackageCommand::Unknown;
+	}
+	return (keyword == StringRef(name)) ? command : PackageCommand::Unknown;
+}
+
 static bool
 ParseExportCommand(
-	const std::vector<std::string> &tokens, CSLPackage_t &package, const string &path, int lineNum, const string &line)
+	const PackageTokens &tokens, CSLPackage_t &package, const string &path, int lineNum, StringRef line)
 {
 	if (tokens.size() != 2) {
 		XPLMDump(path, lineNum, line) << XPMP_CLIENT_NAME " WARNING: EXPORT_NAME command requires 1 argument.\n";
@@ -103,15 +270,15 @@ ParseExportCommand(
 	}
 
 	auto p = std::find_if(
-		gPackages.begin(), gPackages.end(), [&tokens](CSLPackage_t p) { return p.name == tokens[1]; });
+		gPackages.begin(), gPackages.end(), [&tokens](const CSLPackage_t &p) { return p.name == tokens[1]; });
 	if (p == gPackages.end()) {
 		package.path = path;
-		package.name = tokens[1];
+		package.name = tokens[1].str();
 		return true;
 	} else {
 		XPLMDump(path, lineNum, line)
 			<< XPMP_CLIENT_NAME " WARNING: Package name "
-			<< tokens[1].c_str()
+			<< tokens[1]
 			<< " already in use by "
 			<< p->path.c_str()
 			<< " reqested by use by "
@@ -123,18 +290,18 @@ ParseExportCommand(
 
 static bool
 ParseDependencyCommand(
-	const std::vector<std::string> &tokens,
+	const PackageTokens &tokens,
 	CSLPackage_t &/*package*/,
 	const string &path,
 	int lineNum,
-	const string &line)
+	StringRef line)
 {
 	if (tokens.size() != 2) {
 		XPLMDump(path, lineNum, line) << XPMP_CLIENT_NAME " WARNING: DEPENDENCY command needs 1 argument.\n";
 		return false;
 	}
 
-	if (std::count_if(gPackages.begin(), gPackages.end(), [&tokens](CSLPackage_t p) { return p.name == tokens[1]; }) ==
+	if (std::count_if(gPackages.begin(), gPackages.end(), [&tokens](const CSLPackage_t &p) { return p.name == tokens[1]; }) ==
 		0) {
 		XPLMDump(path, lineNum, line)
 			<< XPMP_CLIENT_NAME " WARNING: required package "
@@ -148,7 +315,7 @@ ParseDependencyCommand(
 
 static bool
 ParseAircraftCommand(
-	const std::vector<std::string> &tokens, CSLPackage_t &package, const string &path, int lineNum, const string &line)
+	const PackageTokens &tokens, CSLPackage_t &package, const string &path, int lineNum, StringRef line)
 {
 	XPLMDump(path, lineNum, line) << XPMP_CLIENT_NAME " ERROR: Encountered legacy AIRCRAFT directive - ACF CSLs are not supported anymore.\n";
 	return false;
@@ -156,7 +323,7 @@ ParseAircraftCommand(
 
 static bool
 ParseObjectCommand(
-	const std::vector<std::string> &tokens, CSLPackage_t &package, const string &path, int lineNum, const string &line)
+	const PackageTokens &tokens, CSLPackage_t &package, const string &path, int lineNum, StringRef line)
 {
 	XPLMDump(path, lineNum, line) << XPMP_CLIENT_NAME " ERROR: Encountered legacy OBJECT directive - Legacy (OBJ7) CSLs are not supported anymore.\n";
 	return false;
@@ -164,7 +331,7 @@ ParseObjectCommand(
 
 static bool
 ParseTextureCommand(
-	const std::vector<std::string> &tokens, CSLPackage_t &package, const string &path, int lineNum, const string &line)
+	const PackageTokens &tokens, CSLPackage_t &package, const string &path, int lineNum, StringRef line)
 {
 	XPLMDump(path, lineNum, line) << XPMP_CLIENT_NAME " ERROR: Encountered legacy TEXTURE directive - Legacy (OBJ7) CSLs are not supported anymore.\n";
 	return false;
@@ -172,19 +339,19 @@ ParseTextureCommand(
 
 static bool
 ParseObj8AircraftCommand(
-	const std::vector<std::string> &tokens, CSLPackage_t &package, const string &path, int lineNum, const string &line)
+	const PackageTokens &tokens, CSLPackage_t &package, const string &path, int lineNum, StringRef line)
 {
 	// OBJ8_AIRCRAFT <path>
 	if (tokens.size() != 2) {
 		XPLMDump(path, lineNum, line) << XPMP_CLIENT_NAME " WARNING: OBJ8_AIRCRAFT command takes 1 argument.\n";
 	}
 
-	auto csl = new Obj8CSL({package.path.substr(package.path.find_last_of('/') + 1)}, tokens[1]);
+	auto csl = new Obj8CSL({package.path.substr(package.path.find_last_of('/') + 1)}, tokens[1].str());
 	package.planes.push_back(csl);
 
 #if DEBUG_CSL_LOADING
 	XPLMDebugString("      Got OBJ8 Airplane: ");
-	XPLMDebugString(tokens[1].c_str());
+	XPLMDebugString(tokens[1].str().c_str());
 	XPLMDebugString("\n");
 #endif
 	return true;
@@ -192,7 +359,7 @@ ParseObj8AircraftCommand(
 
 static bool
 ParseObj8Command(
-	const std::vector<std::string> &tokens, CSLPackage_t &package, const string &path, int lineNum, const string &line)
+	const PackageTokens &tokens, CSLPackage_t &package, const string &path, int lineNum, StringRef line)
 {
 	// OBJ8 <group> <animate YES|NO> <filename>
 	if (tokens.size() != 4) {
@@ -229,7 +396,7 @@ ParseObj8Command(
 		}
 	}
 
-	string relativePath = tokens[3];
+	string relativePath = tokens[3].str();
 	MakePartialPathNativeObj(relativePath);
 	string absolutePath(relativePath);
 	if (!DoPackageSub(absolutePath)) {
@@ -238,10 +405,7 @@ ParseObj8Command(
 	}
 
 	// convert the absolute path back to a relative one
-	char xsystem[1024];
-	XPLMGetSystemPath(xsystem);
-
-	size_t sys_len = strlen(xsystem);
+	size_t sys_len = gSystemPath.size();
 	if (absolutePath.size() > sys_len) {
 		absolutePath.erase(absolutePath.begin(), absolutePath.begin() + sys_len);
 	} else {
@@ -257,7 +421,7 @@ ParseObj8Command(
 
 static bool
 ParseVertOffsetCommand(
-	const std::vector<std::string> &tokens, CSLPackage_t &package, const string &path, int lineNum, const string &line)
+	const PackageTokens &tokens, CSLPackage_t &package, const string &path, int lineNum, StringRef line)
 {
 	// VERT_OFFSET
 	// this is the csl-model vertical offset for accurately putting planes onto the ground.
@@ -265,13 +429,22 @@ ParseVertOffsetCommand(
 		XPLMDump(path, lineNum, line) << XPMP_CLIENT_NAME " WARNING: VERT_OFFSET command takes 1 argument.\n";
 		return false;
 	}
-	package.planes.back()->setVerticalOffset(VerticalOffsetSource::Model, stof(tokens[1].c_str()));
+	// the packages are parsed on worker threads, so a bad number can't be
+	// left to throw.
+	char *end = nullptr;
+	const string value = tokens[1].str();
+	const float offset = strtof(value.c_str(), &end);
+	if (end == value.c_str()) {
+		XPLMDump(path, lineNum, line) << XPMP_CLIENT_NAME " WARNING: VERT_OFFSET argument must be a number.\n";
+		return false;
+	}
+	package.planes.back()->setVerticalOffset(VerticalOffsetSource::Model, offset);
 	return true;
 }
 
 static bool
 ParseHasGearCommand(
-	const std::vector<std::string> &tokens, CSLPackage_t &package, const string &path, int lineNum, const string &line)
+	const PackageTokens &tokens, CSLPackage_t &package, const string &path, int lineNum, StringRef line)
 {
 	// HASGEAR YES|NO
 	if (tokens.size() != 2 || (tokens[1] != "YES" && tokens[1] != "NO")) {
@@ -299,7 +472,7 @@ ParseHasGearCommand(
 
 static bool
 ParseIcaoCommand(
-	const std::vector<std::string> &tokens, CSLPackage_t &package, const string &path, int lineNum, const string &line)
+	const PackageTokens &tokens, CSLPackage_t &package, const string &path, int lineNum, StringRef line)
 {
 	// ICAO <code>
 	if (tokens.size() != 2) {
@@ -307,16 +480,14 @@ ParseIcaoCommand(
 		return false;
 	}
 
-	std::string icao = tokens[1];
+	std::string icao = tokens[1].str();
 	package.planes.back()->setICAO(icao);
-	std::string group = gGroupings[icao];
-	if (package.matches[match_icao].count(icao) == 0) {
-		package.matches[match_icao][icao] = static_cast<int>(package.planes.size()) - 1;
-	}
-	if (!group.empty()) {
-		if (package.matches[match_group].count(group) == 0) {
-			package.matches[match_group][group] = static_cast<int>(package.planes.size()) - 1;
-		}
+	const int plane = static_cast<int>(package.planes.size()) - 1;
+	const uint32_t icaoId = MatchIds::intern(icao);
+	const uint32_t groupId = MatchIds::intern(GetGroup(icao));
+	package.matches[match_icao].add(MatchKey{icaoId, 0, 0}, plane);
+	if (groupId != 0) {
+		package.matches[match_group].add(MatchKey{groupId, 0, 0}, plane);
 	}
 
 	return true;
@@ -324,7 +495,7 @@ ParseIcaoCommand(
 
 static bool
 ParseAirlineCommand(
-	const std::vector<std::string> &tokens, CSLPackage_t &package, const string &path, int lineNum, const string &line)
+	const PackageTokens &tokens, CSLPackage_t &package, const string &path, int lineNum, StringRef line)
 {
 	// AIRLINE <code> <airline>
 	if (tokens.size() != 3) {
@@ -333,25 +504,22 @@ ParseAirlineCommand(
 	}
 
 
-	std::string icao = tokens[1];
-	std::string airline = tokens[2];
+	std::string icao = tokens[1].str();
+	std::string airline = tokens[2].str();
 	package.planes.back()->setAirline(icao, airline);
-	std::string group = gGroupings[icao];
-	if (package.matches[match_icao_airline].count(icao + " " + airline) == 0) {
-		package.matches[match_icao_airline][icao + " " + airline] = static_cast<int>(package.planes.size()) - 1;
-	}
+	const int plane = static_cast<int>(package.planes.size()) - 1;
+	const uint32_t icaoId = MatchIds::intern(icao);
+	const uint32_t groupId = MatchIds::intern(GetGroup(icao));
+	const uint32_t airlineId = MatchIds::intern(airline);
+	package.matches[match_icao_airline].add(MatchKey{icaoId, airlineId, 0}, plane);
 #if USE_DEFAULTING
-	if (package.matches[match_icao		].count(icao				) == 0)
-		package.matches[match_icao		]      [icao				] = package.planes.size() - 1;
+	package.matches[match_icao].add(MatchKey{icaoId, 0, 0}, plane);
 #endif
-	if (!group.empty()) {
+	if (groupId != 0) {
 #if USE_DEFAULTING
-		if (package.matches[match_group	     ].count(group				  ) == 0)
-			package.matches[match_group	     ]		[group				  ] = package.planes.size() - 1;
+		package.matches[match_group].add(MatchKey{groupId, 0, 0}, plane);
 #endif
-		if (package.matches[match_group_airline].count(group + " " + airline) == 0) {
-			package.matches[match_group_airline][group + " " + airline] = static_cast<int>(package.planes.size()) - 1;
-		}
+		package.matches[match_group_airline].add(MatchKey{groupId, airlineId, 0}, plane);
 	}
 
 	return true;
@@ -359,7 +527,7 @@ ParseAirlineCommand(
 
 static bool
 ParseLiveryCommand(
-	const std::vector<std::string> &tokens, CSLPackage_t &package, const string &path, int lineNum, const string &line)
+	const PackageTokens &tokens, CSLPackage_t &package, const string &path, int lineNum, StringRef line)
 {
 	// LIVERY <code> <airline> <livery>
 	if (tokens.size() != 4) {
@@ -367,95 +535,44 @@ ParseLiveryCommand(
 		return false;
 	}
 
-	std::string icao = tokens[1];
-	std::string airline = tokens[2];
-	std::string livery = tokens[3];
+	std::string icao = tokens[1].str();
+	std::string airline = tokens[2].str();
+	std::string livery = tokens[3].str();
 	package.planes.back()->setLivery(icao, airline, livery);
-	std::string group = gGroupings[icao];
+	const int plane = static_cast<int>(package.planes.size()) - 1;
+	const uint32_t icaoId = MatchIds::intern(icao);
+	const uint32_t groupId = MatchIds::intern(GetGroup(icao));
+	const uint32_t airlineId = MatchIds::intern(airline);
+	const uint32_t liveryId = MatchIds::intern(livery);
 #if USE_DEFAULTING
-	if (package.matches[match_icao				].count(icao							   ) == 0)
-		package.matches[match_icao				]	   [icao							   ] = package.planes.size() - 1;
-	if (package.matches[match_icao				].count(icao							   ) == 0)
-		package.matches[match_icao_airline 		]	   [icao + " " + airline			   ] = package.planes.size() - 1;
+	package.matches[match_icao].add(MatchKey{icaoId, 0, 0}, plane);
+	package.matches[match_icao_airline].add(MatchKey{icaoId, airlineId, 0}, plane);
 #endif
-	if (package.matches[match_icao_airline_livery].count(icao + " " + airline + " " + livery) == 0) {
-		package.matches[match_icao_airline_livery][icao + " " + airline + " " + livery] =
-			static_cast<int>(package.planes.size()) - 1;
-	}
-	if (package.matches[match_icao_livery].count(icao + " " + livery) == 0) {
-		package.matches[match_icao_livery][icao + " " + livery] =
-			static_cast<int>(package.planes.size()) - 1;
-	}
-	if (!group.empty()) {
+	package.matches[match_icao_airline_livery].add(MatchKey{icaoId, airlineId, liveryId}, plane);
+	package.matches[match_icao_livery].add(MatchKey{icaoId, 0, liveryId}, plane);
+	if (groupId != 0) {
 #if USE_DEFAULTING
-		if (package.matches[match_group		 		 ].count(group							     ) == 0)
-			package.matches[match_group		 		 ]		[group							     ] = package.planes.size() - 1;
-		if (package.matches[match_group_airline		 ].count(group + " " + airline			     ) == 0)
-			package.matches[match_group_airline		 ]		[group + " " + airline			     ] = package.planes.size() - 1;
+		package.matches[match_group].add(MatchKey{groupId, 0, 0}, plane);
+		package.matches[match_group_airline].add(MatchKey{groupId, airlineId, 0}, plane);
 #endif
-		if (package.matches[match_group_airline_livery].count(group + " " + airline + " " + livery) == 0) {
-			package.matches[match_group_airline_livery][group + " " + airline + " " + livery] =
-				static_cast<int>(package.planes.size()) - 1;
-		}
-		if (package.matches[match_group_livery].count(group + " " + livery) == 0) {
-			package.matches[match_group_livery][group + " " + livery] =
-				static_cast<int>(package.planes.size()) - 1;
-		}
+		package.matches[match_group_airline_livery].add(MatchKey{groupId, airlineId, liveryId}, plane);
+		package.matches[match_group_livery].add(MatchKey{groupId, 0, liveryId}, plane);
 	}
 
 	return true;
 }
 
-static bool
-ParseDummyCommand(
-	const std::vector<std::string> & /* tokens */,
-	CSLPackage_t & /* package */,
-	const string & /* path */,
-	int /*lineNum*/,
-	const string & /*line*/)
-{
-	return true;
-}
-
-static std::string
-GetFileContent(const std::string &filename)
-{
-	std::string content;
-	std::ifstream in(filename, std::ios::in | std::ios::binary);
-	if (in) {
-		content = std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-	}
-	return content;
-}
-
+/** ParsePackageHeader looks for the package's EXPORT_NAME */
 static CSLPackage_t
-ParsePackageHeader(const string &path, const string &content)
+ParsePackageHeader(const string &path, const PackageFile &file)
 {
-	using command = std::function<bool(
-		const std::vector<std::string> &, CSLPackage_t &, const string &, int, const string &)>;
-
-	static const std::unordered_map<std::string, command> commands{{"EXPORT_NAME", &ParseExportCommand}};
-
 	CSLPackage_t package;
-	stringstream sin(content);
-	if (!sin.good()) {
-		return package;
-	}
-
-	std::string line;
-	int lineNum = 0;
-
-	while (std::getline(sin, line)) {
-		++lineNum;
-		auto tokens = tokenize(line, " \t\r\n");
-		if (!tokens.empty()) {
-			auto it = commands.find(tokens[0]);
-			if (it != commands.end()) {
-				bool result = it->second(tokens, package, path, lineNum, line);
-				// Stop loop once we found EXPORT command
-				if (result) {
-					break;
-				}
+	for (const auto &line: file.lines) {
+		const PackageTokens tokens(file, line);
+		if (LookupPackageCommand(tokens[0]) == PackageCommand::ExportName) {
+			// Stop loop once we found EXPORT command
+			if (ParseExportCommand(tokens, package, path, line.lineNum, line.line)) {
+				break;
 			}
 		}
 	}
@@ -464,52 +581,59 @@ ParsePackageHeader(const string &path, const string &content)
 }
 
 
+/** ParseFullPackage parses the body of a package into package.  It only
+ * reads the shared library state, so packages can be parsed in parallel
+ * once all of their headers are in gPackages.
+ */
 static void
-ParseFullPackage(const std::string &content, CSLPackage_t &package)
+ParseFullPackage(const PackageFile &file, CSLPackage_t &package)
 {
-	using command = std::function<bool(
-		const std::vector<std::string> &, CSLPackage_t &, const string &, int, const string &)>;
-
-	static const std::unordered_map<std::string, command> commands {
-		{"EXPORT_NAME", &ParseDummyCommand},
-		{"DEPENDENCY", &ParseDependencyCommand},
-		{"OBJECT", &ParseObjectCommand},
-		{"TEXTURE", &ParseTextureCommand},
-		{"OBJ8_AIRCRAFT", &ParseObj8AircraftCommand},
-		{"OBJ8", &ParseObj8Command},
-		{"VERT_OFFSET", &ParseVertOffsetCommand},
-		{"HASGEAR", &ParseHasGearCommand},
-		{"ICAO", &ParseIcaoCommand},
-		{"AIRLINE", &ParseAirlineCommand},
-		{"LIVERY", &ParseLiveryCommand},
-		{ "AIRCRAFT", &ParseAircraftCommand},
-	};
-
-	stringstream sin(content);
-	if (!sin.good()) {
-		return;
-	} // exit if file not found
-
 	std::string packageFilePath(package.path);
 	packageFilePath += "/";
 	packageFilePath += "xsb_aircraft.txt";
 
-	std::string line;
-	int lineNum = 0;
-	while (std::getline(sin, line)) {
-		++lineNum;
-		trim(line);
-		if (line.empty() || line[0] == '#') {
-			continue;
-		}
-		auto tokens = tokenize(line, " \t\r\n");
-		if (!tokens.empty()) {
-			auto it = commands.find(tokens[0]);
-			if (it != commands.end()) {
-				it->second(tokens, package, packageFilePath, lineNum, line);
-			} else {
-				XPLMDump(packageFilePath, lineNum, line);
-			}
+	for (const auto &line: file.lines) {
+		const PackageTokens tokens(file, line);
+		switch (LookupPackageCommand(tokens[0])) {
+		case PackageCommand::ExportName:
+			// handled by ParsePackageHeader
+			break;
+		case PackageCommand::Dependency:
+			ParseDependencyCommand(tokens, package, packageFilePath, line.lineNum, line.line);
+			break;
+		case PackageCommand::Object:
+			ParseObjectCommand(tokens, package, packageFilePath, line.lineNum, line.line);
+			break;
+		case PackageCommand::Texture:
+			ParseTextureCommand(tokens, package, packageFilePath, line.lineNum, line.line);
+			break;
+		case PackageCommand::Obj8Aircraft:
+			ParseObj8AircraftCommand(tokens, package, packageFilePath, line.lineNum, line.line);
+			break;
+		case PackageCommand::Obj8:
+			ParseObj8Command(tokens, package, packageFilePath, line.lineNum, line.line);
+			break;
+		case PackageCommand::VertOffset:
+			ParseVertOffsetCommand(tokens, package, packageFilePath, line.lineNum, line.line);
+			break;
+		case PackageCommand::HasGear:
+			ParseHasGearCommand(tokens, package, packageFilePath, line.lineNum, line.line);
+			break;
+		case PackageCommand::Icao:
+			ParseIcaoCommand(tokens, package, packageFilePath, line.lineNum, line.line);
+			break;
+		case PackageCommand::Airline:
+			ParseAirlineCommand(tokens, package, packageFilePath, line.lineNum, line.line);
+			break;
+		case PackageCommand::Livery:
+			ParseLiveryCommand(tokens, package, packageFilePath, line.lineNum, line.line);
+			break;
+		case PackageCommand::Aircraft:
+			ParseAircraftCommand(tokens, package, packageFilePath, line.lineNum, line.line);
+			break;
+		case PackageCommand::Unknown:
+			XPLMDump(packageFilePath, line.lineNum, line.line);
+			break;
 		}
 	}
 }
@@ -533,58 +657,56 @@ CSL_LoadData(const char *inRelated, const char *inDoc8643)
 	bool ok = true;
 
 	// read the list of aircraft codes
-	FILE *aircraft_fi = fopen(inDoc8643, "r");
-
-	if (aircraft_fi) {
-		char buf[1024];
-		while (fgets_multiplatform(buf, sizeof(buf), aircraft_fi)) {
-			vector<string> tokens;
-
-			tokens = tokenize(buf, "\t", 5);
-
+	std::string content;
+	vector<StringRef> tokens;
+	if (GetFileContent(inDoc8643, content)) {
+		LineScanner scanner(content);
+		StringRef line;
+		while (scanner.next(line)) {
 			// Sample line. Fields are separated by tabs
 			// ABHCO	SA-342 Gazelle 	GAZL	H1T	-
-
+			tokens.clear();
+			tokenize(line, "\t", tokens);
 			if (tokens.size() < 5) {
 				continue;
 			}
 			CSLAircraftCode_t entry;
-			entry.icao = tokens[2];
-			entry.equip = tokens[3];
+			entry.icao = tokens[2].str();
+			entry.equip = tokens[3].str();
 			entry.category = tokens[4][0];
 
 			gAircraftCodes[entry.icao] = entry;
 		}
-		fclose(aircraft_fi);
 	} else {
 		XPLMDump() << XPMP_CLIENT_NAME " WARNING: could not open ICAO document 8643 at " << inDoc8643 << "\n";
 		ok = false;
 	}
 
 	// next, grab the related.txt file.
-	FILE *related_fi = fopen(inRelated, "r");
-	if (related_fi) {
-		char buf[1024];
-		while (fgets_multiplatform(buf, sizeof(buf), related_fi)) {
-			if (buf[0] != ';') {
-				vector<string> tokens = tokenize(buf, " \t\r\n");
+	if (GetFileContent(inRelated, content)) {
+		LineScanner scanner(content);
+		StringRef line;
+		while (scanner.next(line)) {
+			if (!line.empty() && line[0] != ';') {
+				tokens.clear();
+				tokenize(line, " \t\r\n", tokens);
 				string group;
 				for (const auto &tok: tokens) {
 					if (!group.empty()) {
 						group += " ";
 					}
-					group += tok;
+					group.append(tok.data(), tok.size());
 				}
 				for (const auto &tok: tokens) {
-					gGroupings[tok] = group;
+					gGroupings[tok.str()] = group;
 				}
 			}
 		}
-		fclose(related_fi);
 	} else {
 		XPLMDump() << XPMP_CLIENT_NAME " WARNING: could not open related.txt at " << inRelated << "\n";
 		ok = false;
 	}
+	CSL_ClearMatchCache();
 
 	return ok;
 }
@@ -628,9 +750,20 @@ CSL_LoadCSL(const char *inFolderPath)
 	free(name_buf);
 	free(index_buf);
 
-	vector<CSLPackage_t> packages;
+	// the packages parsed the last time this folder was loaded.  The index
+	// is only used if it was written for the same system path and groups.
+	char xsystem[1024];
+	XPLMGetSystemPath(xsystem);
+	gSystemPath = xsystem;
+
+	const string indexPath = string(inFolderPath) + "/" + CSLIndex::kFileName;
+	const uint64_t groupsFingerprint = CSLIndex::fingerprintGroups(gGroupings);
+	CSLIndex index;
+	const bool indexLoaded = index.load(indexPath, gSystemPath, groupsFingerprint);
 
-	// First read all headers. This is required to resolve the DEPENDENCIES
+	// read and tokenize the package files that aren't in the index.  The
+	// files are independent, so this is done in parallel.
+	vector<PackageFile> files;
 	for (const auto &packagePath : packageDirs) {
 		std::string packageFile(packagePath);
 		packageFile += "/"; //XPLMGetDirectorySeparator();
@@ -640,27 +773,98 @@ CSL_LoadCSL(const char *inFolderPath)
 		if (!DoesFileExist(packageFile) || isPackageAlreadyLoaded(packagePath)) {
 			continue;
 		}
+		PackageFile file{packagePath, packageFile, {}, {}, {}, {}, nullptr};
+		if (CSLIndex::getFileKey(packageFile, file.key)) {
+			file.cached = index.find(packagePath, file.key);
+		}
+		files.push_back(std::move(file));
+	}
+	if (files.empty()) {
+		return ok;
+	}
+
+	WorkerPool pool;
+	pool.parallelFor(files.size(), 1, [&files](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			if (files[i].cached == nullptr) {
+				ReadPackage(files[i]);
+			}
+		}
+	});
 
-		XPLMDump() << XPMP_CLIENT_NAME ": Loading package: " << packageFile << "\n";
-		std::string packageContent = GetFileContent(packageFile);
-		auto package = ParsePackageHeader(packagePath, packageContent);
+	// Then the headers, in directory order.  This is required to resolve the
+	// DEPENDENCIES.
+	vector<CSLPackage_t> packages;
+	vector<PackageFile *> packageFiles;
+	for (auto &file : files) {
+		// a clash with a package loaded since the index was written is left
+		// to the parser to report.
+		if (file.cached != nullptr && std::any_of(gPackages.begin(), gPackages.end(),
+			[&file](const CSLPackage_t &p) { return p.name == file.cached->name; })) {
+			file.cached = nullptr;
+			ReadPackage(file);
+		}
+
+		CSLPackage_t package;
+		if (file.cached != nullptr) {
+			XPLMDump() << XPMP_CLIENT_NAME ": Loading package: " << file.filePath << " (indexed)\n";
+			package.name = file.cached->name;
+			package.path = file.packagePath;
+		} else {
+			XPLMDump() << XPMP_CLIENT_NAME ": Loading package: " << file.filePath << "\n";
+			package = ParsePackageHeader(file.packagePath, file);
+		}
 		if (package.hasValidHeader()) {
 			packages.push_back(package);
+			packageFiles.push_back(&file);
 		}
 	}
 
 	if (!packages.empty()) {
-		// iterator points to the first inserted package
-		auto iterator = gPackages.insert(gPackages.end(), packages.begin(), packages.end());
-
-		// Now we do a full run
-		for (; iterator != gPackages.end(); ++iterator) {
-			auto &package = *iterator;
-			std::string packageFile(package.path);
-			packageFile += "/"; //XPLMGetDirectorySeparator();
-			packageFile += "xsb_aircraft.txt";
-			std::string packageContent = GetFileContent(packageFile);
-			ParseFullPackage(packageContent, package);
+		const size_t first = gPackages.size();
+		gPackages.insert(gPackages.end(), packages.begin(), packages.end());
+		CSL_ClearMatchCache();
+
+		// the DEPENDENCY checks depend on every package loaded so far, so the
+		// index's bodies are only good if those are unchanged too.
+		const uint64_t packagesFingerprint = CSLIndex::fingerprintPackages(gPackages);
+		const bool useIndex = indexLoaded && (packagesFingerprint == index.getPackagesFingerprint());
+
+		// Now we do a full run.  Each package is read from the index or
+		// parsed into it's own copy on the pool, with it's log kept back, and
+		// the results are put in place (and logged) in order, so the matching
+		// priority is unchanged.
+		vector<string> logs(packages.size());
+		vector<char> parsed(packages.size(), 0);
+		pool.parallelFor(packages.size(), 1,
+			[&packages, &packageFiles, &logs, &parsed, &index, useIndex](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					auto &file = *packageFiles[i];
+					if (useIndex && file.cached != nullptr && index.readPackage(*file.cached, packages[i])) {
+						continue;
+					}
+					XPLMDumpCapture capture(logs[i]);
+					if (file.cached != nullptr) {
+						ReadPackage(file);
+					}
+					ParseFullPackage(file, packages[i]);
+					parsed[i] = 1;
+				}
+			});
+
+		vector<CSLIndex::PackageRecord> records;
+		for (size_t i = 0; i < packages.size(); i++) {
+			if (!logs[i].empty()) {
+				XPLMDebugString(logs[i].c_str());
+			}
+			gPackages[first + i] = std::move(packages[i]);
+			records.push_back(CSLIndex::PackageRecord{&gPackages[first + i], packageFiles[i]->key});
+		}
+
+		if (!useIndex || std::find(parsed.begin(), parsed.end(), 1) != parsed.end()) {
+			if (!CSLIndex::write(indexPath, gSystemPath, groupsFingerprint, packagesFingerprint, records)) {
+				XPLMDump() << XPMP_CLIENT_NAME " WARNING: could not write the CSL index " << indexPath << "\n";
+			}
 		}
 	}
 
@@ -691,17 +895,60 @@ static const int kUseICAO[] = {1, 1, 0, 0, 1, 1, 0, 0};
 static const int kUseAirline[] = {1, 1, 1, 1, 0, 0, 0, 0};
 static const int kUseLivery[] = {1, 0, 1, 0, 1, 0, 1, 0};
 
-CSL *
-CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
-{
-	string group;
-	string key;
+/** MatchCacheKey is everything a CSL_MatchPlane search depends on that
+ * changes from call to call.
+ */
+struct MatchCacheKey {
+	PlaneType	type;
+	bool		allowDefault;
+
+	bool operator==(const MatchCacheKey &rhs) const
+	{
+		return allowDefault == rhs.allowDefault && type == rhs.type;
+	}
+};
+
+struct MatchCacheKeyHash {
+	size_t operator()(const MatchCacheKey &key) const
+	{
+		const hash<string> hasher;
+		size_t h = hasher(key.type.mICAO);
+		h = h * 31 + hasher(key.type.mAirline);
+		h = h * 31 + hasher(key.type.mLivery);
+		return h * 2 + (key.allowDefault ? 1 : 0);
+	}
+};
 
+struct MatchCacheResult {
+	CSL *	csl;
+	int		quality;
+};
+
+// the results of the searches so far, including the ones that found
+// nothing.  The liveries clients send aren't bounded, so neither is the
+// number of types - the cache is started over once it's this big.
+static const size_t		kMaxMatchCacheEntries = 65536;
+static unordered_map<MatchCacheKey, MatchCacheResult, MatchCacheKeyHash>	gMatchCache;
+
+static CSL *MatchPlaneCached(const PlaneType &type, int *match_quality, bool allow_default, bool count_lookup);
+
+static CSL *
+MatchPlaneUncached(const PlaneType &type, int *match_quality, bool allow_default)
+{
+	static const string kNoGroup;
+	const string *group = &kNoGroup;
 	auto group_iter = gGroupings.find(type.mICAO);
 	if (group_iter != gGroupings.end()) {
-		group = group_iter->second;
+		group = &group_iter->second;
 	}
 
+	// the keys are made of the interned strings.  A string that's never
+	// been interned isn't in any of the tables.
+	const uint32_t icaoId = MatchIds::find(type.mICAO);
+	const uint32_t groupId = MatchIds::find(*group);
+	const uint32_t airlineId = MatchIds::find(type.mAirline);
+	const uint32_t liveryId = MatchIds::find(type.mLivery);
+
 	char buf[4096];
 
 	if (gConfiguration.debug.modelMatching) {
@@ -710,15 +957,14 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 			4096,
 			XPMP_CLIENT_NAME " MATCH - %s - GROUP=%s\n",
 			type.toLongString().c_str(),
-			group.c_str());
+			group->c_str());
 		XPLMDebugString(buf);
 	}
 
 	// Now we go through our passes.
 	for (int n = 0; n < match_count; ++n) {
 		// Build up the right key for this pass.
-		key = kUseICAO[n]?type.mICAO:group;
-		if (!kUseICAO[n] && group.empty()) {
+		if (!kUseICAO[n] && group->empty()) {
 			if (gConfiguration.debug.modelMatching) {
 				sprintf(buf, XPMP_CLIENT_NAME " MATCH -    Skipping %d Due nil Group\n", n);
 				XPLMDebugString(buf);
@@ -733,8 +979,6 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 				}
 				continue;
 			}
-			key += " ";
-			key += type.mAirline;
 		}
 
 		if (kUseLivery[n]) {
@@ -745,28 +989,42 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 				}
 				continue;
 			}
-			key += " ";
-			key += type.mLivery;
 		}
 
+		const MatchKey key{
+			kUseICAO[n] ? icaoId : groupId,
+			kUseAirline[n] ? airlineId : 0,
+			kUseLivery[n] ? liveryId : 0};
+
 		if (gConfiguration.debug.modelMatching) {
-			sprintf(buf, XPMP_CLIENT_NAME " MATCH -    Group %d key %s\n", n, key.c_str());
+			string keyName = kUseICAO[n] ? type.mICAO : *group;
+			if (kUseAirline[n]) {
+				keyName += " " + type.mAirline;
+			}
+			if (kUseLivery[n]) {
+				keyName += " " + type.mLivery;
+			}
+			snprintf(buf, sizeof(buf), XPMP_CLIENT_NAME " MATCH -    Group %d key %s\n", n, keyName.c_str());
 			XPLMDebugString(buf);
 		}
 
+		if (key.type == 0 || (kUseAirline[n] && key.airline == 0) || (kUseLivery[n] && key.livery == 0)) {
+			continue;
+		}
+
 		// Now go through each group and see if we match.
 		for (const auto &package: gPackages) {
-			auto iter = package.matches[n].find(key);
-			if (iter != package.matches[n].end()) {
-				if (!package.planes[iter->second]->isUsable()) {
+			const int plane = package.matches[n].find(key);
+			if (plane >= 0) {
+				if (!package.planes[plane]->isUsable()) {
 					if (gConfiguration.debug.modelMatching) {
 						sprintf(
 							buf,
 							XPMP_CLIENT_NAME " MATCH - Skipping as not usable. Found: %s/%s/%s : %s\n",
-							package.planes[iter->second]->getICAO().c_str(),
-							package.planes[iter->second]->getAirline().c_str(),
-							package.planes[iter->second]->getLivery().c_str(),
-							package.planes[iter->second]->getModelName().c_str());
+							package.planes[plane]->getICAO().c_str(),
+							package.planes[plane]->getAirline().c_str(),
+							package.planes[plane]->getLivery().c_str(),
+							package.planes[plane]->getModelName().c_str());
 						XPLMDebugString(buf);
 					}
 					continue;
@@ -778,13 +1036,13 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 					sprintf(
 						buf,
 						XPMP_CLIENT_NAME " MATCH - Found: %s/%s/%s : %s\n",
-						package.planes[iter->second]->getICAO().c_str(),
-						package.planes[iter->second]->getAirline().c_str(),
-						package.planes[iter->second]->getLivery().c_str(),
-						package.planes[iter->second]->getModelName().c_str());
+						package.planes[plane]->getICAO().c_str(),
+						package.planes[plane]->getAirline().c_str(),
+						package.planes[plane]->getLivery().c_str(),
+						package.planes[plane]->getModelName().c_str());
 					XPLMDebugString(buf);
 				}
-				return package.planes[iter->second];
+				return package.planes[plane];
 			}
 		}
 	}
@@ -852,10 +1110,10 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 
 			for (const auto &package: gPackages) {
 				// now we traverse all generic aircraft types in the package
-				for (const auto &matchpair: package.matches[match_icao]) {
-					if (package.planes[matchpair.second]->isUsable()) {
+				for (const auto &entry: package.matches[match_icao].getEntries()) {
+					if (package.planes[entry.plane]->isUsable()) {
 						// we have a candidate, lets see if it matches our criteria
-						const auto m = gAircraftCodes.find(matchpair.first);
+						const auto m = gAircraftCodes.find(MatchIds::getName(entry.key.type));
 						if (m != gAircraftCodes.end()) {
 							// category
 							if (m->second.category != model_it->second.category) {
@@ -885,13 +1143,13 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 							// bingo
 							if (gConfiguration.debug.modelMatching) {
 								XPLMDebugString(XPMP_CLIENT_NAME " MATCH/eqp-fallback - found: ");
-								XPLMDebugString(matchpair.first.c_str());
+								XPLMDebugString(MatchIds::getName(entry.key.type).c_str());
 								XPLMDebugString("\n");
 							}
 							if (match_quality != nullptr) {
 								*match_quality = match_count + pass;
 							}
-							return package.planes[matchpair.second];
+							return package.planes[entry.plane];
 						}
 					}
 				}
@@ -910,7 +1168,8 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 		return nullptr;
 	}
 	int		defaultMatchQuality = 0;
-	auto *defCSL = CSL_MatchPlane(gDefaultPlane, &defaultMatchQuality, false);
+	// the fallback is part of this lookup, so it isn't counted on it's own.
+	auto *defCSL = MatchPlaneCached(gDefaultPlane, &defaultMatchQuality, false, false);
 	if (match_quality != nullptr) {
 		if (defaultMatchQuality > 0) {
 			*match_quality = match_count + match_fallback_count + defaultMatchQuality;
@@ -921,6 +1180,51 @@ CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
 	return defCSL;
 }
 
+/** MatchPlaneCached looks the type up in the match cache, searching for it
+ * (and caching the result) if it's not there.  The lookup is only counted in
+ * the render stats if count_lookup is set.
+ */
+static CSL *
+MatchPlaneCached(const PlaneType &type, int *match_quality, bool allow_default, bool count_lookup)
+{
+	// every search is made in full whilst the matching is being traced, so
+	// it's all logged.
+	if (gConfiguration.debug.modelMatching) {
+		return MatchPlaneUncached(type, match_quality, allow_default);
+	}
+
+	MatchCacheKey key{type, allow_default};
+	auto cached = gMatchCache.find(key);
+	if (count_lookup) {
+		RenderStats::countMatch(cached != gMatchCache.end());
+	}
+	if (cached == gMatchCache.end()) {
+		MatchCacheResult result{nullptr, -1};
+		result.csl = MatchPlaneUncached(type, &result.quality, allow_default);
+		if (gMatchCache.size() >= kMaxMatchCacheEntries) {
+			gMatchCache.clear();
+		}
+		cached = gMatchCache.emplace(std::move(key), result).first;
+	}
+
+	if (match_quality != nullptr) {
+		*match_quality = cached->second.quality;
+	}
+	return cached->second.csl;
+}
+
+CSL *
+CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default)
+{
+	return MatchPlaneCached(type, match_quality, allow_default, true);
+}
+
+void
+CSL_ClearMatchCache()
+{
+	gMatchCache.clear();
+}
+
 void
 CSL_Dump()
 {
@@ -937,8 +1241,8 @@ CSL_Dump()
 		}
 		for (int t = 0; t < match_count; ++t) {
 			XPLMDump() << XPMP_CLIENT_NAME " CSL:           Table " << t << "\n";
-			for (const auto &i: package.matches[t]) {
-				XPLMDump() << XPMP_CLIENT_NAME " CSL:                " << i.first << " -> " << i.second << "\n";
+			for (const auto &i: package.matches[t].getEntries()) {
+				XPLMDump() << XPMP_CLIENT_NAME " CSL:                " << i.key.toString() << " -> " << i.plane << "\n";
 			}
 		}
 	}
@@ -84,9 +84,18 @@ bool			CSL_LoadCSL(const char *inFolderPath);
  *
  * if match_quality is set, it is set with the pass upon which a match was determined.  
  *   (see XPMPMultiplayerCSL.h)
+ *
+ * The results, including the failures, are cached until CSL_ClearMatchCache is called.  Must only
+ * be called from the main thread.
  */
 CSL *			CSL_MatchPlane(const PlaneType &type,int *match_quality, bool allow_default);
 
+/** CSL_ClearMatchCache forgets the results CSL_MatchPlane has cached.  It
+ * must be called whenever anything the matching depends on changes - the
+ * packages, related.txt, doc8643 or the default plane.
+ */
+void			CSL_ClearMatchCache();
+
 /*
  * CSL_Dump
  *
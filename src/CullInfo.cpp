@@ -68,14 +68,30 @@ CullInfo::normalizeMatrix(float vec[4])
 }
 
 
-CullInfo::CullInfo()
+CullInfo::CullInfo() :
+	model_view{},
+	proj{}
 {
 	// First, just read out the current OpenGL matrices...do this once at setup because it's not the fastest thing to do.
 	if (modelviewMatrixRef && projectionMatrixRef) {
 		XPLMGetDatavf(modelviewMatrixRef, model_view, 0, 16);
 		XPLMGetDatavf(projectionMatrixRef, proj, 0, 16);
 	}
+	setupClipPlanes();
+}
+
+CullInfo::CullInfo(const float modelView[16], const float projection[16])
+{
+	for (int c = 0; c < 16; c++) {
+		model_view[c] = modelView[c];
+		proj[c] = projection[c];
+	}
+	setupClipPlanes();
+}
 
+void
+CullInfo::setupClipPlanes()
+{
 	// Now...what the heck is this?  Here's the deal: the clip planes have values in "clip" coordinates of: Left = (1,0,0,1)
 	// Right = (-1,0,0,1), Bottom = (0,1,0,1), etc.  (Clip coordinates are coordinates from -1 to 1 in XYZ that the driver
 	// uses.  The projection matrix converts from eye to clip coordinates.)
@@ -120,6 +136,21 @@ CullInfo::CullInfo(const CullInfo &src)
 	}
 }
 
+void
+CullInfo::getKernelParams(CullKernelParams &outParams) const
+{
+	// the clip planes are in the order SphereIsVisible checks them.
+	const float *clips[6] = {nea_clip, bot_clip, top_clip, lft_clip, rgt_clip, far_clip};
+	for (int c = 0; c < 16; c++) {
+		outParams.modelView[c] = model_view[c];
+	}
+	for (int p = 0; p < 6; p++) {
+		for (int c = 0; c < 4; c++) {
+			outParams.clip[p][c] = clips[p][c];
+		}
+	}
+}
+
 bool
 CullInfo::checkClip(const float eye[4], const float clip[4], float r)
 {
@@ -27,6 +27,8 @@
 
 #include <XPLMDataAccess.h>
 
+#include "CullKernel.h"
+
 // This struct has everything we need to cull fast!
 class CullInfo
 {
@@ -42,6 +44,11 @@ public:
      */
     CullInfo();
 
+    /** Creates a new CullInfo from the provided (column-major) modelview and
+     * projection matrices.
+     */
+    CullInfo(const float modelView[16], const float projection[16]);
+
     CullInfo(const CullInfo &src);
 
     /** SphereIsVisible performs a visibility check at the location (in view
@@ -67,6 +74,12 @@ public:
      */
     void ConvertTo2D(float x, float y, float z, float w, float *out_x, float *out_y) const;
 
+    /** getKernelParams fills in the camera part of the CullKernel's
+     * parameters, so the kernel gives the same results as SphereIsVisible
+     * and SphereDistanceSqr.
+     */
+    void getKernelParams(CullKernelParams &outParams) const;
+
 protected:
     float model_view[16];	// The model view matrix, to get from local OpenGL to eye coordinates.
     float proj[16];			// Proj matrix - this is just a hack to use for gluProject.
@@ -78,6 +91,8 @@ protected:
     float top_clip[4];
 
 private:
+	void	setupClipPlanes();
+
 	static XPLMDataRef	projectionMatrixRef;
 	static XPLMDataRef	modelviewMatrixRef;
 
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "CullKernel.h"
+#include "CullKernelImpl.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+void
+cullKernelScalarRange(const CullKernelParams &params,
+                      const float *x, const float *y, const float *z, const float *radius,
+                      size_t begin, size_t count,
+                      float *outDistanceSqr, uint8_t *outVisible, uint8_t *outLod)
+{
+	const float *mv = params.modelView;
+	for (size_t i = begin; i < count; i++) {
+		// this must match CullInfo operation for operation, so the results
+		// are identical.
+		float ex = x[i] * mv[0] + y[i] * mv[4] + z[i] * mv[ 8] + mv[12];
+		float ey = x[i] * mv[1] + y[i] * mv[5] + z[i] * mv[ 9] + mv[13];
+		float ez = x[i] * mv[2] + y[i] * mv[6] + z[i] * mv[10] + mv[14];
+		const float ew = x[i] * mv[3] + y[i] * mv[7] + z[i] * mv[11] + mv[15];
+
+		const float distanceSqr = ex * ex + ey * ey + ez * ez;
+		outDistanceSqr[i] = distanceSqr;
+
+		if (ew != 0.0f) {
+			const float w = 1.0f / ew;
+			ex *= w;
+			ey *= w;
+			ez *= w;
+		}
+		const float r = (radius != nullptr) ? radius[i] : params.radius;
+		uint8_t visible = CullVisibility_InFrustum;
+		for (const auto &clip: params.clip) {
+			if ((ex * clip[0] + ey * clip[1] + ez * clip[2] + clip[3] + r) < 0) {
+				visible = 0;
+				break;
+			}
+		}
+		if (params.visibilityDistanceSqr <= 0.0f || !(distanceSqr > params.visibilityDistanceSqr)) {
+			visible |= CullVisibility_InRange;
+		}
+		outVisible[i] = visible;
+		outLod[i] = (distanceSqr > params.fullDetailDistanceSqr) ? CullLod_Reduced : CullLod_Full;
+	}
+}
+
+static void
+cullScalar(const CullKernelParams &params,
+           const float *x, const float *y, const float *z, const float *radius,
+           size_t count,
+           float *outDistanceSqr, uint8_t *outVisible, uint8_t *outLod)
+{
+	cullKernelScalarRange(params, x, y, z, radius, 0, count, outDistanceSqr, outVisible, outLod);
+}
+
+const CullKernelFunc gCullKernelScalar = &cullScalar;
+
+static bool
+cpuHasAVX2()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int regs[4];
+	__cpuid(regs, 0);
+	if (regs[0] < 7) {
+		return false;
+	}
+	// the OS must also be saving the AVX state.
+	__cpuid(regs, 1);
+	const bool osxsave = (regs[2] & (1 << 27)) != 0;
+	if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+		return false;
+	}
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	return false;
+#endif
+}
+
+static CullKernelFunc
+getKernel(CullKernel::Isa isa)
+{
+	switch (isa) {
+	case CullKernel::Isa::Scalar:
+		return gCullKernelScalar;
+	case CullKernel::Isa::SSE2:
+		return gCullKernelSSE2;
+	case CullKernel::Isa::AVX2:
+		return cpuHasAVX2() ? gCullKernelAVX2 : nullptr;
+	case CullKernel::Isa::NEON:
+		return gCullKernelNEON;
+	}
+	return nullptr;
+}
+
+static CullKernel::Isa
+selectIsa()
+{
+	static const CullKernel::Isa preferred[] = {
+		CullKernel::Isa::AVX2,
+		CullKernel::Isa::SSE2,
+		CullKernel::Isa::NEON,
+	};
+	for (auto isa: preferred) {
+		if (getKernel(isa) != nullptr) {
+			return isa;
+		}
+	}
+	return CullKernel::Isa::Scalar;
+}
+
+CullKernel::Isa
+CullKernel::getActiveIsa()
+{
+	static const Isa activeIsa = selectIsa();
+	return activeIsa;
+}
+
+bool
+CullKernel::isSupported(Isa isa)
+{
+	return getKernel(isa) != nullptr;
+}
+
+const char *
+CullKernel::getIsaName(Isa isa)
+{
+	switch (isa) {
+	case Isa::Scalar:
+		return "scalar";
+	case Isa::SSE2:
+		return "SSE2";
+	case Isa::AVX2:
+		return "AVX2";
+	case Isa::NEON:
+		return "NEON";
+	}
+	return "unknown";
+}
+
+void
+CullKernel::run(const CullKernelParams &params,
+                const float *x, const float *y, const float *z, const float *radius,
+                size_t count,
+                float *outDistanceSqr, uint8_t *outVisible, uint8_t *outLod)
+{
+	static const CullKernelFunc kernel = getKernel(getActiveIsa());
+	kernel(params, x, y, z, radius, count, outDistanceSqr, outVisible, outLod);
+}
+
+void
+CullKernel::runWith(Isa isa,
+                    const CullKernelParams &params,
+                    const float *x, const float *y, const float *z, const float *radius,
+                    size_t count,
+                    float *outDistanceSqr, uint8_t *outVisible, uint8_t *outLod)
+{
+	auto kernel = getKernel(isa);
+	if (kernel == nullptr) {
+		kernel = gCullKernelScalar;
+	}
+	kernel(params, x, y, z, radius, count, outDistanceSqr, outVisible, outLod);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef CULLKERNEL_H
+#define CULLKERNEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+/** CullLod is the level of detail class the cull kernel sorts planes into */
+enum CullLod : uint8_t {
+	CullLod_Full = 0,		// within the full detail distance
+	CullLod_Reduced = 1,	// beyond the full detail distance
+};
+
+/** CullVisibility are the visibility flags the cull kernel produces */
+enum CullVisibility : uint8_t {
+	CullVisibility_InFrustum =	1U << 0,	// the bounding sphere is within the view frustum
+	CullVisibility_InRange =	1U << 1,	// the plane is within the horizontal visibility
+};
+
+/** CullResult is the kernel's output for a single plane */
+struct CullResult {
+	float	distanceSqr;
+	uint8_t	visibility;		// CullVisibility flags
+	uint8_t	lod;			// CullLod
+};
+
+/** CullKernelParams holds the per-frame inputs to the cull kernel.  Build it
+ * with CullInfo::getKernelParams().
+ */
+struct CullKernelParams {
+	float	modelView[16];		// column-major, as in CullInfo
+	float	clip[6][4];			// near, bottom, top, left, right, far - in the order they're tested
+	float	radius;				// bounding radius for the frustum test, if the caller doesn't give one per plane
+	float	fullDetailDistanceSqr;
+	float	visibilityDistanceSqr;	// 0 if the visibility is unlimited
+};
+
+/** CullKernel classifies a batch of planes at once: the square of their
+ * distance from the camera, their CullVisibility and their CullLod.
+ *
+ * The results match CullInfo::SphereDistanceSqr() and
+ * CullInfo::SphereIsVisible() for each plane.  The kernel has scalar, SSE2,
+ * AVX2 and NEON implementations - the best one the CPU supports is picked the
+ * first time it's used.
+ *
+ * The kernel only performs calculations and is safe to call from the
+ * renderer's worker threads.
+ */
+namespace CullKernel {
+	enum class Isa {
+		Scalar,
+		SSE2,
+		AVX2,
+		NEON,
+	};
+
+	/** run classifies count planes with the best available implementation.
+	 *
+	 * @param params the per-frame parameters
+	 * @param x,y,z the planes' local (OpenGL) coordinates
+	 * @param radius the planes' bounding radii for the frustum test, or
+	 *   nullptr to use params.radius for all of them
+	 * @param count the number of planes
+	 * @param outDistanceSqr receives the square of each plane's distance from
+	 *   the camera
+	 * @param outVisible receives each plane's CullVisibility flags
+	 * @param outLod receives each plane's CullLod
+	 */
+	void		run(const CullKernelParams &params,
+	                const float *x, const float *y, const float *z, const float *radius,
+	                size_t count,
+	                float *outDistanceSqr, uint8_t *outVisible, uint8_t *outLod);
+
+	/** runWith works like run, but with a specific implementation.  The
+	 * implementation must be supported by this CPU.
+	 */
+	void		runWith(Isa isa,
+	                    const CullKernelParams &params,
+	                    const float *x, const float *y, const float *z, const float *radius,
+	                    size_t count,
+	                    float *outDistanceSqr, uint8_t *outVisible, uint8_t *outLod);
+
+	/** isSupported returns true if the implementation was built in, and can
+	 * be run on this CPU.
+	 */
+	bool		isSupported(Isa isa);
+
+	/** getActiveIsa returns the implementation run() uses */
+	Isa			getActiveIsa();
+
+	const char *getIsaName(Isa isa);
+}
+
+#endif //CULLKERNEL_H
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "CullKernelImpl.h"
+
+// this file is built with the AVX2 instruction set enabled - the kernel is
+// only ever called once the CPU has been checked for it.
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+// each step is kept as a separate multiply and add, in the same order as the
+// scalar code, so the results are bit for bit identical.
+static inline __m256
+transformRow(__m256 x, __m256 y, __m256 z, const float *mv, int row)
+{
+	return _mm256_add_ps(
+		_mm256_add_ps(
+			_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(mv[row])), _mm256_mul_ps(y, _mm256_set1_ps(mv[row + 4]))),
+			_mm256_mul_ps(z, _mm256_set1_ps(mv[row + 8]))),
+		_mm256_set1_ps(mv[row + 12]));
+}
+
+static void
+cullAVX2(const CullKernelParams &params,
+         const float *x, const float *y, const float *z, const float *radius,
+         size_t count,
+         float *outDistanceSqr, uint8_t *outVisible, uint8_t *outLod)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 defaultRadius = _mm256_set1_ps(params.radius);
+	const __m256 fullDetailSqr = _mm256_set1_ps(params.fullDetailDistanceSqr);
+	const __m256 visibilitySqr = _mm256_set1_ps(params.visibilityDistanceSqr);
+	const bool limitedVisibility = params.visibilityDistanceSqr > 0.0f;
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256 px = _mm256_loadu_ps(x + i);
+		const __m256 py = _mm256_loadu_ps(y + i);
+		const __m256 pz = _mm256_loadu_ps(z + i);
+
+		__m256 ex = transformRow(px, py, pz, params.modelView, 0);
+		__m256 ey = transformRow(px, py, pz, params.modelView, 1);
+		__m256 ez = transformRow(px, py, pz, params.modelView, 2);
+		const __m256 ew = transformRow(px, py, pz, params.modelView, 3);
+
+		const __m256 distanceSqr = _mm256_add_ps(
+			_mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey)), _mm256_mul_ps(ez, ez));
+		_mm256_storeu_ps(outDistanceSqr + i, distanceSqr);
+
+		// only normalise the lanes where w != 0
+		const __m256 hasW = _mm256_cmp_ps(ew, zero, _CMP_NEQ_UQ);
+		const __m256 w = _mm256_div_ps(one, ew);
+		ex = _mm256_blendv_ps(ex, _mm256_mul_ps(ex, w), hasW);
+		ey = _mm256_blendv_ps(ey, _mm256_mul_ps(ey, w), hasW);
+		ez = _mm256_blendv_ps(ez, _mm256_mul_ps(ez, w), hasW);
+
+		const __m256 r = (radius != nullptr) ? _mm256_loadu_ps(radius + i) : defaultRadius;
+		__m256 outside = _mm256_setzero_ps();
+		for (const auto &clip: params.clip) {
+			const __m256 d = _mm256_add_ps(
+				_mm256_add_ps(
+					_mm256_add_ps(
+						_mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(clip[0])), _mm256_mul_ps(ey, _mm256_set1_ps(clip[1]))),
+						_mm256_mul_ps(ez, _mm256_set1_ps(clip[2]))),
+					_mm256_set1_ps(clip[3])),
+				r);
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, zero, _CMP_LT_OQ));
+		}
+		const int outsideMask = _mm256_movemask_ps(outside);
+		const int beyondMask = limitedVisibility ?
+			_mm256_movemask_ps(_mm256_cmp_ps(distanceSqr, visibilitySqr, _CMP_GT_OQ)) : 0;
+		const int reducedMask = _mm256_movemask_ps(_mm256_cmp_ps(distanceSqr, fullDetailSqr, _CMP_GT_OQ));
+
+		for (int lane = 0; lane < 8; lane++) {
+			const int bit = 1 << lane;
+			outVisible[i + lane] = static_cast<uint8_t>(
+				((outsideMask & bit) ? 0 : CullVisibility_InFrustum) |
+				((beyondMask & bit) ? 0 : CullVisibility_InRange));
+			outLod[i + lane] = (reducedMask & bit) ? CullLod_Reduced : CullLod_Full;
+		}
+	}
+	cullKernelScalarRange(params, x, y, z, radius, i, count, outDistanceSqr, outVisible, outLod);
+}
+
+const CullKernelFunc gCullKernelAVX2 = &cullAVX2;
+
+#else
+
+const CullKernelFunc gCullKernelAVX2 = nullptr;
+
+#endif
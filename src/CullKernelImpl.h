@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef CULLKERNELIMPL_H
+#define CULLKERNELIMPL_H
+
+/* the individual CullKernel implementations.  Each is compiled in it's own
+ * translation unit so it can be built with the instruction set flags it
+ * needs - if the compiler can't target it, the pointer is null.
+ */
+
+#include "CullKernel.h"
+
+typedef void (*CullKernelFunc)(const CullKernelParams &params,
+                               const float *x, const float *y, const float *z, const float *radius,
+                               size_t count,
+                               float *outDistanceSqr, uint8_t *outVisible, uint8_t *outLod);
+
+extern const CullKernelFunc		gCullKernelScalar;
+extern const CullKernelFunc		gCullKernelSSE2;
+extern const CullKernelFunc		gCullKernelAVX2;
+extern const CullKernelFunc		gCullKernelNEON;
+
+/** cullKernelScalarRange runs the scalar kernel over [begin, count) - the
+ * SIMD kernels use it for the elements left over after their last full
+ * vector.
+ */
+void	cullKernelScalarRange(const CullKernelParams &params,
+                              const float *x, const float *y, const float *z, const float *radius,
+                              size_t begin, size_t count,
+                              float *outDistanceSqr, uint8_t *outVisible, uint8_t *outLod);
+
+#endif //CULLKERNELIMPL_H
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "CullKernelImpl.h"
+
+// NEON is only used on 64-bit ARM, where it's always present and has a
+// vector divide.
+#if defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+
+// each step is kept as a separate multiply and add (vmlaq would be allowed to
+// fuse them), in the same order as the scalar code.
+static inline float32x4_t
+transformRow(float32x4_t x, float32x4_t y, float32x4_t z, const float *mv, int row)
+{
+	return vaddq_f32(
+		vaddq_f32(
+			vaddq_f32(vmulq_n_f32(x, mv[row]), vmulq_n_f32(y, mv[row + 4])),
+			vmulq_n_f32(z, mv[row + 8])),
+		vdupq_n_f32(mv[row + 12]));
+}
+
+static void
+cullNEON(const CullKernelParams &params,
+         const float *x, const float *y, const float *z, const float *radius,
+         size_t count,
+         float *outDistanceSqr, uint8_t *outVisible, uint8_t *outLod)
+{
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const float32x4_t defaultRadius = vdupq_n_f32(params.radius);
+	const float32x4_t fullDetailSqr = vdupq_n_f32(params.fullDetailDistanceSqr);
+	const float32x4_t visibilitySqr = vdupq_n_f32(params.visibilityDistanceSqr);
+	const bool limitedVisibility = params.visibilityDistanceSqr > 0.0f;
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const float32x4_t px = vld1q_f32(x + i);
+		const float32x4_t py = vld1q_f32(y + i);
+		const float32x4_t pz = vld1q_f32(z + i);
+
+		float32x4_t ex = transformRow(px, py, pz, params.modelView, 0);
+		float32x4_t ey = transformRow(px, py, pz, params.modelView, 1);
+		float32x4_t ez = transformRow(px, py, pz, params.modelView, 2);
+		const float32x4_t ew = transformRow(px, py, pz, params.modelView, 3);
+
+		const float32x4_t distanceSqr = vaddq_f32(vaddq_f32(vmulq_f32(ex, ex), vmulq_f32(ey, ey)), vmulq_f32(ez, ez));
+		vst1q_f32(outDistanceSqr + i, distanceSqr);
+
+		// only normalise the lanes where w != 0
+		const uint32x4_t hasW = vmvnq_u32(vceqq_f32(ew, zero));
+		const float32x4_t w = vdivq_f32(one, ew);
+		ex = vbslq_f32(hasW, vmulq_f32(ex, w), ex);
+		ey = vbslq_f32(hasW, vmulq_f32(ey, w), ey);
+		ez = vbslq_f32(hasW, vmulq_f32(ez, w), ez);
+
+		const float32x4_t r = (radius != nullptr) ? vld1q_f32(radius + i) : defaultRadius;
+		uint32x4_t outside = vdupq_n_u32(0);
+		for (const auto &clip: params.clip) {
+			const float32x4_t d = vaddq_f32(
+				vaddq_f32(
+					vaddq_f32(
+						vaddq_f32(vmulq_n_f32(ex, clip[0]), vmulq_n_f32(ey, clip[1])),
+						vmulq_n_f32(ez, clip[2])),
+					vdupq_n_f32(clip[3])),
+				r);
+			outside = vorrq_u32(outside, vcltq_f32(d, zero));
+		}
+		const uint32x4_t beyond = limitedVisibility ? vcgtq_f32(distanceSqr, visibilitySqr) : vdupq_n_u32(0);
+		const uint32x4_t reduced = vcgtq_f32(distanceSqr, fullDetailSqr);
+
+		uint32_t outsideLanes[4], beyondLanes[4], reducedLanes[4];
+		vst1q_u32(outsideLanes, outside);
+		vst1q_u32(beyondLanes, beyond);
+		vst1q_u32(reducedLanes, reduced);
+		for (int lane = 0; lane < 4; lane++) {
+			outVisible[i + lane] = static_cast<uint8_t>(
+				(outsideLanes[lane] ? 0 : CullVisibility_InFrustum) |
+				(beyondLanes[lane] ? 0 : CullVisibility_InRange));
+			outLod[i + lane] = reducedLanes[lane] ? CullLod_Reduced : CullLod_Full;
+		}
+	}
+	cullKernelScalarRange(params, x, y, z, radius, i, count, outDistanceSqr, outVisible, outLod);
+}
+
+const CullKernelFunc gCullKernelNEON = &cullNEON;
+
+#else
+
+const CullKernelFunc gCullKernelNEON = nullptr;
+
+#endif
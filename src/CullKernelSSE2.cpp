@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "CullKernelImpl.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+// each step is kept as a separate multiply and add, in the same order as the
+// scalar code, so the results are bit for bit identical.
+static inline __m128
+transformRow(__m128 x, __m128 y, __m128 z, const float *mv, int row)
+{
+	return _mm_add_ps(
+		_mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(mv[row])), _mm_mul_ps(y, _mm_set1_ps(mv[row + 4]))),
+			_mm_mul_ps(z, _mm_set1_ps(mv[row + 8]))),
+		_mm_set1_ps(mv[row + 12]));
+}
+
+static void
+cullSSE2(const CullKernelParams &params,
+         const float *x, const float *y, const float *z, const float *radius,
+         size_t count,
+         float *outDistanceSqr, uint8_t *outVisible, uint8_t *outLod)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 defaultRadius = _mm_set1_ps(params.radius);
+	const __m128 fullDetailSqr = _mm_set1_ps(params.fullDetailDistanceSqr);
+	const __m128 visibilitySqr = _mm_set1_ps(params.visibilityDistanceSqr);
+	const bool limitedVisibility = params.visibilityDistanceSqr > 0.0f;
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128 px = _mm_loadu_ps(x + i);
+		const __m128 py = _mm_loadu_ps(y + i);
+		const __m128 pz = _mm_loadu_ps(z + i);
+
+		__m128 ex = transformRow(px, py, pz, params.modelView, 0);
+		__m128 ey = transformRow(px, py, pz, params.modelView, 1);
+		__m128 ez = transformRow(px, py, pz, params.modelView, 2);
+		const __m128 ew = transformRow(px, py, pz, params.modelView, 3);
+
+		const __m128 distanceSqr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)), _mm_mul_ps(ez, ez));
+		_mm_storeu_ps(outDistanceSqr + i, distanceSqr);
+
+		// only normalise the lanes where w != 0
+		const __m128 hasW = _mm_cmpneq_ps(ew, zero);
+		const __m128 w = _mm_div_ps(one, ew);
+		ex = _mm_or_ps(_mm_and_ps(hasW, _mm_mul_ps(ex, w)), _mm_andnot_ps(hasW, ex));
+		ey = _mm_or_ps(_mm_and_ps(hasW, _mm_mul_ps(ey, w)), _mm_andnot_ps(hasW, ey));
+		ez = _mm_or_ps(_mm_and_ps(hasW, _mm_mul_ps(ez, w)), _mm_andnot_ps(hasW, ez));
+
+		const __m128 r = (radius != nullptr) ? _mm_loadu_ps(radius + i) : defaultRadius;
+		__m128 outside = _mm_setzero_ps();
+		for (const auto &clip: params.clip) {
+			const __m128 d = _mm_add_ps(
+				_mm_add_ps(
+					_mm_add_ps(
+						_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(clip[0])), _mm_mul_ps(ey, _mm_set1_ps(clip[1]))),
+						_mm_mul_ps(ez, _mm_set1_ps(clip[2]))),
+					_mm_set1_ps(clip[3])),
+				r);
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(d, zero));
+		}
+		const int outsideMask = _mm_movemask_ps(outside);
+		const int beyondMask = limitedVisibility ? _mm_movemask_ps(_mm_cmpgt_ps(distanceSqr, visibilitySqr)) : 0;
+		const int reducedMask = _mm_movemask_ps(_mm_cmpgt_ps(distanceSqr, fullDetailSqr));
+
+		for (int lane = 0; lane < 4; lane++) {
+			const int bit = 1 << lane;
+			outVisible[i + lane] = static_cast<uint8_t>(
+				((outsideMask & bit) ? 0 : CullVisibility_InFrustum) |
+				((beyondMask & bit) ? 0 : CullVisibility_InRange));
+			outLod[i + lane] = (reducedMask & bit) ? CullLod_Reduced : CullLod_Full;
+		}
+	}
+	cullKernelScalarRange(params, x, y, z, radius, i, count, outDistanceSqr, outVisible, outLod);
+}
+
+const CullKernelFunc gCullKernelSSE2 = &cullSSE2;
+
+#else
+
+const CullKernelFunc gCullKernelSSE2 = nullptr;
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "FrameContext.h"
+
+#include <XPLMCamera.h>
+#include <XPLMProcessing.h>
+
+#include "XPMPMultiplayerVars.h"
+#include "XUtils.h"
+
+// the bounding radius assumed for every plane in the frustum test
+static const float	kCullRadius = 50.0f;
+
+XPLMDataRef		FrameContext::visibilityRef = nullptr;
+XPLMDataRef		FrameContext::userAltitudeRef = nullptr;
+XPLMDataRef		FrameContext::latRefRef = nullptr;
+XPLMDataRef		FrameContext::lonRefRef = nullptr;
+
+void
+FrameContext::init()
+{
+	visibilityRef = XPLMFindDataRef("sim/graphics/view/visibility_effective_m");
+	if (visibilityRef == nullptr) {
+		visibilityRef = XPLMFindDataRef("sim/weather/visibility_effective_m");
+	}
+	if (visibilityRef == nullptr) {
+		XPLMDebugString(
+			"WARNING: Default renderer could not find effective visibility in the sim.\n");
+	}
+	userAltitudeRef = XPLMFindDataRef("sim/flightmodel/position/elevation");
+	latRefRef = XPLMFindDataRef("sim/flightmodel/position/lat_ref");
+	lonRefRef = XPLMFindDataRef("sim/flightmodel/position/lon_ref");
+}
+
+FrameContext::FrameContext() :
+	camera(),
+	config(gConfiguration)
+{
+	XPLMCameraPosition_t x_camera;
+	XPLMReadCameraPosition(&x_camera);
+	cameraZoom = x_camera.zoom;
+
+	visibility = (visibilityRef != nullptr) ? XPLMGetDataf(visibilityRef) : 0.0f;
+	userAltitudeFt = (userAltitudeRef != nullptr) ? (XPLMGetDatad(userAltitudeRef) / kFtToMeters) : 0.0;
+	// Only draw planes fully within 3 miles.
+	fullPlaneDistance = cameraZoom * (5280.0 / 3.2) * config.maxFullAircraftRenderingDistance;
+	// maxFullAircraftRenderingDistance and prefetchDistance are in km.
+	fullDetailDistance = config.maxFullAircraftRenderingDistance * 1000.0f;
+	prefetchDistance = fullDetailDistance + config.prefetchDistance * 1000.0f;
+	latRef = (latRefRef != nullptr) ? XPLMGetDataf(latRefRef) : 0.0f;
+	lonRef = (lonRefRef != nullptr) ? XPLMGetDataf(lonRefRef) : 0.0f;
+	cycle = XPLMGetCycleNumber();
+	elapsedTime = XPLMGetElapsedTime();
+
+	camera.getKernelParams(cullParams);
+	cullParams.radius = kCullRadius;
+	cullParams.fullDetailDistanceSqr = fullDetailDistance * fullDetailDistance;
+	cullParams.visibilityDistanceSqr = (visibility > 0.0f) ? (visibility * visibility) : 0.0f;
+}
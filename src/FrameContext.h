@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef FRAMECONTEXT_H
+#define FRAMECONTEXT_H
+
+#include <XPLMDataAccess.h>
+
+#include "XPMPMultiplayer.h"
+#include "CullInfo.h"
+#include "CullKernel.h"
+
+/** FrameContext is a snapshot of the simulator and library state that the
+ * per-plane update needs for a single frame.
+ *
+ * It's captured once per frame by the renderer on the main thread and then
+ * only ever passed by const reference, so the per-plane calculations never
+ * need to read a dataref (or a global that may change under them) and are
+ * safe to run on the renderer's worker threads.
+ */
+class FrameContext {
+public:
+	/** Looks up the datarefs the FrameContext samples.  Must be called (once!)
+	 * before capturing a FrameContext.
+	 */
+	static void init();
+
+	/** Captures the current state from the simulator.  This calls into the
+	 * XPLM and must only be done from the main thread.
+	 */
+	FrameContext();
+
+	FrameContext(const FrameContext &src) = default;
+
+	CullInfo			camera;				// the camera's view for culling and distances
+	CullKernelParams	cullParams;			// the camera, LOD and visibility thresholds for the CullKernel
+	float				cameraZoom;			// camera zoom factor
+	float				visibility;			// horizontal visibility in meters, or 0 if unknown
+	double				userAltitudeFt;		// the user's aircraft elevation in feet
+	double				fullPlaneDistance;	// within this distance (in meters) planes are always fully updated
+	float				fullDetailDistance;	// the boundary (in meters) of the full detail level of detail band
+	float				prefetchDistance;	// within this distance (in meters) planes have their full detail models loaded
+	float				latRef;				// latitude of the local coordinate origin
+	float				lonRef;				// longitude of the local coordinate origin
+	int					cycle;				// the simulator's cycle number
+	float				elapsedTime;		// simulator time in seconds
+	XPMPConfiguration_t	config;				// the library configuration for this frame
+
+private:
+	static XPLMDataRef	visibilityRef;
+	static XPLMDataRef	userAltitudeRef;
+	static XPLMDataRef	latRefRef;
+	static XPLMDataRef	lonRefRef;
+};
+
+#endif //FRAMECONTEXT_H
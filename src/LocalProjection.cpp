@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "LocalProjection.h"
+
+#include <cmath>
+
+// WGS84 ellipsoid
+static const double kSemiMajorAxis = 6378137.0;
+static const double kFlattening = 1.0 / 298.257223563;
+static const double kEccentricitySqr = kFlattening * (2.0 - kFlattening);
+static const double kDegToRad = 3.14159265358979323846 / 180.0;
+
+static inline void
+geodeticToECEF(double lat, double lon, double alt, double &outX, double &outY, double &outZ)
+{
+	const double sinLat = sin(lat * kDegToRad);
+	const double cosLat = cos(lat * kDegToRad);
+	const double sinLon = sin(lon * kDegToRad);
+	const double cosLon = cos(lon * kDegToRad);
+	// prime vertical radius of curvature
+	const double n = kSemiMajorAxis / sqrt(1.0 - kEccentricitySqr * sinLat * sinLat);
+
+	outX = (n + alt) * cosLat * cosLon;
+	outY = (n + alt) * cosLat * sinLon;
+	outZ = (n * (1.0 - kEccentricitySqr) + alt) * sinLat;
+}
+
+LocalProjection::LocalProjection()
+{
+	// force the first setReference to do the work.
+	mLatRef = NAN;
+	mLonRef = NAN;
+	setReference(0.0, 0.0);
+}
+
+bool
+LocalProjection::setReference(double latRef, double lonRef)
+{
+	if (latRef == mLatRef && lonRef == mLonRef) {
+		return false;
+	}
+	mLatRef = latRef;
+	mLonRef = lonRef;
+
+	geodeticToECEF(latRef, lonRef, 0.0, mOriginX, mOriginY, mOriginZ);
+
+	const double sinLat = sin(latRef * kDegToRad);
+	const double cosLat = cos(latRef * kDegToRad);
+	const double sinLon = sin(lonRef * kDegToRad);
+	const double cosLon = cos(lonRef * kDegToRad);
+
+	mEast[0] = -sinLon;
+	mEast[1] = cosLon;
+	mEast[2] = 0.0;
+
+	mNorth[0] = -sinLat * cosLon;
+	mNorth[1] = -sinLat * sinLon;
+	mNorth[2] = cosLat;
+
+	mUp[0] = cosLat * cosLon;
+	mUp[1] = cosLat * sinLon;
+	mUp[2] = sinLat;
+	return true;
+}
+
+void
+LocalProjection::worldToLocal(double lat, double lon, double alt,
+                              double &outX, double &outY, double &outZ) const
+{
+	double ex, ey, ez;
+	geodeticToECEF(lat, lon, alt, ex, ey, ez);
+	const double dx = ex - mOriginX;
+	const double dy = ey - mOriginY;
+	const double dz = ez - mOriginZ;
+
+	outX = mEast[0] * dx + mEast[1] * dy + mEast[2] * dz;
+	outY = mUp[0] * dx + mUp[1] * dy + mUp[2] * dz;
+	outZ = -(mNorth[0] * dx + mNorth[1] * dy + mNorth[2] * dz);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef LOCALPROJECTION_H
+#define LOCALPROJECTION_H
+
+/** LocalProjection converts geodetic (WGS84) positions into the simulator's
+ * local OpenGL coordinates without calling into the XPLM.
+ *
+ * The local frame is a tangent plane to the WGS84 ellipsoid at the reference
+ * point (sim/flightmodel/position/lat_ref and lon_ref) at sea level, with +X
+ * pointing east, +Y up and +Z south, all in meters.
+ *
+ * Once the reference point is set, conversion is pure calculation and is
+ * safe to perform from the renderer's worker threads.
+ */
+class LocalProjection {
+public:
+	LocalProjection();
+
+	/** setReference moves the origin of the local frame.
+	 *
+	 * @return true if the reference point actually changed.
+	 */
+	bool	setReference(double latRef, double lonRef);
+
+	/** worldToLocal converts a single position.
+	 *
+	 * @param lat latitude in degrees
+	 * @param lon longitude in degrees
+	 * @param alt altitude above mean sea level in meters
+	 */
+	void	worldToLocal(double lat, double lon, double alt,
+	                     double &outX, double &outY, double &outZ) const;
+
+private:
+	double	mLatRef;
+	double	mLonRef;
+
+	// the reference point in earth-centred, earth-fixed coordinates
+	double	mOriginX;
+	double	mOriginY;
+	double	mOriginZ;
+
+	// the rows of the ECEF to east/north/up rotation
+	double	mEast[3];
+	double	mNorth[3];
+	double	mUp[3];
+};
+
+#endif //LOCALPROJECTION_H
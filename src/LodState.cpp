@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "LodState.h"
+
+#include <algorithm>
+#include <cmath>
+
+LodState::LodState() :
+	mBand(LodBand::Full),
+	mValid(false),
+	mChangedAt(0.0f),
+	mDistance(0.0f),
+	mDistanceAt(0.0f),
+	mClosingSpeed(0.0f)
+{
+}
+
+void
+LodState::trackApproach(const FrameContext &frame, float distanceSqr)
+{
+	const float distance = std::sqrt(distanceSqr);
+	const float dt = frame.elapsedTime - mDistanceAt;
+	if (!mValid || dt < 0.0f) {
+		mClosingSpeed = 0.0f;
+	} else if (dt > 0.0f) {
+		// the updates don't come at a steady rate, so the smoothing is
+		// weighted by the time since the last one.
+		const float speed = (mDistance - distance) / dt;
+		mClosingSpeed += std::min(1.0f, dt / kClosingSmoothing) * (speed - mClosingSpeed);
+	}
+	mDistance = distance;
+	mDistanceAt = frame.elapsedTime;
+}
+
+bool
+LodState::wantsPrefetch(const FrameContext &frame) const
+{
+	if (!mValid || mBand == LodBand::Full) {
+		return false;
+	}
+	if (frame.config.prefetchDistance > 0.0f && mDistance <= frame.prefetchDistance) {
+		return true;
+	}
+	const float leadTime = frame.config.prefetchLeadTime;
+	return leadTime > 0.0f && mClosingSpeed > 0.0f &&
+		(mDistance - frame.fullDetailDistance) <= mClosingSpeed * leadTime;
+}
+
+bool
+LodState::update(const FrameContext &frame, const CullResult &cull)
+{
+	const float distanceSqr = cull.distanceSqr;
+	trackApproach(frame, distanceSqr);
+
+	const float boundaries[] = {
+		frame.fullDetailDistance,
+		frame.fullDetailDistance * kDistantFactor,
+	};
+
+	// the band the plane would be in without any hysteresis - the kernel
+	// has already placed it either side of the full detail distance...
+	int band = 0;
+	if (cull.lod != CullLod_Full) {
+		band = (distanceSqr > boundaries[1] * boundaries[1]) ? 2 : 1;
+	}
+	if (!mValid) {
+		mValid = true;
+		mBand = static_cast<LodBand>(band);
+		mChangedAt = frame.elapsedTime;
+		return true;
+	}
+
+	// ... but it only leaves it's current band once it's clear of the
+	// boundary.
+	const int current = static_cast<int>(mBand);
+	if (band > current) {
+		const float exit = boundaries[current] * (1.0f + kHysteresis);
+		if (distanceSqr <= exit * exit) {
+			return false;
+		}
+	} else if (band < current) {
+		const float exit = boundaries[current - 1] * (1.0f - kHysteresis);
+		if (distanceSqr >= exit * exit) {
+			return false;
+		}
+	} else {
+		return false;
+	}
+
+	// the clock can go backwards when the sim is reset.
+	const float dwell = frame.elapsedTime - mChangedAt;
+	if (dwell >= 0.0f && dwell < frame.config.lodMinDwell) {
+		return false;
+	}
+	mBand = static_cast<LodBand>(band);
+	mChangedAt = frame.elapsedTime;
+	return true;
+}
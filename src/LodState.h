@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef LODSTATE_H
+#define LODSTATE_H
+
+#include <cstdint>
+
+#include "FrameContext.h"
+
+/** LodBand is the level of detail band a plane is drawn in */
+enum class LodBand : uint8_t {
+	Full = 0,		// within the full detail distance
+	Reduced,		// out to kDistantFactor times the full detail distance
+	Distant,		// beyond that
+};
+
+/** LodState is a plane's level of detail state machine.
+ *
+ * The bands meet at the full detail distance and kDistantFactor times it,
+ * but to move out of a band a plane has to go kHysteresis (as a fraction)
+ * past the boundary, and to come back in it has to come the same distance
+ * inside it, so a plane sitting on a boundary doesn't flip between bands
+ * (and have it's instances destroyed and recreated) every few frames.
+ *
+ * On top of that, once a plane has changed band it stays there for at least
+ * XPMPConfiguration_t.lodMinDwell seconds.
+ *
+ * It also tracks how fast the plane is closing on the camera, so
+ * wantsPrefetch() can say when the full detail model should be loaded ahead
+ * of the plane coming into range.
+ */
+class LodState {
+public:
+	/** how far (as a fraction of the boundary distance) past a boundary a
+	 * plane has to go to change band
+	 */
+	static constexpr float	kHysteresis = 0.1f;
+	/** the boundary between the reduced and distant bands, as a multiple of
+	 * the full detail distance
+	 */
+	static constexpr float	kDistantFactor = 3.0f;
+	/** the time constant (in seconds) the closing speed is smoothed over */
+	static constexpr float	kClosingSmoothing = 1.0f;
+
+	LodState();
+
+	/** update moves the plane to the band for it's new distance, if the
+	 * hysteresis and dwell time allow.
+	 *
+	 * This only performs calculations, and is safe to call from the
+	 * renderer's worker threads.
+	 *
+	 * @param frame the FrameContext for this frame
+	 * @param cull the CullKernel's results for the plane - it's CullLod
+	 *   places the plane either side of the full detail distance.
+	 * @return true if the band changed
+	 */
+	bool	update(const FrameContext &frame, const CullResult &cull);
+
+	LodBand	getBand() const { return mBand; }
+
+	/** wantsPrefetch returns true if the plane isn't in the full detail band,
+	 * but is within the prefetch distance, or closing on the full detail
+	 * distance fast enough to reach it within the prefetch lead time.
+	 *
+	 * @param frame the FrameContext for this frame
+	 */
+	bool	wantsPrefetch(const FrameContext &frame) const;
+
+private:
+	LodBand	mBand;
+	bool	mValid;			// false until the first update
+	float	mChangedAt;		// simulator time of the last band change
+	float	mDistance;		// the distance (in meters) at the last update
+	float	mDistanceAt;	// simulator time of the last update
+	float	mClosingSpeed;	// how fast (in m/s, smoothed) the distance is falling
+
+	void	trackApproach(const FrameContext &frame, float distanceSqr);
+};
+
+#endif //LODSTATE_H
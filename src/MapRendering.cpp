@@ -23,6 +23,7 @@
 
 #include "MapRendering.h"
 #include "XPMPMultiplayerVars.h"
+#include "RenderStats.h"
 #include <cmath>
 
 #ifndef M_PI
@@ -30,6 +31,7 @@
 #define M_PI 3.141592653589793
 #endif
 
+#include <algorithm>
 #include <cstring>
 
 /* map layers */
@@ -46,6 +48,10 @@ int             XPMPMapRendering::gSizeS = 1;
 int             XPMPMapRendering::gSizeT = 1;
 float           XPMPMapRendering::gIconScale = 30.0f;
 
+// the planes in view - shared by the layer callbacks, which only run on the
+// main thread.
+static std::vector<XPMPPlaneStore::index_type>  gPlanesInView;
+
 void
 XPMPMapRendering::Start()
 {
@@ -119,6 +125,53 @@ XPMPMapRendering::tryCreateMapLayers(const char *mapIdentifier, int position)
     }
 }
 
+void
+XPMPMapRendering::findPlanesInView(const float *inMapBoundsLeftTopRightBottom,
+                                   XPLMMapProjectionID projection,
+                                   std::vector<XPMPPlaneStore::index_type> &outIndices)
+{
+    const float left = inMapBoundsLeftTopRightBottom[0];
+    const float top = inMapBoundsLeftTopRightBottom[1];
+    const float right = inMapBoundsLeftTopRightBottom[2];
+    const float bottom = inMapBoundsLeftTopRightBottom[3];
+
+    // the projection needn't be rectilinear in latitude and longitude, so
+    // sample a grid over the view to find the box it covers.  Longitudes are
+    // taken relative to the centre, so views over the antimeridian work.
+    double centreLat, centreLon;
+    XPLMMapUnproject(projection, (left + right) / 2.0f, (top + bottom) / 2.0f, &centreLat, &centreLon);
+    double latMin = centreLat, latMax = centreLat;
+    double lonMin = 0.0, lonMax = 0.0;
+    const int kSamples = 4;
+    for (int i = 0; i <= kSamples; i++) {
+        for (int j = 0; j <= kSamples; j++) {
+            double lat, lon;
+            XPLMMapUnproject(projection,
+                             left + (right - left) * i / kSamples,
+                             bottom + (top - bottom) * j / kSamples,
+                             &lat, &lon);
+            double dLon = fmod(lon - centreLon + 540.0, 360.0) - 180.0;
+            latMin = std::min(latMin, lat);
+            latMax = std::max(latMax, lat);
+            lonMin = std::min(lonMin, dLon);
+            lonMax = std::max(lonMax, dLon);
+        }
+    }
+    // pad the box so icons straddling the edge are still drawn.
+    const double latPad = (latMax - latMin) * 0.05;
+    const double lonPad = (lonMax - lonMin) * 0.05;
+    latMin = std::max(-90.0, latMin - latPad);
+    latMax = std::min(90.0, latMax + latPad);
+    lonMin -= lonPad;
+    lonMax += lonPad;
+    if (latMin <= -90.0 || latMax >= 90.0 || (lonMax - lonMin) >= 360.0) {
+        lonMin = -180.0;
+        lonMax = 180.0;
+        centreLon = 0.0;
+    }
+    gPlanes.queryBox(latMin, centreLon + lonMin, latMax, centreLon + lonMax, outIndices);
+}
+
 void
 XPMPMapRendering::IconCallback(XPLMMapLayerID inLayer,
                                const float *inMapBoundsLeftTopRightBottom,
@@ -131,18 +184,21 @@ XPMPMapRendering::IconCallback(XPLMMapLayerID inLayer,
     if (gMapSheetPath.empty()) {
         return;
     }
+    ScopedPhaseTimer timer(RenderPhase::MapIcons);
 
     float mapX, mapY;
 
-    for (const auto &aircraftPair: gPlanes) {
+    findPlanesInView(inMapBoundsLeftTopRightBottom, projection, gPlanesInView);
+    for (auto i: gPlanesInView) {
+        const auto &position = gPlanes.positionAt(i);
         XPLMMapProject(projection,
-                       aircraftPair.second->mPosition.lat,
-                       aircraftPair.second->mPosition.lon,
+                       position.lat,
+                       position.lon,
                        &mapX,
                        &mapY);
 
         float iconRotation = XPLMMapGetNorthHeading(projection, mapX, mapY) +
-                             aircraftPair.second->mPosition.heading;
+                             position.heading;
         iconRotation = fmod(iconRotation, 360.0f);
         XPLMDrawMapIconFromSheet(inLayer,
                                  gMapSheetPath.c_str(),
@@ -165,6 +221,7 @@ XPMPMapRendering::LabelCallback(XPLMMapLayerID inLayer,
                                 XPLMMapProjectionID projection,
                                 void *inRefcon)
 {
+    ScopedPhaseTimer timer(RenderPhase::MapLabels);
     float offsetX = 0.0f;
     float offsetY = 0.0f;
     float mapX, mapY;
@@ -182,14 +239,16 @@ XPMPMapRendering::LabelCallback(XPLMMapLayerID inLayer,
         offsetY = static_cast<float>(cos(rotation) * linearOffset);
     }
 
-    for (const auto &aircraftPair: gPlanes) {
+    findPlanesInView(inMapBoundsLeftTopRightBottom, projection, gPlanesInView);
+    for (auto i: gPlanesInView) {
+        const auto &position = gPlanes.positionAt(i);
         XPLMMapProject(projection,
-                       aircraftPair.second->mPosition.lat,
-                       aircraftPair.second->mPosition.lon,
+                       position.lat,
+                       position.lon,
                        &mapX,
                        &mapY);
         XPLMDrawMapLabel(inLayer,
-                         aircraftPair.second->mPosition.label,
+                         gPlanes.planeAt(i)->getLabel(),
                          mapX + offsetX,
                          mapY + offsetY,
                          xplm_MapOrientation_UI,
@@ -26,8 +26,11 @@
 
 #include <cassert>
 #include <string>
+#include <vector>
 #include <XPLMMap.h>
 
+#include "XPMPPlaneStore.h"
+
 class XPMPMapRendering {
 public:
     static void Start();
@@ -62,6 +65,13 @@ protected:
 
     static void tryCreateMapLayers(const char *mapIdentifier, int position);
 
+    /** findPlanesInView finds the planes within (or just beyond) the map's
+     * view, using the plane store's spatial index.
+     */
+    static void findPlanesInView(const float *inMapBoundsLeftTopRightBottom,
+                                 XPLMMapProjectionID projection,
+                                 std::vector<XPMPPlaneStore::index_type> &outIndices);
+
     static XPLMMapLayerID gAircraftLayers[ML_COUNT];
     static std::string     gMapSheetPath;
     static int             gThisS, gThisT;
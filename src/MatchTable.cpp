@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "MatchTable.h"
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std;
+
+static mutex							gMatchIdsMutex;
+static unordered_map<string, uint32_t>	gMatchIds;
+// a deque, so the names don't move as it grows.
+static deque<string>					gMatchNames(1);
+
+uint32_t
+MatchIds::intern(const string &str)
+{
+	if (str.empty()) {
+		return 0;
+	}
+	lock_guard<mutex> lock(gMatchIdsMutex);
+	auto id = gMatchIds.find(str);
+	if (id != gMatchIds.end()) {
+		return id->second;
+	}
+	const auto newId = static_cast<uint32_t>(gMatchNames.size());
+	gMatchNames.push_back(str);
+	gMatchIds.emplace(str, newId);
+	return newId;
+}
+
+uint32_t
+MatchIds::find(const string &str)
+{
+	if (str.empty()) {
+		return 0;
+	}
+	lock_guard<mutex> lock(gMatchIdsMutex);
+	auto id = gMatchIds.find(str);
+	return (id != gMatchIds.end()) ? id->second : 0;
+}
+
+const string &
+MatchIds::getName(uint32_t id)
+{
+	lock_guard<mutex> lock(gMatchIdsMutex);
+	return (id < gMatchNames.size()) ? gMatchNames[id] : gMatchNames[0];
+}
+
+string
+MatchKey::toString() const
+{
+	string str = MatchIds::getName(type);
+	for (const auto id: {airline, livery}) {
+		if (id != 0) {
+			str += " ";
+			str += MatchIds::getName(id);
+		}
+	}
+	return str;
+}
+
+size_t
+MatchTable::hash(const MatchKey &key)
+{
+	uint64_t h = key.type * 0x9E3779B97F4A7C15ULL;
+	h ^= key.airline * 0xC2B2AE3D27D4EB4FULL;
+	h ^= key.livery * 0x165667B19E3779F9ULL;
+	h ^= h >> 29;
+	return static_cast<size_t>(h);
+}
+
+size_t
+MatchTable::findSlot(const MatchKey &key) const
+{
+	// the slot count is a power of two, and never more than half full.
+	const size_t mask = mSlots.size() - 1;
+	size_t slot = hash(key) & mask;
+	while (mSlots[slot] >= 0 && !(mEntries[mSlots[slot]].key == key)) {
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+void
+MatchTable::rehash(size_t slotCount)
+{
+	mSlots.assign(slotCount, -1);
+	for (size_t i = 0; i < mEntries.size(); i++) {
+		mSlots[findSlot(mEntries[i].key)] = static_cast<int32_t>(i);
+	}
+}
+
+void
+MatchTable::add(const MatchKey &key, int plane)
+{
+	if ((mEntries.size() + 1) * 2 > mSlots.size()) {
+		rehash(mSlots.empty() ? 16 : mSlots.size() * 2);
+	}
+	const size_t slot = findSlot(key);
+	if (mSlots[slot] >= 0) {
+		return;
+	}
+	mSlots[slot] = static_cast<int32_t>(mEntries.size());
+	mEntries.push_back(Entry{key, plane});
+}
+
+int
+MatchTable::find(const MatchKey &key) const
+{
+	if (mSlots.empty()) {
+		return -1;
+	}
+	const int32_t entry = mSlots[findSlot(key)];
+	return (entry >= 0) ? mEntries[entry].plane : -1;
+}
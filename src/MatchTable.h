@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef MATCHTABLE_H
+#define MATCHTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** MatchIds interns the ICAO codes, groups, airlines and liveries the CSL
+ * packages are matched on, so the match tables can use small integers
+ * rather than strings.
+ *
+ * Id 0 is reserved for "none", and is what the empty string interns to.
+ * Ids are never released.  These can be used from any thread.
+ */
+namespace MatchIds {
+	/** intern returns the id for str, adding it if it's new */
+	uint32_t			intern(const std::string &str);
+
+	/** find returns the id for str, or 0 if it's never been interned */
+	uint32_t			find(const std::string &str);
+
+	/** getName returns the string that was interned as id */
+	const std::string &	getName(uint32_t id);
+}
+
+/** MatchKey is a match table key: the interned ICAO code or group, airline
+ * and livery, with 0 for the parts the table doesn't use.
+ */
+struct MatchKey {
+	uint32_t	type;
+	uint32_t	airline;
+	uint32_t	livery;
+
+	bool operator==(const MatchKey &rhs) const
+	{
+		return type == rhs.type && airline == rhs.airline && livery == rhs.livery;
+	}
+
+	/** returns the key as it's strings, separated by spaces */
+	std::string	toString() const;
+};
+
+/** MatchTable maps the MatchKeys of one match level to the index of a plane
+ * in a package.
+ *
+ * The entries are kept in the order they were added, and found through a
+ * flat, open addressed hash table of their indices.
+ */
+class MatchTable {
+public:
+	struct Entry {
+		MatchKey	key;
+		int			plane;
+	};
+
+	/** add adds plane for key, unless the key's already in the table - the
+	 * first plane added for a key is the one it matches.
+	 */
+	void	add(const MatchKey &key, int plane);
+
+	/** find returns the plane for key, or -1 if there isn't one. */
+	int		find(const MatchKey &key) const;
+
+	size_t	size() const { return mEntries.size(); }
+	bool	empty() const { return mEntries.empty(); }
+
+	/** returns the entries, in the order they were added */
+	const std::vector<Entry> &	getEntries() const { return mEntries; }
+
+private:
+	static size_t	hash(const MatchKey &key);
+
+	/** findSlot returns the slot key is in, or the empty slot it'd go in */
+	size_t	findSlot(const MatchKey &key) const;
+	void	rehash(size_t slotCount);
+
+	std::vector<Entry>		mEntries;
+	std::vector<int32_t>	mSlots;		// the index into mEntries, or -1
+};
+
+#endif //MATCHTABLE_H
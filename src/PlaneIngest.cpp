@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "PlaneIngest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <XPLMUtilities.h>
+
+#include "XPMPMultiplayerVars.h"
+#include "XPMPPlane.h"
+
+using namespace std;
+
+void
+PlaneIngest::createPlane(XPMPPlaneID id, const char *modelName, const char *icao,
+                         const char *airline, const char *livery)
+{
+	auto plane = make_unique<XPMPPlane>();
+	plane->setType(PlaneType(icao, airline, livery));
+
+	bool found = false;
+	if (modelName != nullptr) {
+		for (const auto &package: gPackages) {
+			auto cslPlane = find_if(package.planes.begin(), package.planes.end(),
+				[modelName](CSL *p) {
+					return p->getModelName() == modelName;
+				});
+			if (cslPlane != package.planes.end()) {
+				plane->setCSL(*cslPlane);
+				found = true;
+			}
+		}
+		if (!found) {
+			XPLMDebugString("Requested model ");
+			XPLMDebugString(modelName);
+			XPLMDebugString(" is unknown! Falling back to own model matching.");
+			XPLMDebugString("\n");
+		}
+	}
+	if (!found) {
+		plane->updateCSL();
+	}
+	gPlanes.insert(id, std::move(plane));
+}
+
+void
+PlaneIngest::applyUpdate(XPMPPlaneStore::index_type i, const XPMPUpdate_t &update, size_t updateSize)
+{
+	if (update.position) {
+		gPlanes.updatePosition(i, *update.position);
+	}
+	if (update.surfaces) {
+		gPlanes.updateSurfaces(i, *update.surfaces);
+	}
+	if (update.surveillance) {
+		gPlanes.planeAt(i)->updateSurveillance(*update.surveillance);
+	}
+
+	// guards against new struct members should begin below.
+	if (updateSize >= offsetof(XPMPUpdate_t, kinematics) + sizeof(update.kinematics) &&
+		update.kinematics) {
+		gPlanes.updateKinematics(i, *update.kinematics);
+	}
+}
+
+/********************************************************************************
+ * POSTING
+ ********************************************************************************/
+
+namespace {
+	// the records present in a PostedUpdate
+	enum PostedField : uint32_t {
+		PostedField_Position =		1U << 0,
+		PostedField_Surfaces =		1U << 1,
+		PostedField_Surveillance =	1U << 2,
+		PostedField_Kinematics =	1U << 3,
+	};
+
+	/** PostedUpdate is a copy of a client's XPMPUpdate_t and the records it
+	 * points to.  Each record keeps the client's size (capped to ours), so
+	 * short records are still merged correctly when applied.
+	 */
+	struct PostedUpdate {
+		XPMPPlaneID				id;
+		uint32_t				fields;
+		XPMPPlanePosition_t		position;
+		XPMPPlaneSurfaces_t		surfaces;
+		XPMPPlaneSurveillance_t	surveillance;
+		XPMPPlaneKinematics_t	kinematics;
+	};
+
+	/** PostedNode is a single post - a create, a destroy, or a batch of
+	 * updates.
+	 */
+	struct PostedNode {
+		enum class Type {
+			Create,
+			Destroy,
+			Update,
+		};
+
+		PostedNode *	next;
+		Type			type;
+		XPMPPlaneID		id;			// create and destroy
+		bool			hasModelName;
+		string			modelName;
+		string			icao;
+		string			airline;
+		string			livery;
+		vector<PostedUpdate>	updates;
+
+		explicit PostedNode(Type inType) :
+			next(nullptr),
+			type(inType),
+			id(nullptr),
+			hasModelName(false)
+		{
+		}
+	};
+}
+
+// the posted nodes, newest first.
+static atomic<PostedNode *>	gPostedHead(nullptr);
+
+// drain()'s scratch space - the newest posted record of each kind for each
+// plane, by dense index.  Kinematics samples aren't collapsed: the
+// interpolation needs every one of them, so they're kept in posted order.
+struct PendingRecords {
+	const XPMPPlanePosition_t *		position;
+	const XPMPPlaneSurfaces_t *		surfaces;
+	const XPMPPlaneSurveillance_t *	surveillance;
+	bool							queued;
+};
+struct PendingSample {
+	XPMPPlaneStore::index_type		plane;
+	const XPMPPlaneKinematics_t *	kinematics;
+};
+static vector<PendingRecords>				gPending;
+static vector<XPMPPlaneStore::index_type>	gPendingPlanes;
+static vector<PendingSample>				gPendingSamples;
+
+static void
+push(PostedNode *node)
+{
+	node->next = gPostedHead.load(memory_order_relaxed);
+	while (!gPostedHead.compare_exchange_weak(node->next, node,
+	                                          memory_order_release,
+	                                          memory_order_relaxed)) {
+	}
+}
+
+/** takeAll removes every posted node from the stack, and returns them
+ * oldest first.
+ */
+static PostedNode *
+takeAll()
+{
+	PostedNode *node = gPostedHead.exchange(nullptr, memory_order_acquire);
+	PostedNode *ordered = nullptr;
+	while (node != nullptr) {
+		PostedNode *next = node->next;
+		node->next = ordered;
+		ordered = node;
+		node = next;
+	}
+	return ordered;
+}
+
+/** copyRecord copies the client's record, capping it's size to ours. */
+template<typename T>
+static void
+copyRecord(T &dst, const T &src)
+{
+	const size_t srcSize = min(src.size, sizeof(T));
+	memcpy(&dst, &src, srcSize);
+	dst.size = srcSize;
+}
+
+XPMPPlaneID
+PlaneIngest::postCreate(const char *modelName, const char *icao,
+                        const char *airline, const char *livery)
+{
+	auto *node = new PostedNode(PostedNode::Type::Create);
+	node->id = gPlanes.reserveID();
+	node->hasModelName = (modelName != nullptr);
+	if (modelName != nullptr) {
+		node->modelName = modelName;
+	}
+	node->icao = (icao != nullptr) ? icao : "";
+	node->airline = (airline != nullptr) ? airline : "";
+	node->livery = (livery != nullptr) ? livery : "";
+	const auto id = node->id;
+	push(node);
+	return id;
+}
+
+void
+PlaneIngest::postDestroy(XPMPPlaneID id)
+{
+	if (id == nullptr) {
+		return;
+	}
+	auto *node = new PostedNode(PostedNode::Type::Destroy);
+	node->id = id;
+	push(node);
+}
+
+void
+PlaneIngest::postUpdates(const XPMPUpdate_t *updates, size_t updateSize, size_t count)
+{
+	// our default structure is 4 pointers long.
+	if (updates == nullptr || count == 0 || updateSize < (sizeof(void *) * 4)) {
+		return;
+	}
+	const bool hasKinematics = updateSize >= offsetof(XPMPUpdate_t, kinematics) + sizeof(updates->kinematics);
+
+	auto *node = new PostedNode(PostedNode::Type::Update);
+	node->updates.reserve(count);
+	const auto *ptr = reinterpret_cast<const uint8_t *>(updates);
+	for (size_t idx = 0; idx < count; idx++) {
+		const auto *update = reinterpret_cast<const XPMPUpdate_t *>(ptr + (idx * updateSize));
+		if (update->plane == nullptr) {
+			continue;
+		}
+		PostedUpdate posted;
+		posted.id = update->plane;
+		posted.fields = 0;
+		if (update->position) {
+			copyRecord(posted.position, *update->position);
+			posted.fields |= PostedField_Position;
+		}
+		if (update->surfaces) {
+			copyRecord(posted.surfaces, *update->surfaces);
+			posted.fields |= PostedField_Surfaces;
+		}
+		if (update->surveillance) {
+			copyRecord(posted.surveillance, *update->surveillance);
+			posted.fields |= PostedField_Surveillance;
+		}
+		if (hasKinematics && update->kinematics) {
+			copyRecord(posted.kinematics, *update->kinematics);
+			posted.fields |= PostedField_Kinematics;
+		}
+		if (posted.fields != 0) {
+			node->updates.push_back(posted);
+		}
+	}
+	if (node->updates.empty()) {
+		delete node;
+		return;
+	}
+	push(node);
+}
+
+void
+PlaneIngest::drain()
+{
+	PostedNode *first = takeAll();
+	if (first == nullptr) {
+		return;
+	}
+
+	// the creates and destroys go first, in order.  An update posted before
+	// a plane's destroy dies with the plane, and one posted after it can't
+	// find it, so holding the updates back doesn't change what they do.
+	for (auto *node = first; node != nullptr; node = node->next) {
+		if (node->type == PostedNode::Type::Create) {
+			createPlane(node->id,
+			            node->hasModelName ? node->modelName.c_str() : nullptr,
+			            node->icao.c_str(),
+			            node->airline.c_str(),
+			            node->livery.c_str());
+		} else if (node->type == PostedNode::Type::Destroy) {
+			gPlanes.erase(node->id);
+		}
+	}
+
+	// now the dense indices are settled, find the newest of each record for
+	// every plane, and every kinematics sample...
+	gPending.assign(gPlanes.size(), PendingRecords{nullptr, nullptr, nullptr, false});
+	gPendingPlanes.clear();
+	gPendingSamples.clear();
+	for (auto *node = first; node != nullptr; node = node->next) {
+		if (node->type != PostedNode::Type::Update) {
+			continue;
+		}
+		for (const auto &update: node->updates) {
+			const auto i = gPlanes.indexOf(update.id);
+			if (i == XPMPPlaneStore::kInvalidIndex) {
+				continue;
+			}
+			auto &pending = gPending[i];
+			if (!pending.queued) {
+				pending.queued = true;
+				gPendingPlanes.push_back(i);
+			}
+			if (update.fields & PostedField_Position) {
+				pending.position = &update.position;
+			}
+			if (update.fields & PostedField_Surfaces) {
+				pending.surfaces = &update.surfaces;
+			}
+			if (update.fields & PostedField_Surveillance) {
+				pending.surveillance = &update.surveillance;
+			}
+			if (update.fields & PostedField_Kinematics) {
+				gPendingSamples.push_back(PendingSample{i, &update.kinematics});
+			}
+		}
+	}
+
+	// ... and apply them, in the order the planes were first updated.
+	for (const auto i: gPendingPlanes) {
+		const auto &pending = gPending[i];
+		XPMPUpdate_t update;
+		update.plane = gPlanes.idAt(i);
+		update.position = const_cast<XPMPPlanePosition_t *>(pending.position);
+		update.surfaces = const_cast<XPMPPlaneSurfaces_t *>(pending.surfaces);
+		update.surveillance = const_cast<XPMPPlaneSurveillance_t *>(pending.surveillance);
+		update.kinematics = nullptr;
+		applyUpdate(i, update, sizeof(update));
+	}
+
+	// the samples go in last, so each is tagged with the plane's newest
+	// surfaces, just as applyUpdate does.
+	for (const auto &sample: gPendingSamples) {
+		gPlanes.updateKinematics(sample.plane, *sample.kinematics);
+	}
+
+	while (first != nullptr) {
+		PostedNode *next = first->next;
+		delete first;
+		first = next;
+	}
+}
+
+void
+PlaneIngest::discard()
+{
+	PostedNode *node = takeAll();
+	while (node != nullptr) {
+		// the IDs of planes that were never created can be reissued.
+		if (node->type == PostedNode::Type::Create) {
+			gPlanes.release(node->id);
+		}
+		PostedNode *next = node->next;
+		delete node;
+		node = next;
+	}
+}
+
+bool
+PlaneIngest::hasPending()
+{
+	return gPostedHead.load(memory_order_relaxed) != nullptr;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef PLANEINGEST_H
+#define PLANEINGEST_H
+
+#include <cstddef>
+
+#include "XPMPMultiplayer.h"
+#include "XPMPPlaneStore.h"
+
+/** PlaneIngest applies the client's plane creates, destroys and updates to
+ * gPlanes.
+ *
+ * They can be applied directly from the main thread, or posted from any
+ * thread and applied in one batch at the start of the next frame by drain().
+ *
+ * Posting is lock-free - each post pushes a single node onto a shared stack
+ * with a compare and swap, and drain() takes the whole stack with a single
+ * exchange, so producers never wait on the main thread or each other.  Only
+ * the ID reservation for a posted create takes a (briefly held) lock.
+ */
+namespace PlaneIngest {
+	/** createPlane creates a new plane and inserts it into gPlanes under id.
+	 *
+	 * @param modelName the CSL model to use, or null to match one from the
+	 *   ICAO/airline/livery.  If the model isn't found, it's matched too.
+	 */
+	void	createPlane(XPMPPlaneID id, const char *modelName, const char *icao,
+	                    const char *airline, const char *livery);
+
+	/** applyUpdate applies a single client update to the plane at dense
+	 * index i.
+	 *
+	 * @param updateSize the size of the client's XPMPUpdate_t
+	 */
+	void	applyUpdate(XPMPPlaneStore::index_type i, const XPMPUpdate_t &update, size_t updateSize);
+
+	/** postCreate queues the creation of a plane and returns it's ID, which
+	 * can be used in posts straight away.  Safe to call from any thread.
+	 */
+	XPMPPlaneID	postCreate(const char *modelName, const char *icao,
+	                       const char *airline, const char *livery);
+
+	/** postDestroy queues the destruction of a plane.  Safe to call from any
+	 * thread.
+	 */
+	void	postDestroy(XPMPPlaneID id);
+
+	/** postUpdates copies a client's updates into the queue.  Safe to call
+	 * from any thread.
+	 */
+	void	postUpdates(const XPMPUpdate_t *updates, size_t updateSize, size_t count);
+
+	/** drain applies everything posted since the last drain.
+	 *
+	 * Creates and destroys are applied in the order they were posted.
+	 * Updates are coalesced per plane, with the latest post of each record
+	 * (position, surfaces and surveillance) winning, and are applied once
+	 * all the creates and destroys are done.  Every kinematics sample is
+	 * kept, and they're added in the order they were posted.
+	 *
+	 * Must only be called from the main thread.
+	 */
+	void	drain();
+
+	/** discard throws away everything posted since the last drain.  Must
+	 * only be called from the main thread.
+	 */
+	void	discard();
+
+	/** hasPending returns true if anything has been posted since the last
+	 * drain, in which case the renderer needs to run to drain it.  May be
+	 * called from any thread, but is only a hint off the main thread.
+	 */
+	bool	hasPending();
+}
+
+#endif //PLANEINGEST_H
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "PlaneKinematics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+constexpr double PlaneKinematics::kMaxExtrapolation;
+
+static const double	kEarthRadius = 6371008.8;
+static const double	kPi = 3.14159265358979323846;
+static const double	kDegToRad = kPi / 180.0;
+static const double	kRadToDeg = 180.0 / kPi;
+
+// the velocities in the sample, in degrees (and feet) per second.
+static void
+getRates(const XPMPPlaneKinematics_t &k, double &outLatRate, double &outLonRate, double &outElevationRate)
+{
+	outLatRate = (k.velocityNorth / kEarthRadius) * kRadToDeg;
+	const double cosLat = cos(k.lat * kDegToRad);
+	outLonRate = (cosLat > 1e-6) ? (k.velocityEast / (kEarthRadius * cosLat)) * kRadToDeg : 0.0;
+	outElevationRate = k.verticalSpeed / 60.0;
+}
+
+// returns b - a for angles in degrees (each within a single turn), the
+// short way round.
+static double
+angleDelta(double a, double b)
+{
+	double delta = b - a;
+	if (delta > 180.0) {
+		delta -= 360.0;
+	} else if (delta < -180.0) {
+		delta += 360.0;
+	}
+	return delta;
+}
+
+// the wraps leave values that are already in range untouched, so a plane
+// that isn't moving stays exactly where the client put it.
+static double
+wrapLongitude(double lon)
+{
+	if (lon > 180.0) {
+		return lon - 360.0;
+	}
+	if (lon < -180.0) {
+		return lon + 360.0;
+	}
+	return lon;
+}
+
+static float
+wrapHeading(double heading)
+{
+	if (heading >= 360.0) {
+		return static_cast<float>(heading - 360.0);
+	}
+	if (heading < 0.0) {
+		return static_cast<float>(heading + 360.0);
+	}
+	return static_cast<float>(heading);
+}
+
+// cubic Hermite interpolation from p0 (with slope m0) to p1 (with slope m1)
+// over an interval of length h, at s in [0, 1].
+static double
+hermite(double p0, double m0, double p1, double m1, double h, double s)
+{
+	const double s2 = s * s;
+	const double s3 = s2 * s;
+	return (2.0 * s3 - 3.0 * s2 + 1.0) * p0 +
+	       (s3 - 2.0 * s2 + s) * h * m0 +
+	       (-2.0 * s3 + 3.0 * s2) * p1 +
+	       (s3 - s2) * h * m1;
+}
+
+static float
+lerp(float a, float b, double s)
+{
+	return static_cast<float>(a + (b - a) * s);
+}
+
+PlaneKinematics::PlaneKinematics() :
+	mSamples{},
+	mFirst(0),
+	mCount(0)
+{
+}
+
+void
+PlaneKinematics::addSample(const XPMPPlaneKinematics_t &sample, const XPMPPlaneSurfaces_t &surfaces)
+{
+	Sample newSample;
+	memset(&newSample.kinematics, 0, sizeof(newSample.kinematics));
+	memcpy(&newSample.kinematics, &sample, min(sample.size, sizeof(newSample.kinematics)));
+	newSample.kinematics.size = sizeof(newSample.kinematics);
+	newSample.surfaces = surfaces;
+
+	if (mCount > 0) {
+		const double newest = sampleAt(mCount - 1).kinematics.timestamp;
+		if (newSample.kinematics.timestamp < newest) {
+			return;
+		}
+		if (newSample.kinematics.timestamp == newest) {
+			mSamples[(mFirst + mCount - 1) % kHistorySize] = newSample;
+			return;
+		}
+	}
+	if (mCount == kHistorySize) {
+		mFirst = (mFirst + 1) % kHistorySize;
+		mCount--;
+	}
+	mSamples[(mFirst + mCount) % kHistorySize] = newSample;
+	mCount++;
+}
+
+void
+PlaneKinematics::evaluate(double time, PlanePosition &ioPosition, XPMPPlaneSurfaces_t &ioSurfaces) const
+{
+	if (mCount == 0) {
+		return;
+	}
+
+	const auto lights = ioSurfaces.lights;
+	const Sample &oldest = sampleAt(0);
+	const Sample &newest = sampleAt(mCount - 1);
+
+	if (time <= oldest.kinematics.timestamp || mCount == 1 || time >= newest.kinematics.timestamp) {
+		// before the first sample we just hold it, after the last we
+		// extrapolate.
+		const Sample &held = (time <= oldest.kinematics.timestamp) ? oldest : newest;
+		const auto &k = held.kinematics;
+		const double dt = min(max(time - k.timestamp, 0.0), kMaxExtrapolation);
+		double latRate, lonRate, elevationRate;
+		getRates(k, latRate, lonRate, elevationRate);
+
+		ioPosition.lat = min(90.0, max(-90.0, k.lat + latRate * dt));
+		ioPosition.lon = wrapLongitude(k.lon + lonRate * dt);
+		ioPosition.elevation = k.elevation + elevationRate * dt;
+		ioPosition.pitch = k.pitch;
+		ioPosition.roll = k.roll;
+		ioPosition.heading = wrapHeading(k.heading + k.headingRate * dt);
+		ioSurfaces = held.surfaces;
+		ioSurfaces.lights = lights;
+		return;
+	}
+
+	// find the samples either side of time.
+	int n = 1;
+	while (sampleAt(n).kinematics.timestamp < time) {
+		n++;
+	}
+	const auto &a = sampleAt(n - 1).kinematics;
+	const auto &b = sampleAt(n).kinematics;
+	const double h = b.timestamp - a.timestamp;
+	const double s = (time - a.timestamp) / h;
+
+	double aLatRate, aLonRate, aElevationRate;
+	double bLatRate, bLonRate, bElevationRate;
+	getRates(a, aLatRate, aLonRate, aElevationRate);
+	getRates(b, bLatRate, bLonRate, bElevationRate);
+
+	// work in longitudes relative to a, so the antimeridian isn't a problem.
+	const double bLon = angleDelta(a.lon, b.lon);
+	ioPosition.lat = hermite(a.lat, aLatRate, b.lat, bLatRate, h, s);
+	ioPosition.lon = wrapLongitude(a.lon + hermite(0.0, aLonRate, bLon, bLonRate, h, s));
+	ioPosition.elevation = hermite(a.elevation, aElevationRate, b.elevation, bElevationRate, h, s);
+	ioPosition.pitch = lerp(a.pitch, b.pitch, s);
+	ioPosition.roll = lerp(a.roll, b.roll, s);
+	ioPosition.heading = wrapHeading(a.heading + angleDelta(a.heading, b.heading) * s);
+
+	const auto &aSurfaces = sampleAt(n - 1).surfaces;
+	const auto &bSurfaces = sampleAt(n).surfaces;
+	ioSurfaces.gearPosition = lerp(aSurfaces.gearPosition, bSurfaces.gearPosition, s);
+	ioSurfaces.flapRatio = lerp(aSurfaces.flapRatio, bSurfaces.flapRatio, s);
+	ioSurfaces.spoilerRatio = lerp(aSurfaces.spoilerRatio, bSurfaces.spoilerRatio, s);
+	ioSurfaces.speedBrakeRatio = lerp(aSurfaces.speedBrakeRatio, bSurfaces.speedBrakeRatio, s);
+	ioSurfaces.slatRatio = lerp(aSurfaces.slatRatio, bSurfaces.slatRatio, s);
+	ioSurfaces.wingSweep = lerp(aSurfaces.wingSweep, bSurfaces.wingSweep, s);
+	ioSurfaces.thrust = lerp(aSurfaces.thrust, bSurfaces.thrust, s);
+	ioSurfaces.yokePitch = lerp(aSurfaces.yokePitch, bSurfaces.yokePitch, s);
+	ioSurfaces.yokeHeading = lerp(aSurfaces.yokeHeading, bSurfaces.yokeHeading, s);
+	ioSurfaces.yokeRoll = lerp(aSurfaces.yokeRoll, bSurfaces.yokeRoll, s);
+	ioSurfaces.lights = lights;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef PLANEKINEMATICS_H
+#define PLANEKINEMATICS_H
+
+#include "XPMPMultiplayer.h"
+#include "XPMPPlaneStore.h"
+
+/** PlaneKinematics keeps the most recent position samples for a plane fed
+ * with XPMPPlaneKinematics_t, and works out where the plane is at any given
+ * time from them.
+ *
+ * Between two samples, the position follows a cubic Hermite curve through
+ * both samples' positions and velocities, so it's continuous and smooth;
+ * after the newest sample, it's extrapolated from it's velocity for up to
+ * kMaxExtrapolation seconds, then held.
+ */
+class PlaneKinematics {
+public:
+	/** how long (in seconds) to extrapolate past the newest sample for */
+	static constexpr double kMaxExtrapolation = 2.0;
+
+	PlaneKinematics();
+
+	/** addSample records a new sample, along with the plane's surfaces at the
+	 * time.  Samples older than the newest one held are ignored, and a sample
+	 * with the same timestamp as the newest replaces it.
+	 */
+	void	addSample(const XPMPPlaneKinematics_t &sample, const XPMPPlaneSurfaces_t &surfaces);
+
+	/** evaluate works out the plane's position, attitude and surfaces at the
+	 * given time.
+	 *
+	 * This only performs calculations and is safe to call from the
+	 * renderer's worker threads.
+	 *
+	 * @param time the time to evaluate at, on the XPLMGetElapsedTime() clock
+	 * @param ioPosition the plane's position.  The position and attitude are
+	 *   updated, the other members are left alone.
+	 * @param ioSurfaces the plane's surfaces.  The continuous surfaces are
+	 *   updated, the lights are left alone.
+	 */
+	void	evaluate(double time, PlanePosition &ioPosition, XPMPPlaneSurfaces_t &ioSurfaces) const;
+
+private:
+	static const int	kHistorySize = 4;
+
+	struct Sample {
+		XPMPPlaneKinematics_t	kinematics;
+		XPMPPlaneSurfaces_t		surfaces;
+	};
+
+	Sample	mSamples[kHistorySize];		// a ring buffer, oldest first from mFirst
+	int		mFirst;
+	int		mCount;
+
+	const Sample &	sampleAt(int n) const { return mSamples[(mFirst + n) % kHistorySize]; }
+};
+
+#endif //PLANEKINEMATICS_H
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "RenderStats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <XPLMDataAccess.h>
+
+using namespace std;
+
+PhaseTimer::PhaseTimer() :
+	mSamples{},
+	mNextSample(0),
+	mSampleCount(0),
+	mFrameMs(0.0),
+	mFrameHasSamples(false),
+	mStats{}
+{
+}
+
+void
+PhaseTimer::add(double ms)
+{
+	mFrameMs += ms;
+	mFrameHasSamples = true;
+}
+
+void
+PhaseTimer::commitFrame()
+{
+	if (!mFrameHasSamples) {
+		return;
+	}
+	mSamples[mNextSample] = static_cast<float>(mFrameMs);
+	mNextSample = (mNextSample + 1) % kWindowSize;
+	if (mSampleCount < kWindowSize) {
+		mSampleCount++;
+	}
+	mStats.lastMs = static_cast<float>(mFrameMs);
+	mFrameMs = 0.0;
+	mFrameHasSamples = false;
+
+	float sorted[kWindowSize];
+	copy(mSamples, mSamples + mSampleCount, sorted);
+	const size_t p99Index = (mSampleCount * 99) / 100;
+	nth_element(sorted, sorted + p99Index, sorted + mSampleCount);
+	mStats.p99Ms = sorted[p99Index];
+
+	double total = 0.0;
+	float minMs = mSamples[0];
+	for (size_t i = 0; i < mSampleCount; i++) {
+		total += mSamples[i];
+		minMs = min(minMs, mSamples[i]);
+	}
+	mStats.minMs = minMs;
+	mStats.avgMs = static_cast<float>(total / mSampleCount);
+}
+
+static PhaseTimer			gPhaseTimers[static_cast<int>(RenderPhase::Count)];
+static int					gPlaneCount = 0;
+static int					gUpdatedCount = 0;
+static int					gFullUpdateCount = 0;
+static int					gSuspendedCount = 0;
+static int					gInstanceBacklog = 0;
+static int					gMatchCacheHits = 0;
+static int					gMatchCacheMisses = 0;
+static vector<XPLMDataRef>	gStatsDataRefs;
+
+// the dataref names for each phase, in RenderPhase order.
+static const char *			kPhaseNames[] = {
+	"prep_lists",
+	"world_to_local",
+	"prepare",
+	"terrain_probe",
+	"instance_update",
+	"tcas",
+	"map_icons",
+	"map_labels",
+	"obj8_load",
+	"kinematics",
+};
+static_assert(sizeof(kPhaseNames) / sizeof(kPhaseNames[0]) == static_cast<size_t>(RenderPhase::Count),
+	"kPhaseNames must have a name for every RenderPhase");
+
+// refcons for the float datarefs are the address of the value in the
+// PhaseTimer's stats, which don't move.
+static float
+readStatFloat(void *inRefcon)
+{
+	return *reinterpret_cast<const float *>(inRefcon);
+}
+
+static int
+readStatInt(void *inRefcon)
+{
+	return *reinterpret_cast<const int *>(inRefcon);
+}
+
+static void
+registerFloat(const string &name, const float *value)
+{
+	gStatsDataRefs.push_back(XPLMRegisterDataAccessor(name.c_str(),
+		xplmType_Float,
+		false,	// read-only
+		nullptr, nullptr,	// int
+		readStatFloat, nullptr,	// float
+		nullptr, nullptr,	// double
+		nullptr, nullptr,	// int array
+		nullptr, nullptr,	// float array
+		nullptr, nullptr,	// data
+		const_cast<float *>(value), nullptr));
+}
+
+static void
+registerInt(const string &name, const int *value)
+{
+	gStatsDataRefs.push_back(XPLMRegisterDataAccessor(name.c_str(),
+		xplmType_Int,
+		false,	// read-only
+		readStatInt, nullptr,	// int
+		nullptr, nullptr,	// float
+		nullptr, nullptr,	// double
+		nullptr, nullptr,	// int array
+		nullptr, nullptr,	// float array
+		nullptr, nullptr,	// data
+		const_cast<int *>(value), nullptr));
+}
+
+void
+RenderStats::Init()
+{
+	if (!gStatsDataRefs.empty()) {
+		return;
+	}
+	const string prefix = "libxplanemp/stats/";
+	for (int i = 0; i < static_cast<int>(RenderPhase::Count); i++) {
+		const auto &stats = gPhaseTimers[i].getStats();
+		const string base = prefix + kPhaseNames[i];
+		registerFloat(base + "/last_ms", &stats.lastMs);
+		registerFloat(base + "/min_ms", &stats.minMs);
+		registerFloat(base + "/avg_ms", &stats.avgMs);
+		registerFloat(base + "/p99_ms", &stats.p99Ms);
+	}
+	registerInt(prefix + "planes", &gPlaneCount);
+	registerInt(prefix + "planes_updated", &gUpdatedCount);
+	registerInt(prefix + "planes_full_update", &gFullUpdateCount);
+	registerInt(prefix + "planes_suspended", &gSuspendedCount);
+	registerInt(prefix + "instance_backlog", &gInstanceBacklog);
+	registerInt(prefix + "match_cache_hits", &gMatchCacheHits);
+	registerInt(prefix + "match_cache_misses", &gMatchCacheMisses);
+}
+
+void
+RenderStats::Cleanup()
+{
+	for (auto dr: gStatsDataRefs) {
+		XPLMUnregisterDataAccessor(dr);
+	}
+	gStatsDataRefs.clear();
+}
+
+void
+RenderStats::commitFrame()
+{
+	for (auto &timer: gPhaseTimers) {
+		timer.commitFrame();
+	}
+}
+
+void
+RenderStats::add(RenderPhase phase, double ms)
+{
+	gPhaseTimers[static_cast<int>(phase)].add(ms);
+}
+
+double
+RenderStats::getFrameMs(RenderPhase phase)
+{
+	return gPhaseTimers[static_cast<int>(phase)].getFrameMs();
+}
+
+void
+RenderStats::setCounts(int planeCount, int updatedCount, int fullUpdateCount, int suspendedCount, int instanceBacklog)
+{
+	gPlaneCount = planeCount;
+	gUpdatedCount = updatedCount;
+	gFullUpdateCount = fullUpdateCount;
+	gSuspendedCount = suspendedCount;
+	gInstanceBacklog = instanceBacklog;
+}
+
+void
+RenderStats::countMatch(bool cacheHit)
+{
+	if (cacheHit) {
+		gMatchCacheHits++;
+	} else {
+		gMatchCacheMisses++;
+	}
+}
+
+void
+RenderStats::getStats(XPMPRenderStats_t &outStats)
+{
+	XPMPRenderStats_t stats;
+	stats.size = sizeof(stats);
+	stats.prepLists = gPhaseTimers[static_cast<int>(RenderPhase::PrepLists)].getStats();
+	stats.worldToLocal = gPhaseTimers[static_cast<int>(RenderPhase::WorldToLocal)].getStats();
+	stats.prepare = gPhaseTimers[static_cast<int>(RenderPhase::Prepare)].getStats();
+	stats.terrainProbe = gPhaseTimers[static_cast<int>(RenderPhase::TerrainProbe)].getStats();
+	stats.instanceUpdate = gPhaseTimers[static_cast<int>(RenderPhase::InstanceUpdate)].getStats();
+	stats.tcas = gPhaseTimers[static_cast<int>(RenderPhase::TCAS)].getStats();
+	stats.mapIcons = gPhaseTimers[static_cast<int>(RenderPhase::MapIcons)].getStats();
+	stats.mapLabels = gPhaseTimers[static_cast<int>(RenderPhase::MapLabels)].getStats();
+	stats.obj8Load = gPhaseTimers[static_cast<int>(RenderPhase::Obj8Load)].getStats();
+	stats.kinematics = gPhaseTimers[static_cast<int>(RenderPhase::Kinematics)].getStats();
+	stats.planeCount = gPlaneCount;
+	stats.updatedCount = gUpdatedCount;
+	stats.fullUpdateCount = gFullUpdateCount;
+	stats.suspendedCount = gSuspendedCount;
+	stats.instanceBacklog = gInstanceBacklog;
+	stats.matchCacheHits = gMatchCacheHits;
+	stats.matchCacheMisses = gMatchCacheMisses;
+
+	// only copy as much as the caller knows about.
+	const size_t copySize = min(outStats.size, sizeof(stats));
+	memcpy(&outStats, &stats, copySize);
+	outStats.size = copySize;
+}
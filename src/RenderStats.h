@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <chrono>
+#include <cstddef>
+
+#include "XPMPMultiplayer.h"
+
+/** the phases of the renderer we keep timing statistics for */
+enum class RenderPhase : int {
+	PrepLists = 0,
+	WorldToLocal,
+	Prepare,
+	TerrainProbe,
+	InstanceUpdate,
+	TCAS,
+	MapIcons,
+	MapLabels,
+	Obj8Load,
+	Kinematics,
+	Count
+};
+
+/** PhaseTimer keeps the rolling statistics for a single RenderPhase.
+ *
+ * Time is accumulated over a frame with add(), and folded into the rolling
+ * window by commitFrame().  Frames in which the phase didn't run at all are
+ * not counted.
+ */
+class PhaseTimer {
+public:
+	static const size_t kWindowSize = 256;
+
+	PhaseTimer();
+
+	void	add(double ms);
+	void	commitFrame();
+	double	getFrameMs() const { return mFrameMs; }
+
+	const XPMPPhaseStats_t &	getStats() const { return mStats; }
+
+private:
+	float				mSamples[kWindowSize];
+	size_t				mNextSample;
+	size_t				mSampleCount;
+
+	double				mFrameMs;
+	bool				mFrameHasSamples;
+
+	XPMPPhaseStats_t	mStats;
+};
+
+/** RenderStats collects the renderer's timing instrumentation and publishes
+ * it via datarefs and XPMPGetRenderStats().
+ *
+ * All of these methods must only be called from the main thread.
+ */
+namespace RenderStats {
+	/** registers the statistics datarefs */
+	void	Init();
+
+	/** unregisters the statistics datarefs */
+	void	Cleanup();
+
+	/** folds the time accumulated since the last call into the rolling
+	 * windows.  Called once per frame by the renderer.
+	 */
+	void	commitFrame();
+
+	/** adds time to the current frame for the given phase */
+	void	add(RenderPhase phase, double ms);
+
+	/** returns the time accumulated so far this frame for the given phase */
+	double	getFrameMs(RenderPhase phase);
+
+	/** records the plane counts for the most recent frame */
+	void	setCounts(int planeCount, int updatedCount, int fullUpdateCount, int suspendedCount, int instanceBacklog);
+
+	/** counts a model match, and whether it was answered from the cache */
+	void	countMatch(bool cacheHit);
+
+	void	getStats(XPMPRenderStats_t &outStats);
+}
+
+/** ScopedPhaseTimer adds the time from it's construction to it's
+ * destruction to a RenderPhase.
+ */
+class ScopedPhaseTimer {
+public:
+	explicit ScopedPhaseTimer(RenderPhase phase) :
+		mPhase(phase),
+		mStart(std::chrono::steady_clock::now())
+	{
+	}
+
+	ScopedPhaseTimer(const ScopedPhaseTimer &copySrc) = delete;
+
+	~ScopedPhaseTimer()
+	{
+		const std::chrono::duration<double, std::milli> elapsed =
+			std::chrono::steady_clock::now() - mStart;
+		RenderStats::add(mPhase, elapsed.count());
+	}
+
+private:
+	RenderPhase								mPhase;
+	std::chrono::steady_clock::time_point	mStart;
+};
+
+#endif //RENDERSTATS_H
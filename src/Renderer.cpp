@@ -24,54 +24,241 @@
 
 #include "Renderer.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <utility>
 #include <XPLMUtilities.h>
 #include <XPLMDisplay.h>
 #include <XPLMProcessing.h>
 #include <XPLMCamera.h>
+#include <XPLMGraphics.h>
 
 #include "XPMPMultiplayerVars.h"
+#include "CullKernel.h"
+#include "FrameContext.h"
+#include "LocalProjection.h"
 #include "MapRendering.h"
+#include "PlaneIngest.h"
+#include "PlaneKinematics.h"
+#include "RenderStats.h"
 #include "TCASHack.h"
+#include "TerrainCache.h"
+#include "UpdateScheduler.h"
+#include "WorkerPool.h"
+#include "XUtils.h"
+#include "obj8/Obj8Attachment.h"
 
 using namespace std;
 
-XPLMDataRef gVisDataRef = nullptr;    // Current air visiblity for culling.
 XPLMProbeRef gTerrainProbe = nullptr;
 
+// the number of planes handed to a worker thread at a time
+static const size_t kPlanesPerTask = 64;
+
+static unique_ptr<WorkerPool>   gWorkerPool;
+static UpdateScheduler          gScheduler;
+static vector<XPMPPlaneStore::index_type>   gFrameSelection;     // planes being updated this frame
+static vector<uint8_t>          gFrameFullUpdate;    // per gFrameSelection entry: non-zero if it needs the full pipeline
+static vector<PlanePosition>    gKinematicPositions; // per plane: this frame's position from it's kinematics
+static vector<XPMPPlaneSurfaces_t>  gKinematicSurfaces; // per plane: this frame's surfaces from it's kinematics
+static vector<float>            gProbeDistances;     // scratch for limitTerrainProbes
+static vector<pair<float, int>> gCreationRequests;  // scratch for limitInstanceCreations - distance squared and count
+
+// the scene state at the last update.  If any of these change, every plane
+// needs a full update.
+static LocalProjection  gLocalProjection;
+static bool     gLastSurfaceClamping = false;
+
+// discrepancies smaller than this (in meters) aren't worth reporting
+static const double kProjectionTolerance = 0.5;
+static double   gProjectionWorstError = 0.0;
+
 void
 Renderer_Init()
 {
     // SETUP - mostly just fetch datarefs.
-    gVisDataRef = XPLMFindDataRef("sim/graphics/view/visibility_effective_m");
-    if (gVisDataRef == nullptr) {
-        gVisDataRef = XPLMFindDataRef("sim/weather/visibility_effective_m");
-    }
-    if (gVisDataRef == nullptr) {
-        XPLMDebugString(
-            "WARNING: Default renderer could not find effective visibility in the sim.\n");
-    }
-
     gTerrainProbe = XPLMCreateProbe(xplm_ProbeY);
     CullInfo::init();
+    FrameContext::init();
     TCAS::Init();
 
-#if RENDERER_STATS
-    XPLMRegisterDataAccessor("hack/renderer/planes", xplmType_Int, 0, GetRendererStat, NULL,
-                             NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-                             &gTotPlanes, NULL);
-    XPLMRegisterDataAccessor("hack/renderer/navlites", xplmType_Int, 0, GetRendererStat, NULL,
-                             NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-                             &gNavPlanes, NULL);
-    XPLMRegisterDataAccessor("hack/renderer/objects", xplmType_Int, 0, GetRendererStat, NULL,
-                             NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-                             &gOBJPlanes, NULL);
-    XPLMRegisterDataAccessor("hack/renderer/acfs", xplmType_Int, 0, GetRendererStat, NULL,
-                             NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-                             &gACFPlanes, NULL);
-#endif
+    if (!gWorkerPool) {
+        gWorkerPool = make_unique<WorkerPool>();
+        XPLMDump() << XPMP_CLIENT_NAME ": Renderer using "
+                   << static_cast<int>(gWorkerPool->getConcurrency())
+                   << " threads, "
+                   << CullKernel::getIsaName(CullKernel::getActiveIsa())
+                   << " cull kernel\n";
+    }
+
+    RenderStats::Init();
+}
+
+void
+Renderer_Cleanup()
+{
+    RenderStats::Cleanup();
+    gWorkerPool.reset();
+    gFrameSelection.clear();
+    gFrameSelection.shrink_to_fit();
+    gFrameFullUpdate.clear();
+    gFrameFullUpdate.shrink_to_fit();
+    gKinematicPositions.clear();
+    gKinematicPositions.shrink_to_fit();
+    gKinematicSurfaces.clear();
+    gKinematicSurfaces.shrink_to_fit();
+    gProbeDistances.clear();
+    gProbeDistances.shrink_to_fit();
+    gCreationRequests.clear();
+    gCreationRequests.shrink_to_fit();
+    gTerrainCache.invalidate();
+}
+
+/** advanceKinematics moves the planes fed with kinematics to where they
+ * should be drawn this frame.
+ */
+static void
+advanceKinematics(const FrameContext &frame)
+{
+    if (gPlanes.kinematicsCount() == 0) {
+        return;
+    }
+    ScopedPhaseTimer timer(RenderPhase::Kinematics);
+    const double time = frame.elapsedTime - frame.config.interpolationDelay;
+
+    // the evaluation is done on the worker pool, but the store (and it's
+    // spatial index) can only be updated from here.
+    const size_t planeCount = gPlanes.size();
+    gKinematicPositions.resize(planeCount);
+    gKinematicSurfaces.resize(planeCount);
+    auto evaluateRange = [time](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const auto *kinematics = gPlanes.kinematicsAt(static_cast<XPMPPlaneStore::index_type>(i));
+            if (kinematics == nullptr) {
+                continue;
+            }
+            gKinematicPositions[i] = gPlanes.positionAt(static_cast<XPMPPlaneStore::index_type>(i));
+            gKinematicSurfaces[i] = gPlanes.surfacesAt(static_cast<XPMPPlaneStore::index_type>(i));
+            kinematics->evaluate(time, gKinematicPositions[i], gKinematicSurfaces[i]);
+        }
+    };
+    if (gWorkerPool) {
+        gWorkerPool->parallelFor(planeCount, kPlanesPerTask, evaluateRange);
+    } else {
+        evaluateRange(0, planeCount);
+    }
+    for (XPMPPlaneStore::index_type i = 0; i < planeCount; i++) {
+        if (gPlanes.kinematicsAt(i) != nullptr) {
+            gPlanes.setPosition(i, gKinematicPositions[i]);
+            gPlanes.setSurfaces(i, gKinematicSurfaces[i]);
+        }
+    }
+}
+
+/** validateLocalPositions checks the local positions calculated this frame
+ * against XPLMWorldToLocal, and logs whenever the error is worse than we've
+ * seen since the reference point last moved.
+ */
+static void
+validateLocalPositions(bool sceneDirty)
+{
+    for (size_t j = 0; j < gFrameSelection.size(); j++) {
+        const auto i = gFrameSelection[j];
+        if (!sceneDirty && !(gPlanes.flagsAt(i) & PlaneFlag_PositionDirty)) {
+            continue;
+        }
+        const auto &position = gPlanes.positionAt(i);
+        double simX, simY, simZ;
+        XPLMWorldToLocal(position.lat, position.lon, position.elevation * kFtToMeters, &simX, &simY, &simZ);
+        double x, y, z;
+        gPlanes.planeAt(i)->getLocalPosition(x, y, z);
+
+        const double error = sqrt((x - simX) * (x - simX) + (y - simY) * (y - simY) + (z - simZ) * (z - simZ));
+        if (error > kProjectionTolerance && error > gProjectionWorstError) {
+            gProjectionWorstError = error;
+            char buf[256];
+            snprintf(buf, sizeof(buf),
+                     XPMP_CLIENT_NAME ": local projection differs from XPLMWorldToLocal by %.3fm at %.6f,%.6f (%.0fft)\n",
+                     error, position.lat, position.lon, position.elevation);
+            XPLMDebugString(buf);
+        }
+    }
 }
 
-double Render_FullPlaneDistance = 0.0;
+/** limitTerrainProbes restricts this frame's terrain probes to the closest
+ * planes that need one, if there are more than the budget allows.
+ */
+static void
+limitTerrainProbes(const FrameContext &frame, bool sceneDirty)
+{
+    const int budget = frame.config.terrainProbeBudget;
+    if (budget <= 0 || !frame.config.enableSurfaceClamping) {
+        return;
+    }
+    gProbeDistances.clear();
+    for (size_t j = 0; j < gFrameSelection.size(); j++) {
+        const auto i = gFrameSelection[j];
+        const auto *plane = gPlanes.planeAt(i);
+        if (!gFrameFullUpdate[j] || (plane->isSuspended() && !sceneDirty)) {
+            continue;
+        }
+        float distanceSqr;
+        if (plane->needsTerrainProbe(frame, gPlanes.positionAt(i), distanceSqr)) {
+            gProbeDistances.push_back(distanceSqr);
+        }
+    }
+    if (gProbeDistances.size() <= static_cast<size_t>(budget)) {
+        return;
+    }
+    auto cutoff = gProbeDistances.begin() + (budget - 1);
+    nth_element(gProbeDistances.begin(), cutoff, gProbeDistances.end());
+    gTerrainCache.setProbeCutoff(*cutoff);
+}
+
+/** limitInstanceCreations restricts this frame's new instances to the
+ * closest planes that need them, if there are more than the budget allows.
+ */
+static void
+limitInstanceCreations(const FrameContext &frame, bool sceneDirty)
+{
+    const int budget = frame.config.instanceCreationBudget;
+    if (budget <= 0) {
+        return;
+    }
+    gCreationRequests.clear();
+    int total = 0;
+    for (size_t j = 0; j < gFrameSelection.size(); j++) {
+        const auto i = gFrameSelection[j];
+        const auto *plane = gPlanes.planeAt(i);
+        if (!gFrameFullUpdate[j] || (plane->isSuspended() && !sceneDirty)) {
+            continue;
+        }
+        float distanceSqr;
+        const int count = plane->countNewInstances(distanceSqr);
+        if (count > 0) {
+            gCreationRequests.emplace_back(distanceSqr, count);
+            total += count;
+        }
+    }
+    if (total <= budget) {
+        return;
+    }
+    // take the closest planes until the next one won't fit.
+    sort(gCreationRequests.begin(), gCreationRequests.end());
+    float cutoff = -1.0f;
+    int used = 0;
+    for (const auto &request: gCreationRequests) {
+        if (used + request.second > budget) {
+            break;
+        }
+        used += request.second;
+        cutoff = request.first;
+    }
+    Obj8Attachment::setCreationCutoff(cutoff);
+}
 
 void
 Render_PrepLists()
@@ -84,25 +271,185 @@ Render_PrepLists()
     }
     rendLastCycle = thisCycle;
 
+    // fold last frame's timings (including those from the draw and map
+    // callbacks which ran after we did) into the statistics.
+    RenderStats::commitFrame();
+    ScopedPhaseTimer prepListsTimer(RenderPhase::PrepLists);
+
     TCAS::cleanFrame();
 
+    // apply everything the client has posted from other threads since the
+    // last frame in one go.
+    PlaneIngest::drain();
+
+    Obj8Attachment::trimIdleInstances(XPLMGetElapsedTime());
+
     if (gPlanes.empty()) {
+        RenderStats::setCounts(0, 0, 0, 0, 0);
         return;
     }
 
-    // get our view information
-    CullInfo gl_camera;
-    XPLMCameraPosition_t x_camera;
-    XPLMReadCameraPosition(&x_camera);    // only for zoom!
+    // snapshot everything the per-plane update needs from the sim - nothing
+    // below reads a dataref per plane.
+    const FrameContext frameContext;
 
-    // Culling - read the camera pos and figure out what's visible.
-    double maxDist = XPLMGetDataf(gVisDataRef);
-    Render_FullPlaneDistance = x_camera.zoom * (5280.0 / 3.2) *
-                               gConfiguration.maxFullAircraftRenderingDistance;    // Only draw planes fully within 3 miles.
+    advanceKinematics(frameContext);
 
-    for (auto &planePair: gPlanes) {
-        planePair.second->doInstanceUpdate(gl_camera);
+    // if the local coordinate origin has moved, or the clamping has been
+    // toggled, every plane has to be placed again.
+    bool sceneDirty = gLocalProjection.setReference(frameContext.latRef, frameContext.lonRef);
+    if (sceneDirty) {
+        gProjectionWorstError = 0.0;
+    }
+    gTerrainCache.beginFrame(frameContext.elapsedTime, sceneDirty, frameContext.config.terrainProbeBudget);
+    Obj8Attachment::setCreationBudget(frameContext.config.instanceCreationBudget);
+    Obj8Attachment::processLoadQueue(frameContext.config.maxObjectLoadsInFlight);
+    Obj8Attachment::evictUnusedObjects(frameContext.config.maxLoadedObjects);
+    sceneDirty = sceneDirty || (frameContext.config.enableSurfaceClamping != gLastSurfaceClamping);
+    gLastSurfaceClamping = frameContext.config.enableSurfaceClamping;
+
+    const auto startTime = chrono::steady_clock::now();
+
+    gScheduler.beginFrame(gPlanes, frameContext.fullPlaneDistance, frameContext.config.updateBudgetMs, gFrameSelection);
+    const uint32_t frame = gScheduler.getFrame();
+
+    // The update is done in phases - the XPLM can only be used from this
+    // thread, so the pure calculations (the coordinate conversion and the
+    // instance preparation) are farmed out to the worker pool, and only the
+    // final push into the simulator is done here.
+    //
+    // Planes that haven't changed since their last update only have their
+    // distance dependent state refreshed for the new camera position - their
+    // instances are left exactly where they are.
+    gFrameFullUpdate.resize(gFrameSelection.size());
+    auto localRange = [sceneDirty](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; j++) {
+            const auto i = gFrameSelection[j];
+            const auto flags = gPlanes.flagsAt(i);
+            auto *plane = gPlanes.planeAt(i);
+            if (sceneDirty || (flags & PlaneFlag_PositionDirty)) {
+                plane->updateLocalPosition(gLocalProjection, gPlanes.positionAt(i));
+            }
+            gFrameFullUpdate[j] = (sceneDirty || (flags & PlaneFlag_DirtyMask) || plane->needsFullUpdate()) ? 1 : 0;
+        }
+    };
+    {
+        ScopedPhaseTimer timer(RenderPhase::WorldToLocal);
+        if (gWorkerPool) {
+            gWorkerPool->parallelFor(gFrameSelection.size(), kPlanesPerTask, localRange);
+        } else {
+            localRange(0, gFrameSelection.size());
+        }
+    }
+    if (frameContext.config.debug.localProjection) {
+        validateLocalPositions(sceneDirty);
     }
+
+    auto prepareRange = [&frameContext](size_t begin, size_t end) {
+        // the distances, visibility and LOD are classified a block at a time
+        // by the CullKernel, then each plane is refreshed or prepared.
+        float x[kPlanesPerTask], y[kPlanesPerTask], z[kPlanesPerTask];
+        float radius[kPlanesPerTask];
+        float distanceSqr[kPlanesPerTask];
+        uint8_t visibility[kPlanesPerTask], lod[kPlanesPerTask];
+        for (size_t blockBegin = begin; blockBegin < end; blockBegin += kPlanesPerTask) {
+            const size_t blockSize = min(kPlanesPerTask, end - blockBegin);
+            for (size_t k = 0; k < blockSize; k++) {
+                const auto i = gFrameSelection[blockBegin + k];
+                const auto *plane = gPlanes.planeAt(i);
+                plane->getDrawPosition(gPlanes.positionAt(i), !gFrameFullUpdate[blockBegin + k], x[k], y[k], z[k]);
+                radius[k] = plane->getCullRadius();
+            }
+            CullKernel::run(frameContext.cullParams, x, y, z, radius, blockSize, distanceSqr, visibility, lod);
+
+            for (size_t k = 0; k < blockSize; k++) {
+                const size_t j = blockBegin + k;
+                const auto i = gFrameSelection[j];
+                auto *plane = gPlanes.planeAt(i);
+                CullResult cull{distanceSqr[k], visibility[k], lod[k]};
+                const bool resumed = plane->updateSuspension(frameContext, cull);
+                if (!gFrameFullUpdate[j]) {
+                    const bool needsPrepare = plane->refreshInstanceUpdate(frameContext, cull, gPlanes.positionAt(i));
+                    if (!needsPrepare && !resumed) {
+                        continue;
+                    }
+                    gFrameFullUpdate[j] = 1;
+                    // it's going to be placed afresh, so classify the new position.
+                    float px, py, pz;
+                    plane->getDrawPosition(gPlanes.positionAt(i), false, px, py, pz);
+                    CullKernel::run(frameContext.cullParams, &px, &py, &pz, &radius[k], 1,
+                                    &cull.distanceSqr, &cull.visibility, &cull.lod);
+                }
+                plane->prepareInstanceUpdate(frameContext, cull, gPlanes.positionAt(i), gPlanes.surfacesAt(i));
+            }
+        }
+    };
+    {
+        ScopedPhaseTimer timer(RenderPhase::Prepare);
+        if (gWorkerPool) {
+            gWorkerPool->parallelFor(gFrameSelection.size(), kPlanesPerTask, prepareRange);
+        } else {
+            prepareRange(0, gFrameSelection.size());
+        }
+    }
+
+    limitTerrainProbes(frameContext, sceneDirty);
+    limitInstanceCreations(frameContext, sceneDirty);
+
+    // the terrain probes are timed individually by the CSL - take them back
+    // out so the instance update time is just that.
+    const double probeMsBefore = RenderStats::getFrameMs(RenderPhase::TerrainProbe);
+    const auto applyStartTime = chrono::steady_clock::now();
+    int fullUpdateCount = 0;
+    int suspendedCount = 0;
+    int instanceBacklog = 0;
+    for (size_t j = 0; j < gFrameSelection.size(); j++) {
+        const auto i = gFrameSelection[j];
+        auto *plane = gPlanes.planeAt(i);
+        // if the scene has moved, suspended planes are placed anyway, so the
+        // instances left behind stay where they are meant to be.
+        if (plane->isSuspended() && !sceneDirty) {
+            // the dirty flags are left alone, so the plane is brought up to
+            // date when it's resumed.
+            plane->suspendInstanceUpdate(frameContext);
+            plane->publishState(gPlanes.distanceSqrAt(i), gPlanes.flagsAt(i));
+            suspendedCount++;
+        } else if (gFrameFullUpdate[j]) {
+            plane->applyInstanceUpdate(frameContext, gPlanes.positionAt(i), gPlanes.distanceSqrAt(i), gPlanes.flagsAt(i));
+            gPlanes.flagsAt(i) &= ~PlaneFlag_DirtyMask;
+            fullUpdateCount++;
+            if (plane->isWaitingForInstances()) {
+                instanceBacklog++;
+            }
+        } else {
+            plane->publishState(gPlanes.distanceSqrAt(i), gPlanes.flagsAt(i));
+        }
+        gPlanes.lastUpdateAt(i) = frame;
+    }
+    const chrono::duration<double, milli> applyElapsed = chrono::steady_clock::now() - applyStartTime;
+    RenderStats::add(RenderPhase::InstanceUpdate,
+        applyElapsed.count() - (RenderStats::getFrameMs(RenderPhase::TerrainProbe) - probeMsBefore));
+
+    // planes that weren't updated keep last frame's instance, but still need
+    // to be reported to TCAS.
+    if (gFrameSelection.size() < gPlanes.size()) {
+        const auto planeCount = static_cast<XPMPPlaneStore::index_type>(gPlanes.size());
+        for (XPMPPlaneStore::index_type i = 0; i < planeCount; i++) {
+            if (gPlanes.lastUpdateAt(i) != frame) {
+                gPlanes.planeAt(i)->refreshTCAS();
+            }
+        }
+    }
+
+    const chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - startTime;
+    gScheduler.endFrame(gFrameSelection.size(), elapsed.count());
+
+    TCAS::selectPlanes();
+    RenderStats::setCounts(static_cast<int>(gPlanes.size()),
+                           static_cast<int>(gFrameSelection.size()),
+                           fullUpdateCount,
+                           suspendedCount,
+                           instanceBacklog);
 }
 
 
@@ -128,9 +475,18 @@ XPMP_PrepListHook(float inElapsedSinceLastCall,
     return -1.0f;
 }
 
+// the callbacks are attached and detached every time the planes come and
+// go, so track whether they're in.
+static bool gCallbacksAttached = false;
+
 void
 Renderer_Attach_Callbacks()
 {
+    if (gCallbacksAttached) {
+        return;
+    }
+    gCallbacksAttached = true;
+
     XPLMRegisterFlightLoopCallback(&XPMP_PrepListHook, -1, nullptr);
 
     TCAS::EnableHooks();
@@ -139,6 +495,11 @@ Renderer_Attach_Callbacks()
 void
 Renderer_Detach_Callbacks()
 {
+    if (!gCallbacksAttached) {
+        return;
+    }
+    gCallbacksAttached = false;
+
     TCAS::DisableHooks();
 
     XPLMUnregisterFlightLoopCallback(&XPMP_PrepListHook, nullptr);
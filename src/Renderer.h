@@ -31,11 +31,8 @@
 #include <XPLMScenery.h>
 #include <XPLMDataAccess.h>
 
-extern XPLMDataRef		gVisDataRef;		// Current air visiblity for culling.
 extern XPLMProbeRef		gTerrainProbe;
 
-extern double	Render_FullPlaneDistance;
-
 struct Label {
 	double		x;
 	double		y;
@@ -44,6 +41,7 @@ struct Label {
 };
 
 void	Renderer_Init();
+void	Renderer_Cleanup();
 void	Renderer_Attach_Callbacks();
 void	Renderer_Detach_Callbacks();
 
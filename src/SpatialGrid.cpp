@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "SpatialGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+constexpr double SpatialGrid::kCellSizeDeg;
+
+static const int	kLatCells = static_cast<int>(180.0 / SpatialGrid::kCellSizeDeg);
+static const int	kLonCells = static_cast<int>(360.0 / SpatialGrid::kCellSizeDeg);
+
+int
+SpatialGrid::latIndex(double lat)
+{
+	if (!isfinite(lat)) {
+		return latIndex(0.0);
+	}
+	const auto idx = static_cast<int>(floor((lat + 90.0) / kCellSizeDeg));
+	return min(max(idx, 0), kLatCells - 1);
+}
+
+int
+SpatialGrid::lonIndex(double lon)
+{
+	if (!isfinite(lon)) {
+		return lonIndex(0.0);
+	}
+	const auto idx = static_cast<int>(floor((lon + 180.0) / kCellSizeDeg)) % kLonCells;
+	return (idx < 0) ? idx + kLonCells : idx;
+}
+
+SpatialGrid::CellKey
+SpatialGrid::makeKey(int latIdx, int lonIdx)
+{
+	return (static_cast<CellKey>(latIdx) << 16) | static_cast<CellKey>(lonIdx);
+}
+
+void
+SpatialGrid::addToCell(index_type slot, CellKey cell)
+{
+	auto &members = mCells[cell];
+	mEntries[slot].cell = cell;
+	mEntries[slot].offset = static_cast<uint32_t>(members.size());
+	members.push_back(slot);
+}
+
+void
+SpatialGrid::removeFromCell(index_type slot)
+{
+	auto &entry = mEntries[slot];
+	auto cellIter = mCells.find(entry.cell);
+	auto &members = cellIter->second;
+
+	// move the cell's last member into the hole.
+	const auto lastSlot = members.back();
+	members[entry.offset] = lastSlot;
+	mEntries[lastSlot].offset = entry.offset;
+	members.pop_back();
+	if (members.empty()) {
+		mCells.erase(cellIter);
+	}
+	entry.cell = kNoCell;
+}
+
+void
+SpatialGrid::insert(index_type slot, double lat, double lon)
+{
+	if (slot >= mEntries.size()) {
+		mEntries.resize(slot + 1, Entry{kNoCell, 0});
+	}
+	if (mEntries[slot].cell != kNoCell) {
+		removeFromCell(slot);
+	}
+	addToCell(slot, makeKey(latIndex(lat), lonIndex(lon)));
+}
+
+void
+SpatialGrid::move(index_type slot, double lat, double lon)
+{
+	const auto cell = makeKey(latIndex(lat), lonIndex(lon));
+	if (mEntries[slot].cell == cell) {
+		return;
+	}
+	removeFromCell(slot);
+	addToCell(slot, cell);
+}
+
+void
+SpatialGrid::erase(index_type slot)
+{
+	if (slot < mEntries.size() && mEntries[slot].cell != kNoCell) {
+		removeFromCell(slot);
+	}
+}
+
+void
+SpatialGrid::clear()
+{
+	mCells.clear();
+	mEntries.clear();
+}
+
+void
+SpatialGrid::collectBox(double latMin, double lonMin, double latMax, double lonMax,
+                        vector<index_type> &outSlots) const
+{
+	const int latFirst = latIndex(latMin);
+	const int latLast = latIndex(latMax);
+	const auto lonFirst = static_cast<int>(floor((lonMin + 180.0) / kCellSizeDeg));
+	const auto lonLast = static_cast<int>(floor((lonMax + 180.0) / kCellSizeDeg));
+	const int lonCount = min(lonLast - lonFirst + 1, kLonCells);
+
+	// for big boxes it's cheaper to walk the occupied cells than to look up
+	// every cell in the box.
+	const size_t boxCells = static_cast<size_t>(latLast - latFirst + 1) * lonCount;
+	if (boxCells > mCells.size()) {
+		const int lonFirstWrapped = lonIndex(lonMin);
+		for (const auto &cell: mCells) {
+			const auto latIdx = static_cast<int>(cell.first >> 16);
+			const auto lonIdx = static_cast<int>(cell.first & 0xFFFF);
+			if (latIdx < latFirst || latIdx > latLast) {
+				continue;
+			}
+			int lonOffset = lonIdx - lonFirstWrapped;
+			if (lonOffset < 0) {
+				lonOffset += kLonCells;
+			}
+			if (lonOffset >= lonCount) {
+				continue;
+			}
+			outSlots.insert(outSlots.end(), cell.second.begin(), cell.second.end());
+		}
+		return;
+	}
+
+	for (int latIdx = latFirst; latIdx <= latLast; latIdx++) {
+		for (int i = 0; i < lonCount; i++) {
+			int lonIdx = (lonFirst + i) % kLonCells;
+			if (lonIdx < 0) {
+				lonIdx += kLonCells;
+			}
+			const auto cellIter = mCells.find(makeKey(latIdx, lonIdx));
+			if (cellIter != mCells.end()) {
+				outSlots.insert(outSlots.end(), cellIter->second.begin(), cellIter->second.end());
+			}
+		}
+	}
+}
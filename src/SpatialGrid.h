@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/** SpatialGrid buckets the planes into a uniform latitude/longitude grid so
+ * area queries only have to look at the planes in the cells that overlap the
+ * area, rather than every plane.
+ *
+ * Entries are keyed by the XPMPPlaneStore's slot indices, which (unlike the
+ * dense indices) stay put for as long as the plane exists.  Only the cells
+ * with planes in them are stored.
+ */
+class SpatialGrid {
+public:
+	using index_type = uint32_t;
+
+	/** the size of each cell in degrees of latitude and longitude */
+	static constexpr double kCellSizeDeg = 0.25;
+
+	SpatialGrid() = default;
+	SpatialGrid(const SpatialGrid &copySrc) = delete;
+
+	/** insert adds the entry for slot at the given position */
+	void	insert(index_type slot, double lat, double lon);
+
+	/** move updates the position of the entry for slot.  This is cheap if
+	 * the entry hasn't left it's cell.
+	 */
+	void	move(index_type slot, double lat, double lon);
+
+	/** erase removes the entry for slot */
+	void	erase(index_type slot);
+
+	/** clear removes all entries */
+	void	clear();
+
+	/** collectBox appends the slots of all the entries in the cells
+	 * overlapping the box to outSlots.  As whole cells are returned, some of
+	 * them may be outside of the box.
+	 *
+	 * @param latMin,latMax the latitude range, in degrees
+	 * @param lonMin,lonMax the longitude range, in degrees.  lonMax may be
+	 *   beyond 180 for boxes crossing the antimeridian, but must not be less
+	 *   than lonMin.
+	 * @param outSlots the vector to append the slots to
+	 */
+	void	collectBox(double latMin, double lonMin, double latMax, double lonMax,
+	                   std::vector<index_type> &outSlots) const;
+
+private:
+	using CellKey = uint32_t;
+	static const CellKey	kNoCell = UINT32_MAX;
+
+	struct Entry {
+		CellKey		cell;
+		uint32_t	offset;		// the entry's position in it's cell's vector
+	};
+
+	std::unordered_map<CellKey, std::vector<index_type>>	mCells;
+	std::vector<Entry>										mEntries;	// by slot
+
+	static int		latIndex(double lat);
+	static int		lonIndex(double lon);
+	static CellKey	makeKey(int latIdx, int lonIdx);
+
+	void	addToCell(index_type slot, CellKey cell);
+	void	removeFromCell(index_type slot);
+};
+
+#endif //SPATIALGRID_H
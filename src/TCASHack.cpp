@@ -22,6 +22,7 @@
  *
  */
 
+#include <algorithm>
 #include <vector>
 #include <XPLMDataAccess.h>
 #include <XPLMPlanes.h>
@@ -31,6 +32,7 @@
 #include "XPMPMultiplayerVars.h"
 
 #include "TCASHack.h"
+#include "RenderStats.h"
 
 using namespace std;
 
@@ -70,7 +72,6 @@ std::vector<XPLMDataRef>			TCAS::gMultiRef_X;
 std::vector<XPLMDataRef>			TCAS::gMultiRef_Y;
 std::vector<XPLMDataRef>			TCAS::gMultiRef_Z;
 
-XPLMDataRef							TCAS::gAltitudeRef = nullptr;	// Current aircraft altitude (for TCAS)
 bool								TCAS::gTCASHooksRegistered = false;
 int 								TCAS::gEnableCount = 1;
 int									TCAS::gMaxTCASItems = 0;
@@ -79,8 +80,6 @@ int									TCAS::gMaxTCASItems = 0;
 void
 TCAS::Init()
 {
-	gAltitudeRef = XPLMFindDataRef("sim/flightmodel/position/elevation");
-
 	// We don't know how many multiplayer planes there are - fetch as many as we can.
 	int n = 1;
 	char buf[100];
@@ -119,13 +118,13 @@ int	TCAS::ControlPlaneCount(
 	if (inRefcon == NULL) {
 		XPLMSetActiveAircraftCount(1);
 	} else {
+		ScopedPhaseTimer timer(RenderPhase::TCAS);
 		// quickly splat over multiplayer datarefs
 		int tcasItems = min((int)gTCASPlanes.size(), gMaxTCASItems);
-		auto tcasIter = gTCASPlanes.cbegin();
-		for (int c = 0; c < tcasItems; c++, tcasIter++) {
-			XPLMSetDataf(gMultiRef_X[c], tcasIter->second.x);
-			XPLMSetDataf(gMultiRef_Y[c], tcasIter->second.y);
-			XPLMSetDataf(gMultiRef_Z[c], tcasIter->second.z);
+		for (int c = 0; c < tcasItems; c++) {
+			XPLMSetDataf(gMultiRef_X[c], gTCASPlanes[c].x);
+			XPLMSetDataf(gMultiRef_Y[c], gTCASPlanes[c].y);
+			XPLMSetDataf(gMultiRef_Z[c], gTCASPlanes[c].z);
 		}
 		// and set the count
 		XPLMSetActiveAircraftCount(tcasItems+1);
@@ -155,7 +154,7 @@ TCAS::DisableHooks()
 	}
 }
 
-TCAS::TCASMap TCAS::gTCASPlanes;
+std::vector<TCAS::plane_record> TCAS::gTCASPlanes;
 
 void
 TCAS::cleanFrame()
@@ -166,5 +165,19 @@ TCAS::cleanFrame()
 void
 TCAS::addPlane(float distanceSqr, float x, float y, float z, bool isReportingAltitude)
 {
-	gTCASPlanes.emplace( distanceSqr, plane_record{x, y, z} );
+	gTCASPlanes.push_back(plane_record{distanceSqr, x, y, z});
+}
+
+void
+TCAS::selectPlanes()
+{
+	ScopedPhaseTimer timer(RenderPhase::TCAS);
+	auto nearer = [](const plane_record &a, const plane_record &b) {
+		return a.distanceSqr < b.distanceSqr;
+	};
+	if (gTCASPlanes.size() > static_cast<size_t>(gMaxTCASItems)) {
+		partial_sort(gTCASPlanes.begin(), gTCASPlanes.begin() + gMaxTCASItems, gTCASPlanes.end(), nearer);
+	} else {
+		sort(gTCASPlanes.begin(), gTCASPlanes.end(), nearer);
+	}
 }
\ No newline at end of file
@@ -26,7 +26,6 @@
 #define XPMP_TCASHACK_H
 
 #include <vector>
-#include <map>
 
 #include <XPLMDataAccess.h>
 #include <XPLMDisplay.h>
@@ -48,26 +47,30 @@ private:
 	static int ControlPlaneCount(XPLMDrawingPhase, int, void *);
 
 	struct plane_record {
+		float distanceSqr;
 		float x;
 		float y;
 		float z;
 	};
-	typedef std::multimap<float, struct plane_record>	TCASMap;
 
-	static TCASMap 							gTCASPlanes;
+	static std::vector<plane_record>		gTCASPlanes;	// nearest gMaxTCASItems first once selectPlanes() has run
 	static int								gMaxTCASItems;
 
 public:
-	static XPLMDataRef						gAltitudeRef; // Current aircraft altitude (for TCAS)
-
 	static void Init();
 	static void EnableHooks();
 	static void DisableHooks();
 
+	/** resets the TCAS list for a new frame */
 	static void cleanFrame();
 
 	/** adds a plane to the list of aircraft we're going to report on */
 	static void addPlane(float distanceSqr, float x, float y, float z, bool isReportingAltitude);
+
+	/** picks the nearest planes from those added this frame to be shown on
+	 * TCAS.  Called once all the planes have been added.
+	 */
+	static void selectPlanes();
 };
 
 #endif //XPMP_TCASHACK_H
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "TerrainCache.h"
+
+#include <cmath>
+#include <limits>
+
+#include <XPLMScenery.h>
+
+#include "Renderer.h"
+#include "RenderStats.h"
+
+using namespace std;
+
+TerrainCache	gTerrainCache;
+
+// how often (in seconds) the expired heights are swept out
+static const float	kSweepInterval = 1.0f;
+
+TerrainCache::TerrainCache() :
+	mEpoch(1),
+	mNow(0.0f),
+	mLastSweep(0.0f),
+	mProbesLeft(-1),
+	mProbeCutoffSqr(numeric_limits<float>::max())
+{
+}
+
+uint64_t
+TerrainCache::cellKey(double x, double z)
+{
+	const auto cx = static_cast<int32_t>(floor(x / kCellSize));
+	const auto cz = static_cast<int32_t>(floor(z / kCellSize));
+	return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cz);
+}
+
+void
+TerrainCache::beginFrame(float now, bool originMoved, int probeBudget)
+{
+	mNow = now;
+	mProbesLeft = (probeBudget > 0) ? probeBudget : -1;
+	mProbeCutoffSqr = numeric_limits<float>::max();
+	if (originMoved) {
+		invalidate();
+		return;
+	}
+	if (now - mLastSweep < kSweepInterval && now >= mLastSweep) {
+		return;
+	}
+	mLastSweep = now;
+	for (auto cell = mCells.begin(); cell != mCells.end();) {
+		if (now - cell->second.probedAt >= kMaxAge || now < cell->second.probedAt) {
+			cell = mCells.erase(cell);
+		} else {
+			++cell;
+		}
+	}
+}
+
+void
+TerrainCache::invalidate()
+{
+	mCells.clear();
+	mEpoch++;
+	mLastSweep = mNow;
+}
+
+bool
+TerrainCache::lookup(double x, double z, float &outY) const
+{
+	auto cell = mCells.find(cellKey(x, z));
+	if (cell == mCells.end() || mNow - cell->second.probedAt >= kMaxAge || mNow < cell->second.probedAt) {
+		return false;
+	}
+	outY = cell->second.y;
+	return true;
+}
+
+bool
+TerrainCache::probe(double x, double y, double z, float &outY)
+{
+	if (mProbesLeft > 0) {
+		mProbesLeft--;
+	}
+
+	XPLMProbeInfo_t	probeResult = {
+		sizeof(XPLMProbeInfo_t),
+	};
+	XPLMProbeResult r;
+	{
+		ScopedPhaseTimer timer(RenderPhase::TerrainProbe);
+		r = XPLMProbeTerrainXYZ(gTerrainProbe, static_cast<float>(x), static_cast<float>(y),
+		                        static_cast<float>(z), &probeResult);
+	}
+	if (r != xplm_ProbeHitTerrain) {
+		return false;
+	}
+	mCells[cellKey(x, z)] = Cell{probeResult.locationY, mNow};
+	outY = probeResult.locationY;
+	return true;
+}
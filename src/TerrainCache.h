@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2004, Ben Supnik and Chris Serio.
+ * Copyright (c) 2018, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef TERRAINCACHE_H
+#define TERRAINCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+/** TerrainCache remembers the terrain heights found by the surface clamping
+ * probes, so planes near each other (or the same plane, frame after frame)
+ * don't each have to probe.
+ *
+ * Heights are kept in local (OpenGL) coordinates for kCellSize meter square
+ * cells.  They're all thrown away when the local origin moves, and each is
+ * forgotten kMaxAge seconds after it was probed so scenery that loads in
+ * later is picked up.  invalidate() bumps the cache's epoch, so samples
+ * planes have kept themselves can be checked against it too.
+ *
+ * Probes made through the cache are limited to a per-frame budget, which
+ * can be restricted to the closest planes with setProbeCutoff().
+ *
+ * The XPLM is used to probe, so all of this is main-thread only, except
+ * lookup() and getEpoch() which may be used by the renderer's workers whilst
+ * the main thread isn't changing the cache.
+ */
+class TerrainCache {
+public:
+	/** the width of a cell in meters */
+	static constexpr double	kCellSize = 4.0;
+	/** how long (in seconds) a probed height is trusted for */
+	static constexpr float	kMaxAge = 10.0f;
+
+	TerrainCache();
+
+	/** beginFrame expires old heights and resets the probe budget.
+	 *
+	 * @param now the simulator time in seconds
+	 * @param originMoved true if the local origin has moved since the last
+	 *   frame, in which case every height is thrown away.
+	 * @param probeBudget the most probes to run this frame, or 0 for no limit
+	 */
+	void		beginFrame(float now, bool originMoved, int probeBudget);
+
+	/** setProbeCutoff stops planes further than sqrt(distanceSqr) meters from
+	 * the camera from probing for the rest of the frame.
+	 */
+	void		setProbeCutoff(float distanceSqr) { mProbeCutoffSqr = distanceSqr; }
+
+	/** invalidate throws away every height. */
+	void		invalidate();
+
+	/** lookup finds the terrain height for the cell containing x,z.
+	 *
+	 * @return true if a height was found
+	 */
+	bool		lookup(double x, double z, float &outY) const;
+
+	/** canProbe returns true if a plane sqrt(distanceSqr) meters from the
+	 * camera may probe - i.e. the budget isn't used up, and it's within the
+	 * cutoff.
+	 */
+	bool		canProbe(float distanceSqr) const
+	{
+		return mProbesLeft != 0 && distanceSqr <= mProbeCutoffSqr;
+	}
+
+	/** probe probes the terrain at x,y,z and caches the height.  This counts
+	 * against the budget.
+	 *
+	 * @return true if the terrain was found
+	 */
+	bool		probe(double x, double y, double z, float &outY);
+
+	/** getEpoch returns a number that changes whenever the cached heights are
+	 * invalidated.
+	 */
+	uint32_t	getEpoch() const { return mEpoch; }
+
+	/** getNow returns the time passed to the last beginFrame() */
+	float		getNow() const { return mNow; }
+
+	size_t		size() const { return mCells.size(); }
+
+private:
+	struct Cell {
+		float	y;
+		float	probedAt;
+	};
+
+	std::unordered_map<uint64_t, Cell>	mCells;
+	uint32_t	mEpoch;
+	float		mNow;
+	float		mLastSweep;
+	int			mProbesLeft;		// < 0 if unlimited
+	float		mProbeCutoffSqr;
+
+	static uint64_t	cellKey(double x, double z);
+};
+
+/** the renderer's terrain cache */
+extern TerrainCache	gTerrainCache;
+
+#endif //TERRAINCACHE_H
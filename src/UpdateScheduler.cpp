@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "UpdateScheduler.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// update intervals (in frames) for each distance band.
+static const uint32_t	kMidRangeInterval = 2;		// lights-only, within kMidRangeFactor x full distance
+static const uint32_t	kFarInterval = 4;			// lights-only, further out
+static const uint32_t	kCulledInterval = 8;		// beyond the visibility
+static const double		kMidRangeFactor = 4.0;
+
+// always service at least this many due planes, so a pathological budget
+// can't starve the distant traffic entirely.
+static const size_t		kMinOptionalUpdates = 4;
+
+// weight given to the newest sample in the running cost estimate
+static const double		kCostSmoothing = 0.1;
+
+UpdateScheduler::UpdateScheduler() :
+	mFrame(0),
+	mCostPerPlaneMs(0.0)
+{
+}
+
+void
+UpdateScheduler::beginFrame(const XPMPPlaneStore &planes,
+                            double fullDistance,
+                            float budgetMs,
+                            vector<XPMPPlaneStore::index_type> &outSelected)
+{
+	// frame 0 is reserved to mean "never updated".
+	if (++mFrame == 0) {
+		mFrame = 1;
+	}
+
+	const auto planeCount = static_cast<XPMPPlaneStore::index_type>(planes.size());
+	outSelected.clear();
+	outSelected.reserve(planeCount);
+
+	if (budgetMs <= 0.0f) {
+		for (XPMPPlaneStore::index_type i = 0; i < planeCount; i++) {
+			outSelected.push_back(i);
+		}
+		return;
+	}
+
+	const auto fullDistanceSqr = static_cast<float>(fullDistance * fullDistance);
+	const auto midDistanceSqr = static_cast<float>(fullDistanceSqr * kMidRangeFactor * kMidRangeFactor);
+
+	mCandidates.clear();
+	for (XPMPPlaneStore::index_type i = 0; i < planeCount; i++) {
+		const uint32_t lastUpdate = planes.lastUpdateAt(i);
+		const float distanceSqr = planes.distanceSqrAt(i);
+		if (lastUpdate == 0 || distanceSqr <= fullDistanceSqr) {
+			outSelected.push_back(i);
+			continue;
+		}
+
+		uint32_t interval;
+		if (planes.flagsAt(i) & PlaneFlag_Culled) {
+			interval = kCulledInterval;
+		} else if (distanceSqr <= midDistanceSqr) {
+			interval = kMidRangeInterval;
+		} else {
+			interval = kFarInterval;
+		}
+		const uint32_t age = mFrame - lastUpdate;
+		if (age >= interval) {
+			mCandidates.push_back(Candidate{i, static_cast<float>(age) / static_cast<float>(interval)});
+		}
+	}
+
+	// work out how many of the due planes we can afford.  Until we've
+	// measured anything, assume we can afford all of them.
+	size_t optionalCount = mCandidates.size();
+	if (mCostPerPlaneMs > 0.0) {
+		const double remainingMs = budgetMs - (outSelected.size() * mCostPerPlaneMs);
+		const double affordable = (remainingMs > 0.0) ? (remainingMs / mCostPerPlaneMs) : 0.0;
+		optionalCount = max(kMinOptionalUpdates, static_cast<size_t>(affordable));
+	}
+
+	if (optionalCount < mCandidates.size()) {
+		nth_element(mCandidates.begin(), mCandidates.begin() + optionalCount, mCandidates.end(),
+			[](const Candidate &a, const Candidate &b) {
+				return a.staleness > b.staleness;
+			});
+		mCandidates.resize(optionalCount);
+	}
+	for (const auto &c: mCandidates) {
+		outSelected.push_back(c.index);
+	}
+}
+
+void
+UpdateScheduler::endFrame(size_t updatedCount, double elapsedMs)
+{
+	if (updatedCount == 0) {
+		return;
+	}
+	const double sample = elapsedMs / updatedCount;
+	if (mCostPerPlaneMs <= 0.0) {
+		mCostPerPlaneMs = sample;
+	} else {
+		mCostPerPlaneMs += (sample - mCostPerPlaneMs) * kCostSmoothing;
+	}
+}
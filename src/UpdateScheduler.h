@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef UPDATESCHEDULER_H
+#define UPDATESCHEDULER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "XPMPPlaneStore.h"
+
+/** UpdateScheduler decides which planes get a full instance update each
+ * frame.
+ *
+ * Planes within the full rendering distance (and planes that have never been
+ * drawn) are updated every frame.  Planes further out are given longer update
+ * intervals, and the due ones are serviced most-stale-first for as long as the
+ * per-frame time budget allows.  Planes that miss out simply become more
+ * stale, and so move up the queue for the next frame.
+ *
+ * The cost of an update is learnt from the time the renderer reports back
+ * each frame, so the budget tracks the actual machine.
+ */
+class UpdateScheduler {
+public:
+	UpdateScheduler();
+
+	/** beginFrame advances the scheduler's frame counter and selects the
+	 * planes to update this frame.
+	 *
+	 * @param planes the plane store.  Distances and flags are those from the
+	 *   planes' last update.
+	 * @param fullDistance the distance within which planes update every frame
+	 * @param budgetMs the time budget for this frame in milliseconds.  If 0 or
+	 *   less, every plane is selected.
+	 * @param outSelected receives the dense indices of the planes to update.
+	 */
+	void	beginFrame(const XPMPPlaneStore &planes,
+	                   double fullDistance,
+	                   float budgetMs,
+	                   std::vector<XPMPPlaneStore::index_type> &outSelected);
+
+	/** endFrame records how long the selected planes took to update. */
+	void	endFrame(size_t updatedCount, double elapsedMs);
+
+	/** getFrame returns the current frame number.  It is never 0. */
+	uint32_t	getFrame() const { return mFrame; }
+
+private:
+	struct Candidate {
+		XPMPPlaneStore::index_type	index;
+		float						staleness;
+	};
+
+	uint32_t				mFrame;
+	double					mCostPerPlaneMs;	// running estimate of the cost of one update
+	std::vector<Candidate>	mCandidates;
+};
+
+#endif //UPDATESCHEDULER_H
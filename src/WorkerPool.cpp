@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+WorkerPool::WorkerPool(unsigned int threadCount) :
+    mNextIndex(0)
+{
+    if (threadCount == 0) {
+        unsigned int hwThreads = thread::hardware_concurrency();
+        threadCount = (hwThreads > 1) ? (hwThreads - 1) : 0;
+    }
+    mThreads.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; i++) {
+        mThreads.emplace_back(&WorkerPool::workerMain, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        lock_guard<mutex> lock(mLock);
+        mShutdown = true;
+    }
+    mWakeCondition.notify_all();
+    for (auto &t: mThreads) {
+        t.join();
+    }
+}
+
+unsigned int
+WorkerPool::getConcurrency() const
+{
+    return static_cast<unsigned int>(mThreads.size()) + 1;
+}
+
+void
+WorkerPool::runChunks()
+{
+    while (true) {
+        size_t begin = mNextIndex.fetch_add(mJobGrain);
+        if (begin >= mJobCount) {
+            return;
+        }
+        (*mJob)(begin, min(begin + mJobGrain, mJobCount));
+    }
+}
+
+void
+WorkerPool::workerMain()
+{
+    uint64_t lastGeneration = 0;
+    unique_lock<mutex> lock(mLock);
+    while (true) {
+        mWakeCondition.wait(lock, [this, lastGeneration] {
+            return mShutdown || mGeneration != lastGeneration;
+        });
+        if (mShutdown) {
+            return;
+        }
+        lastGeneration = mGeneration;
+
+        lock.unlock();
+        runChunks();
+        lock.lock();
+
+        if (--mBusyThreads == 0) {
+            mDoneCondition.notify_one();
+        }
+    }
+}
+
+void
+WorkerPool::parallelFor(size_t count, size_t grainSize, const range_function &func)
+{
+    if (count == 0) {
+        return;
+    }
+    if (grainSize == 0) {
+        grainSize = 1;
+    }
+    // not worth waking anybody up for a single chunk.
+    if (mThreads.empty() || count <= grainSize) {
+        func(0, count);
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(mLock);
+        mJob = &func;
+        mJobCount = count;
+        mJobGrain = grainSize;
+        mNextIndex.store(0);
+        mBusyThreads = static_cast<unsigned int>(mThreads.size());
+        ++mGeneration;
+    }
+    mWakeCondition.notify_all();
+
+    runChunks();
+
+    unique_lock<mutex> lock(mLock);
+    mDoneCondition.wait(lock, [this] { return mBusyThreads == 0; });
+    mJob = nullptr;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** WorkerPool is a minimal fork-join thread pool for splitting the per-frame
+ * plane work across the machine's cores.
+ *
+ * Jobs run on the pool MUST NOT call into the XPLM - the SDK is only safe to
+ * use from the simulator's main thread.
+ */
+class WorkerPool {
+public:
+    using range_function = std::function<void(size_t begin, size_t end)>;
+
+    /** Creates a new worker pool.
+     *
+     * @param threadCount the number of background threads to start.  If 0,
+     *   one less than the number of hardware threads is used, as the calling
+     *   thread also participates in each job.
+     */
+    explicit WorkerPool(unsigned int threadCount = 0);
+
+    WorkerPool(const WorkerPool &copySrc) = delete;
+
+    ~WorkerPool();
+
+    /** parallelFor splits the range [0, count) into chunks of no more than
+     * grainSize elements and runs func over them on the pool.  The calling
+     * thread participates, and parallelFor does not return until every
+     * chunk has been completed.
+     *
+     * @param count the number of elements to process
+     * @param grainSize the maximum number of elements per chunk
+     * @param func the function to invoke for each chunk
+     */
+    void parallelFor(size_t count, size_t grainSize, const range_function &func);
+
+    /** getConcurrency returns the number of threads that participate in a
+     * job, including the calling thread.
+     */
+    unsigned int getConcurrency() const;
+
+private:
+    void workerMain();
+    void runChunks();
+
+    std::vector<std::thread>    mThreads;
+
+    std::mutex                  mLock;
+    std::condition_variable     mWakeCondition;
+    std::condition_variable     mDoneCondition;
+
+    // current job - only valid whilst mBusyThreads is non-zero.
+    const range_function *      mJob = nullptr;
+    size_t                      mJobCount = 0;
+    size_t                      mJobGrain = 1;
+    std::atomic<size_t>         mNextIndex;
+
+    unsigned int                mBusyThreads = 0;
+    uint64_t                    mGeneration = 0;
+    bool                        mShutdown = false;
+};
+
+#endif //WORKERPOOL_H
@@ -21,6 +21,7 @@
  *
  */
 
+#include <cstddef>
 #include <cstdlib>
 #include <cstdio>
 #include <set>
@@ -35,6 +36,7 @@
 
 #include <XPLMUtilities.h>
 #include <XPLMPlanes.h>
+#include <XPLMProcessing.h>
 #include <XPMPMultiplayer.h>
 #include "PlanesHandoff.h"
 
@@ -45,6 +47,9 @@
 #include "CSLLibrary.h"
 #include "XUtils.h"
 #include "Renderer.h"
+#include "RenderStats.h"
+#include "PlaneIngest.h"
+#include "obj8/Obj8Attachment.h"
 #include "obj8/Obj8CSL.h"
 
 
@@ -52,28 +57,47 @@
 #define    DEBUG_MANUAL_LOADING    0
 
 static XPMPPlanePtr
-XPMPPlaneFromID(XPMPPlaneID inID, XPMPPlaneMap::iterator *outIter = nullptr)
+XPMPPlaneFromID(XPMPPlaneID inID)
 {
     assert(inID);
-    auto planeIter = gPlanes.find(inID);
-    assert(planeIter != gPlanes.end());
-    if (outIter) {
-        *outIter = planeIter;
-    }
-    return static_cast<XPMPPlanePtr>(inID);
+    auto *plane = gPlanes.find(inID);
+    assert(plane != nullptr);
+    return plane;
 }
 
 /********************************************************************************
  * SETUP
  ********************************************************************************/
 
+/** configurationSize returns how much of the client's configuration may be
+ * read or written - the members ahead of size always, and the rest only if
+ * size says they're there.
+ */
+static size_t
+configurationSize(const XPMPConfiguration_t *config)
+{
+    const size_t baseSize = offsetof(XPMPConfiguration_t, size);
+    if (config->size < baseSize + sizeof(config->size) || config->size > sizeof(XPMPConfiguration_t)) {
+        return baseSize;
+    }
+    return config->size;
+}
+
+/** copyConfiguration sets the library's configuration from the client's. */
+static void
+copyConfiguration(const XPMPConfiguration_t *inConfig)
+{
+    memcpy(&gConfiguration, inConfig, configurationSize(inConfig));
+    gConfiguration.size = sizeof(gConfiguration);
+}
+
 const char *
 XPMPMultiplayerInit(XPMPConfiguration_t *inConfiguration,
                     const char *inRelated,
                     const char *inDoc8643)
 {
     if (nullptr != inConfiguration) {
-        memcpy(&gConfiguration, inConfiguration, sizeof(gConfiguration));
+        copyConfiguration(inConfiguration);
     }
 
     // set up OBJ8 support
@@ -93,13 +117,27 @@ XPMPMultiplayerInit(XPMPConfiguration_t *inConfiguration,
 void
 XPMPSetConfiguration(XPMPConfiguration_t *inConfig)
 {
-    memcpy(&gConfiguration, inConfig, sizeof(gConfiguration));
+    copyConfiguration(inConfig);
 }
 
 void
 XPMPGetConfiguration(XPMPConfiguration_t *outConfig)
 {
-    memcpy(outConfig, &gConfiguration, sizeof(gConfiguration));
+    const size_t copySize = configurationSize(outConfig);
+    memcpy(outConfig, &gConfiguration, copySize);
+    if (copySize > offsetof(XPMPConfiguration_t, size)) {
+        // the client's size stands, even if ours is bigger.
+        outConfig->size = copySize;
+    }
+}
+
+void
+XPMPGetRenderStats(XPMPRenderStats_t *outStats)
+{
+    if (outStats == nullptr) {
+        return;
+    }
+    RenderStats::getStats(*outStats);
 }
 
 const char *
@@ -111,10 +149,61 @@ XPMPMultiplayerLoadCSLPackages(const char *inPackagePath)
     else { return ""; }
 }
 
+// true between XPMPMultiplayerEnable and XPMPMultiplayerDisable.
+static bool gEnabled = false;
+
+/** updateRenderer attaches the renderer whilst the library is enabled and
+ * there are planes to draw or posts to drain, and detaches it otherwise.
+ */
+static void
+updateRenderer()
+{
+    if (gEnabled && (!gPlanes.empty() || PlaneIngest::hasPending())) {
+        Renderer_Attach_Callbacks();
+    } else {
+        Renderer_Detach_Callbacks();
+    }
+}
+
+/** XPMP_IngestHook runs every frame whilst the library is enabled, as
+ * planes can be posted from threads that can't attach the renderer.  Once
+ * the renderer has drained the posts, it's detached again if no planes are
+ * left.
+ */
+static float
+XPMP_IngestHook(float /*inElapsedSinceLastCall*/,
+                float /*inElapsedTimeSinceLastFlightLoop*/,
+                int /*inCounter*/,
+                void * /*inRefcon*/)
+{
+    updateRenderer();
+    return -1.0f;
+}
+
+/** setEnabled (un)registers XPMP_IngestHook and attaches or detaches the
+ * renderer to suit.
+ */
+static void
+setEnabled(bool enabled)
+{
+    if (enabled != gEnabled) {
+        gEnabled = enabled;
+        if (enabled) {
+            XPLMRegisterFlightLoopCallback(&XPMP_IngestHook, -1, nullptr);
+        } else {
+            XPLMUnregisterFlightLoopCallback(&XPMP_IngestHook, nullptr);
+        }
+    }
+    updateRenderer();
+}
+
 void
 XPMPMultiplayerCleanup()
 {
-    Renderer_Detach_Callbacks();
+    setEnabled(false);
+    PlaneIngest::discard();
+    Renderer_Cleanup();
+    Obj8Attachment::destroyIdleInstances();
 }
 
 static void MPPlanesAcquired(void *refcon)
@@ -131,8 +220,8 @@ const char *
 XPMPMultiplayerEnable()
 {
     Planes_SafeAcquire(&MPPlanesAcquired, &MPPlanesReleased, nullptr, 0);
-    // put in the rendering hook now
-    Renderer_Attach_Callbacks();
+    // put in the rendering hook now, if there's anything to render.
+    setEnabled(true);
     XPMPMapRendering::Start();
     return "";
 }
@@ -141,9 +230,12 @@ void
 XPMPMultiplayerDisable(void)
 {
     XPMPMapRendering::Shutdown();
-    Renderer_Detach_Callbacks();
+    setEnabled(false);
     Planes_SafeRelease();
+    PlaneIngest::discard();
     gPlanes.clear();
+    // the planes' instances were parked for reuse, but nothing's coming.
+    Obj8Attachment::destroyIdleInstances();
 }
 
 void
@@ -216,15 +308,7 @@ XPMPCreatePlane(
     const char *inAirline,
     const char *inLivery)
 {
-    auto plane = std::make_unique<XPMPPlane>();
-    plane->setType(PlaneType(inICAOCode, inAirline, inLivery));
-    plane->updateCSL();
-    XPMPPlanePtr planePtr = plane.get();
-    gPlanes.emplace(planePtr, std::move(plane));
-    if (gPlanes.size() == 1) {
-        Renderer_Attach_Callbacks();
-    }
-    return planePtr;
+    return XPMPCreatePlaneWithModelName(nullptr, inICAOCode, inAirline, inLivery);
 }
 
 XPMPPlaneID
@@ -234,50 +318,45 @@ XPMPCreatePlaneWithModelName(
     const char *inAirline,
     const char *inLivery)
 {
-    auto plane = std::make_unique<XPMPPlane>();
-    plane->setType(PlaneType(inICAOCode, inAirline, inLivery));
+    XPMPPlaneID planeID = gPlanes.reserveID();
+    PlaneIngest::createPlane(planeID, inModelName, inICAOCode, inAirline, inLivery);
+    updateRenderer();
+    return planeID;
+}
 
-    // Find the model
-    bool found = false;
-    for (const auto &package : gPackages) {
-        auto cslPlane = std::find_if(package.planes.begin(),
-                                     package.planes.end(),
-                                     [inModelName](CSL *p) {
-                                         return p->getModelName() ==
-                                                inModelName;
-                                     });
-        if (cslPlane != package.planes.end()) {
-            plane->setCSL(*cslPlane);
-            found = true;
-        }
+void
+XPMPDestroyPlane(XPMPPlaneID inID)
+{
+    bool found = gPlanes.erase(inID);
+    assert(found);
+    if (found) {
+        updateRenderer();
     }
+}
 
-    if (!found) {
-        XPLMDebugString("Requested model ");
-        XPLMDebugString(inModelName);
-        XPLMDebugString(" is unknown! Falling back to own model matching.");
-        XPLMDebugString("\n");
-        plane->updateCSL();
-    }
+XPMPPlaneID
+XPMPPostCreatePlane(
+    const char *inICAOCode,
+    const char *inAirline,
+    const char *inLivery)
+{
+    return PlaneIngest::postCreate(nullptr, inICAOCode, inAirline, inLivery);
+}
 
-    XPMPPlanePtr planePtr = plane.get();
-    gPlanes.emplace(planePtr, std::move(plane));
-    if (gPlanes.size() == 1) {
-        Renderer_Attach_Callbacks();
-    }
-    return planePtr;
+XPMPPlaneID
+XPMPPostCreatePlaneWithModelName(
+    const char *inModelName,
+    const char *inICAOCode,
+    const char *inAirline,
+    const char *inLivery)
+{
+    return PlaneIngest::postCreate(inModelName, inICAOCode, inAirline, inLivery);
 }
 
 void
-XPMPDestroyPlane(XPMPPlaneID inID)
+XPMPPostDestroyPlane(XPMPPlaneID inID)
 {
-    XPMPPlaneMap::iterator iter;
-    XPMPPlanePtr plane = XPMPPlaneFromID(inID, &iter);
-
-    gPlanes.erase(iter);
-    if (gPlanes.size() == 0) {
-        Renderer_Detach_Callbacks();
-    }
+    PlaneIngest::postDestroy(inID);
 }
 
 int
@@ -291,6 +370,9 @@ XPMPChangePlaneModel(
     PlaneType newType(inICAOCode, inAirline, inLivery);
 
     XPMPPlanePtr plane = XPMPPlaneFromID(inPlaneID);
+    if (plane == nullptr) {
+        return -1;
+    }
     if (force_change) {
         plane->setType(newType);
         plane->updateCSL();
@@ -307,6 +389,7 @@ XPMPSetDefaultPlaneICAO(
     const char *inICAO)
 {
     gDefaultPlane.mICAO = inICAO;
+    CSL_ClearMatchCache();
 }
 
 long
@@ -315,6 +398,29 @@ XPMPCountPlanes(void)
     return static_cast<long>(gPlanes.size());
 }
 
+size_t
+XPMPGetNearestPlanes(
+    double inLat,
+    double inLon,
+    XPMPPlaneID *outPlanes,
+    double *outDistances,
+    size_t inMaxPlanes)
+{
+    if (outPlanes == nullptr) {
+        return 0;
+    }
+    std::vector<XPMPPlaneStore::index_type> indices;
+    std::vector<double> distances;
+    gPlanes.queryNearest(inLat, inLon, inMaxPlanes, indices, &distances);
+    for (size_t n = 0; n < indices.size(); n++) {
+        outPlanes[n] = gPlanes.idAt(indices[n]);
+        if (outDistances != nullptr) {
+            outDistances[n] = distances[n];
+        }
+    }
+    return indices.size();
+}
+
 bool
 XPMPIsICAOValid(
     const char *inICAO)
@@ -327,7 +433,9 @@ XPMPGetPlaneModelQuality(
     XPMPPlaneID inPlane)
 {
     XPMPPlanePtr thisPlane = XPMPPlaneFromID(inPlane);
-
+    if (thisPlane == nullptr) {
+        return -1;
+    }
     return thisPlane->getMatchQuality();
 }
 
@@ -373,18 +481,20 @@ XPMPUpdatePlanes(
             continue;
         }
 
-        auto *plane = XPMPPlaneFromID(thisUpdate->plane);
-
-        if (thisUpdate->position) {
-            plane->updatePosition(*thisUpdate->position);
-        }
-        if (thisUpdate->surfaces) {
-            plane->updateSurfaces(*thisUpdate->surfaces);
-        }
-        if (thisUpdate->surveillance) {
-            plane->updateSurveillance(*thisUpdate->surveillance);
+        auto planeIndex = gPlanes.indexOf(thisUpdate->plane);
+        assert(planeIndex != XPMPPlaneStore::kInvalidIndex);
+        if (planeIndex == XPMPPlaneStore::kInvalidIndex) {
+            continue;
         }
-
-        // guards against new struct members should begin below.
+        PlaneIngest::applyUpdate(planeIndex, *thisUpdate, inUpdateSize);
     }
 }
+
+void
+XPMPPostUpdatePlanes(
+    XPMPUpdate_t *inUpdates,
+    size_t inUpdateSize,
+    size_t inCount)
+{
+    PlaneIngest::postUpdates(inUpdates, inUpdateSize, inCount);
+}
@@ -32,12 +32,23 @@
 XPMPConfiguration_t				gConfiguration = {
 	3.0,	// maxFullAircraftRenderingDistance
 	false,	// enableSurfaceClamping
-	{ false }	// debug options
+	{ false, false },	// debug options
+	sizeof(XPMPConfiguration_t),	// size
+	0.0f,	// updateBudgetMs
+	xpmpCullMode_None,	// cullMode
+	0.0f,	// interpolationDelay
+	0,		// terrainProbeBudget
+	1.0f,	// lodMinDwell
+	0,		// instanceCreationBudget
+	4,		// maxObjectLoadsInFlight
+	0,		// maxLoadedObjects
+	1.0f,	// prefetchDistance
+	30.0f	// prefetchLeadTime
 };
 
 PlaneType						gDefaultPlane;
 
-XPMPPlaneMap					gPlanes;
+XPMPPlaneStore					gPlanes;
 int								gDumpOneRenderCycle = 0;
 
 std::vector<CSLPackage_t>		gPackages;
@@ -40,16 +40,20 @@
 #include "XPMPMultiplayer.h"
 
 #include "CSL.h"
+#include "MatchTable.h"
 #include "PlaneType.h"
 
 const	double	kFtToMeters = 0.3048;
 const	double	kMaxDistTCAS = 40.0 * 6080.0 * kFtToMeters;
 
+// the bounding radius (in meters) used for culling aircraft of unknown size
+const	float	kBoundingRadiusUnknown = 45.0f;
+
 /****************** MODEL MATCHING CRAP ***************/
 
 // These enums define the eight levels of matching we might possibly
-// make.  For each level of matching, we use a single string as a key.
-// (The string's contents vary with model - examples are shown.)
+// make.  For each level of matching, we use a MatchKey of the interned
+// strings as a key.  (The contents vary with model - examples are shown.)
 enum {
 	match_icao_airline_livery = 0,		//	B738 SWA SHAMU
 	match_icao_airline,					//	B738 SWA
@@ -72,7 +76,7 @@ enum {
 };
 
 
-// A CSL package - a vector of planes and six maps from the above matching 
+// A CSL package - a vector of planes and eight tables from the above matching
 // keys to the internal index of the plane.
 struct	CSLPackage_t {
 
@@ -84,7 +88,7 @@ struct	CSLPackage_t {
 	std::string					name;
 	std::string					path;
 	std::vector<CSL *>			planes;
-	std::unordered_map<std::string, int>	matches[match_count];
+	MatchTable					matches[match_count];
 };
 
 extern std::vector<CSLPackage_t>		gPackages;
@@ -105,13 +109,13 @@ extern std::unordered_map<std::string, CSLAircraftCode_t>	gAircraftCodes;
 /**************** PLANE OBJECTS ********************/
 
 #include "XPMPPlane.h"
+#include "XPMPPlaneStore.h"
 
 typedef	XPMPPlane *								XPMPPlanePtr;
-typedef	std::unordered_map<void *, std::unique_ptr<XPMPPlane>>		XPMPPlaneMap;
 
 extern XPMPConfiguration_t				gConfiguration;
 extern PlaneType						gDefaultPlane;
 
-extern XPMPPlaneMap					gPlanes;				// All planes
+extern XPMPPlaneStore				gPlanes;				// All planes
 
 #endif
@@ -24,7 +24,6 @@
 #include <algorithm>
 #include <cstring>
 
-#include <XPLMGraphics.h>
 #include <XPLMProcessing.h>
 #include <XPLMPlanes.h>
 #include <XPLMDataAccess.h>
@@ -34,15 +33,31 @@
 #include "XPMPPlane.h"
 #include "PlaneType.h"
 #include "Renderer.h"
-#include "CullInfo.h"
+#include "FrameContext.h"
 #include "TCASHack.h"
 #include "CSLLibrary.h"
 
 using namespace std;
 
+// a plane has to be out of view for this long (in seconds) before it's
+// suspended...
+static const float	kCullSuspendDelay = 0.5f;
+// ... and then for this much longer before it's instance is released.
+static const float	kCullReleaseDelay = 10.0f;
+// planes that are being updated are culled with their radius scaled up by
+// this, so planes at the edge of the view don't flip between states.
+static const float	kCullRadiusMargin = 1.5f;
+
 XPMPPlane::XPMPPlane() :
 	mPlaneType("", "", ""),
+	mLabel{},
+	mSurveillance{},
 	mCSL(nullptr),
+	mMatchQuality(-1),
+	mBoundingRadius(kBoundingRadiusUnknown),
+	mLocalX(0.0),
+	mLocalY(0.0),
+	mLocalZ(0.0),
 	mInstanceData(nullptr)
 {
 }
@@ -70,19 +85,21 @@ XPMPPlane::setCSL(CSL *csl)
 			mInstanceData = nullptr;
 		}
 		mCSL = csl;
+		mBoundingRadius = (csl != nullptr) ? csl->getBoundingRadius() : kBoundingRadiusUnknown;
 	}
 }
 
-void
-XPMPPlane::updatePosition(const XPMPPlanePosition_t &newPosition)
+const char *
+XPMPPlane::getLabel() const
 {
-	memcpy(&mPosition, &newPosition, min(newPosition.size, sizeof(mPosition)));
+	return mLabel;
 }
 
 void
-XPMPPlane::updateSurfaces(const XPMPPlaneSurfaces_t &newSurfaces)
+XPMPPlane::setLabel(const char *label)
 {
-	memcpy(&mSurface, &newSurfaces, min(newSurfaces.size, sizeof(mSurface)));
+	strncpy(mLabel, label, sizeof(mLabel) - 1);
+	mLabel[sizeof(mLabel) - 1] = '\0';
 }
 
 void
@@ -91,76 +108,273 @@ XPMPPlane::updateSurveillance(const XPMPPlaneSurveillance_t &newSurveillance)
 	memcpy(&mSurveillance, &newSurveillance, min(newSurveillance.size, sizeof(mSurveillance)));
 }
 
-float
-XPMPPlane::doInstanceUpdate(const CullInfo &gl_camera)
+void
+XPMPPlane::updateLocalPosition(const LocalProjection &projection, const PlanePosition &position)
 {
-	if (mCSL) {
-		double	lx,ly,lz;
+	projection.worldToLocal(position.lat, position.lon, position.elevation * kFtToMeters, mLocalX, mLocalY, mLocalZ);
+}
+
+void
+XPMPPlane::getLocalPosition(double &outX, double &outY, double &outZ) const
+{
+	outX = mLocalX;
+	outY = mLocalY;
+	outZ = mLocalZ;
+}
+
+void
+XPMPPlane::getDrawPosition(const PlanePosition &position, bool reuseInstance,
+                           float &outX, float &outY, float &outZ) const
+{
+	if (reuseInstance && mInstanceData != nullptr) {
+		outX = static_cast<float>(mInstanceData->mX);
+		outY = static_cast<float>(mInstanceData->mY);
+		outZ = static_cast<float>(mInstanceData->mZ);
+		return;
+	}
+	double y = mLocalY;
+	if (mCSL != nullptr) {
+		y += mCSL->getScaledVertOffset(position.offsetScale);
+	}
+	outX = static_cast<float>(mLocalX);
+	outY = static_cast<float>(y);
+	outZ = static_cast<float>(mLocalZ);
+}
 
-		XPLMWorldToLocal(mPosition.lat, mPosition.lon, mPosition.elevation * kFtToMeters, &lx, &ly, &lz);
+void
+XPMPPlane::prepareInstanceUpdate(const FrameContext &frame,
+                                 const CullResult &cull,
+                                 const PlanePosition &position,
+                                 const XPMPPlaneSurfaces_t &surfaces)
+{
+	if (mCSL) {
 		XPLMPlaneDrawState_t planeState = {};
 
 		planeState.structSize = sizeof(planeState);
-		planeState.gearPosition = mSurface.gearPosition;
-		planeState.flapRatio = mSurface.flapRatio;
-		planeState.spoilerRatio = mSurface.spoilerRatio;
-		planeState.speedBrakeRatio = mSurface.speedBrakeRatio;
-		planeState.slatRatio = mSurface.slatRatio;
-		planeState.wingSweep = mSurface.wingSweep;
-		planeState.thrust = mSurface.thrust;
-		planeState.yokePitch = mSurface.yokePitch;
-		planeState.yokeHeading = mSurface.yokeHeading;
-		planeState.yokeRoll = mSurface.yokeRoll;
-
-        mCSL->updateInstance(
-            gl_camera,
-            lx,
-            ly,
-            lz,
-            mPosition.roll,
-            mPosition.heading,
-            mPosition.pitch,
-            mPosition.clampToGround,
-            mPosition.offsetScale,
-            mSurface.lights,
+		planeState.gearPosition = surfaces.gearPosition;
+		planeState.flapRatio = surfaces.flapRatio;
+		planeState.spoilerRatio = surfaces.spoilerRatio;
+		planeState.speedBrakeRatio = surfaces.speedBrakeRatio;
+		planeState.slatRatio = surfaces.slatRatio;
+		planeState.wingSweep = surfaces.wingSweep;
+		planeState.thrust = surfaces.thrust;
+		planeState.yokePitch = surfaces.yokePitch;
+		planeState.yokeHeading = surfaces.yokeHeading;
+		planeState.yokeRoll = surfaces.yokeRoll;
+
+        mCSL->prepareInstance(
+            frame,
+            cull,
+            mLocalX,
+            mLocalY + mCSL->getScaledVertOffset(position.offsetScale),
+            mLocalZ,
+            position.roll,
+            position.heading,
+            position.pitch,
+            surfaces.lights,
             mInstanceData,
             &planeState);
 
 		if (mInstanceData == nullptr) {
-			return 0.0;
-		}
-		// apply surveillance mode related masking to the TCAS inclusion record.
-		if (mSurveillance.mode == xpmpTransponderMode_Standby) {
-			mInstanceData->mTCAS = false;
-		}
-		// check for altitude - if difference exceeds a preconfigured limit, don't show
-		double acft_alt = XPLMGetDatad(TCAS::gAltitudeRef) / kFtToMeters;
-		double alt_diff = mPosition.elevation - acft_alt;
-		if(alt_diff < 0) alt_diff *= -1;
-		if(mSurveillance.mode != xpmpTransponderMode_Mode3A && alt_diff > MAX_TCAS_ALTDIFF) {
-			mInstanceData->mTCAS = false;
-		}
-		if (mInstanceData->mTCAS) {
-			// populate the global TCAS list
-			TCAS::addPlane(mInstanceData->mDistanceSqr, lx, ly, lz, mSurveillance.mode != xpmpTransponderMode_Mode3A);
+			return;
 		}
+		maskTCAS(frame, position);
 
 		// do labels.
 #if 0
 		if (!mInstanceData->mCulled && mInstanceData->mDistanceSqr <= (Render_LabelDistance * Render_LabelDistance)) {
 			float tx, ty;
 
-			gl_camera.ConvertTo2D(lx, ly, lz, 1.0, &tx, &ty);
+			frame.camera.ConvertTo2D(mInstanceData->mX, mInstanceData->mY, mInstanceData->mZ, 1.0, &tx, &ty);
 			gLabelList.emplace_back(Label{
 				tx, ty,
 				mInstanceData->mDistanceSqr,
-				string(mPosition.label) 
+				string(mLabel) 
 			});
 		}
 #endif
-		return mInstanceData->mDistanceSqr;
 	}
-	return 0.0;
+}
+
+bool
+XPMPPlane::refreshInstanceUpdate(const FrameContext &frame,
+                                 const CullResult &cull,
+                                 const PlanePosition &position)
+{
+	if (mCSL == nullptr || mInstanceData == nullptr) {
+		return true;
+	}
+	bool needsPrepare = mCSL->refreshInstance(frame, cull, mInstanceData);
+	maskTCAS(frame, position);
+	return needsPrepare;
+}
+
+void
+XPMPPlane::maskTCAS(const FrameContext &frame, const PlanePosition &position)
+{
+	// apply surveillance mode related masking to the TCAS inclusion record.
+	if (mSurveillance.mode == xpmpTransponderMode_Standby) {
+		mInstanceData->mTCAS = false;
+	}
+	// check for altitude - if difference exceeds a preconfigured limit, don't show
+	double alt_diff = position.elevation - frame.userAltitudeFt;
+	if(alt_diff < 0) alt_diff *= -1;
+	if(mSurveillance.mode != xpmpTransponderMode_Mode3A && alt_diff > MAX_TCAS_ALTDIFF) {
+		mInstanceData->mTCAS = false;
+	}
+}
+
+float
+XPMPPlane::getCullRadius() const
+{
+	if (mInstanceData != nullptr && mInstanceData->mSuspended) {
+		return mBoundingRadius;
+	}
+	return mBoundingRadius * kCullRadiusMargin;
+}
+
+static bool
+isVisible(uint8_t visibility)
+{
+	const uint8_t visibleMask = CullVisibility_InFrustum | CullVisibility_InRange;
+	return (visibility & visibleMask) == visibleMask;
+}
+
+bool
+XPMPPlane::updateSuspension(const FrameContext &frame, const CullResult &cull)
+{
+	if (mCSL == nullptr || mInstanceData == nullptr) {
+		return false;
+	}
+	bool visible = (frame.config.cullMode == xpmpCullMode_None) || isVisible(cull.visibility);
+	if (!visible && mInstanceData->mSuspended && !mInstanceData->mReleased) {
+		// the instance is still in the scene where it was last drawn - if
+		// that's come into view, it has to be brought up to date.
+		float distanceSqr;
+		uint8_t drawnVisibility, lod;
+		CullKernel::run(frame.cullParams,
+		                &mInstanceData->mDrawnX, &mInstanceData->mDrawnY, &mInstanceData->mDrawnZ,
+		                &mBoundingRadius, 1,
+		                &distanceSqr, &drawnVisibility, &lod);
+		visible = isVisible(drawnVisibility);
+	}
+
+	if (visible) {
+		mInstanceData->mCulledSince = -1.0f;
+		if (mInstanceData->mSuspended) {
+			mInstanceData->mSuspended = false;
+			return true;
+		}
+		return false;
+	}
+	if (mInstanceData->mCulledSince < 0.0f) {
+		mInstanceData->mCulledSince = frame.elapsedTime;
+	}
+	if (!mInstanceData->mSuspended && (frame.elapsedTime - mInstanceData->mCulledSince) >= kCullSuspendDelay) {
+		mInstanceData->mSuspended = true;
+	}
+	return false;
+}
+
+bool
+XPMPPlane::isSuspended() const
+{
+	return mInstanceData != nullptr && mInstanceData->mSuspended;
+}
+
+void
+XPMPPlane::suspendInstanceUpdate(const FrameContext &frame)
+{
+	if (mCSL == nullptr || mInstanceData == nullptr || mInstanceData->mReleased) {
+		return;
+	}
+	if (frame.config.cullMode == xpmpCullMode_Release &&
+	    (frame.elapsedTime - mInstanceData->mCulledSince) >= (kCullSuspendDelay + kCullReleaseDelay)) {
+		mCSL->releaseInstance(mInstanceData);
+	}
+}
+
+bool
+XPMPPlane::needsFullUpdate() const
+{
+	return mCSL != nullptr &&
+		(mInstanceData == nullptr || mInstanceData->mPending || mInstanceData->mTerrainDeferred ||
+		 mInstanceData->mCreationDeferred);
+}
+
+bool
+XPMPPlane::needsTerrainProbe(const FrameContext &frame, const PlanePosition &position, float &outDistanceSqr) const
+{
+	if (mCSL == nullptr || mInstanceData == nullptr) {
+		return false;
+	}
+	outDistanceSqr = mInstanceData->mDistanceSqr;
+	return mCSL->needsTerrainProbe(frame, position.clampToGround, mInstanceData);
+}
+
+int
+XPMPPlane::countNewInstances(float &outDistanceSqr) const
+{
+	if (mCSL == nullptr || mInstanceData == nullptr) {
+		return 0;
+	}
+	outDistanceSqr = mInstanceData->mDistanceSqr;
+	return mCSL->countNewInstances(mInstanceData);
+}
+
+bool
+XPMPPlane::isWaitingForInstances() const
+{
+	return mInstanceData != nullptr && mInstanceData->mCreationDeferred;
+}
+
+void
+XPMPPlane::applyInstanceUpdate(const FrameContext &frame,
+                               const PlanePosition &position,
+                               float &outDistanceSqr,
+                               uint32_t &outFlags)
+{
+	if (mCSL != nullptr && mInstanceData != nullptr) {
+		mCSL->applyInstance(frame, position.clampToGround, mInstanceData);
+	}
+	publishState(outDistanceSqr, outFlags);
+}
+
+void
+XPMPPlane::publishState(float &outDistanceSqr, uint32_t &outFlags)
+{
+	outDistanceSqr = 0.0f;
+	outFlags &= ~PlaneFlag_RenderMask;
+	if (mCSL == nullptr || mInstanceData == nullptr) {
+		return;
+	}
+
+	outDistanceSqr = mInstanceData->mDistanceSqr;
+	if (mInstanceData->mCulled) {
+		outFlags |= PlaneFlag_Culled;
+	}
+	if (mInstanceData->mClamped) {
+		outFlags |= PlaneFlag_Clamped;
+	}
+	if (mInstanceData->mTCAS) {
+		outFlags |= PlaneFlag_TCAS;
+	}
+	refreshTCAS();
+}
+
+void
+XPMPPlane::refreshTCAS()
+{
+	if (mInstanceData == nullptr || !mInstanceData->mTCAS) {
+		return;
+	}
+	// populate the global TCAS list
+	TCAS::addPlane(
+		mInstanceData->mDistanceSqr,
+		mInstanceData->mX,
+		mInstanceData->mY,
+		mInstanceData->mZ,
+		mSurveillance.mode != xpmpTransponderMode_Mode3A);
 }
 
 void
@@ -25,25 +25,36 @@
 
 #include "XPMPMultiplayerVars.h"
 #include "PlaneType.h"
-#include "CullInfo.h"
-
-class XPMPMapRendering;
+#include "FrameContext.h"
+#include "LocalProjection.h"
+#include "XPMPPlaneStore.h"
 
+/** XPMPPlane holds the per-plane state that isn't touched every frame.
+ *
+ * The position, surfaces and per-frame render results live in the dense
+ * arrays of the XPMPPlaneStore and are passed in by the renderer.
+ */
 class XPMPPlane {
 private:
 	// world state
 	PlaneType			mPlaneType;
+	char				mLabel[32];
 
-	XPMPPlanePosition_t	mPosition;
-	XPMPPlaneSurfaces_t	mSurface;
 	XPMPPlaneSurveillance_t	mSurveillance;
 
 	// rendering data
 	CSL *				mCSL;
 	int					mMatchQuality;
+	float				mBoundingRadius;	// the CSL's bounding radius, for culling
+
+	// local (OpenGL) coordinates for this frame - see updateLocalPosition.
+	double				mLocalX;
+	double				mLocalY;
+	double				mLocalZ;
+
+	/** applies the transponder mode and altitude filters to the TCAS flag */
+	void maskTCAS(const FrameContext &frame, const PlanePosition &position);
 
-	friend void Render_PrepLists();
-	friend class XPMPMapRendering;
 public:
 	XPMPPlane();
 	virtual ~XPMPPlane();
@@ -61,17 +72,163 @@ public:
 	bool upgradeCSL(const PlaneType &type);
 	int  getMatchQuality();
 
-	void updatePosition(const XPMPPlanePosition_t &newPosition);
-	void updateSurfaces(const XPMPPlaneSurfaces_t &newSurfaces);
+	const char *getLabel() const;
+	void setLabel(const char *label);
+
 	void updateSurveillance(const XPMPPlaneSurveillance_t &newSurveillance);
 
-	/** Updates the specific plane's instance data and prepares it's tcas
-	 * (and culling flags for selfrendered models)
+	/** Updates the plane's local (OpenGL) coordinates from it's world
+	 * position.
+	 *
+	 * This only performs calculations, and is safe to call from the
+	 * renderer's worker threads.
+	 *
+	 * @param projection the projection for the current local frame
+	 * @param position the plane's position from the XPMPPlaneStore
+	 */
+	void updateLocalPosition(const LocalProjection &projection, const PlanePosition &position);
+
+	/** Returns the plane's local (OpenGL) coordinates as of the last
+	 * updateLocalPosition().
+	 */
+	void getLocalPosition(double &outX, double &outY, double &outZ) const;
+
+	/** Returns the position the plane is to be drawn at for culling.
+	 *
+	 * @param position the plane's position from the XPMPPlaneStore
+	 * @param reuseInstance if true, and the plane has been prepared before,
+	 *   the position it was last drawn at (after surface clamping).
+	 *   Otherwise, the position the next prepareInstanceUpdate will use.
+	 */
+	void getDrawPosition(const PlanePosition &position, bool reuseInstance,
+	                     float &outX, float &outY, float &outZ) const;
+
+	/** Prepares the specific plane's instance data and it's tcas and culling
+	 * flags.
+	 *
+	 * This only performs calculations, and is safe to call from the
+	 * renderer's worker threads.  updateLocalPosition() must have been called
+	 * for this frame first.
+	 *
+	 * @param frame the FrameContext from the rendering loop
+	 * @param cull the CullKernel results for getDrawPosition(position, false)
+	 * @param position the plane's position from the XPMPPlaneStore
+	 * @param surfaces the plane's surfaces from the XPMPPlaneStore
+	 */
+	void prepareInstanceUpdate(const FrameContext &frame,
+	                           const CullResult &cull,
+	                           const PlanePosition &position,
+	                           const XPMPPlaneSurfaces_t &surfaces);
+
+	/** Updates the distance dependent state of a plane whose position,
+	 * surfaces and lights haven't changed since it was last prepared.
+	 *
+	 * This only performs calculations, and is safe to call from the
+	 * renderer's worker threads.
+	 *
+	 * @param frame the FrameContext from the rendering loop
+	 * @param cull the CullKernel results for getDrawPosition(position, true)
+	 * @param position the plane's position from the XPMPPlaneStore
+	 * @return true if the plane must be fully prepared and applied after all
+	 *   (e.g. it needs a different level of detail).
+	 */
+	bool refreshInstanceUpdate(const FrameContext &frame,
+	                           const CullResult &cull,
+	                           const PlanePosition &position);
+
+	/** Returns the bounding radius to cull the plane with this frame.  Planes
+	 * that are being updated are given a margin, so they have to be well out
+	 * of view before they're suspended.
+	 */
+	float getCullRadius() const;
+
+	/** Updates the plane's culling state from it's CullKernel results,
+	 * suspending the instance updates of a plane that has been out of view
+	 * for long enough, and resuming them as soon as it's visible again.
 	 *
-	 * @param gl_camera the CullInfo from the rendering loop
-	 * @returns the square of the distance from the camera
+	 * This only performs calculations, and is safe to call from the
+	 * renderer's worker threads.
+	 *
+	 * @param frame the FrameContext from the rendering loop
+	 * @param cull the CullKernel results for the plane's current position,
+	 *   using getCullRadius()
+	 * @return true if the plane has just been resumed, and must be fully
+	 *   prepared and applied.
+	 */
+	bool updateSuspension(const FrameContext &frame, const CullResult &cull);
+
+	/** Returns true if the plane's instance updates are suspended */
+	bool isSuspended() const;
+
+	/** Takes the place of applyInstanceUpdate for a suspended plane -
+	 * the instance is left alone, or released if it's been suspended long
+	 * enough and the cull mode allows it.
+	 *
+	 * This calls into the XPLM, and must only be called from the main thread.
+	 *
+	 * @param frame the FrameContext from the rendering loop
+	 */
+	void suspendInstanceUpdate(const FrameContext &frame);
+
+	/** Returns true if the plane needs a full update regardless of it's dirty
+	 * state - because it's model has changed, or parts of it couldn't be
+	 * instanced (or it's terrain probe or instance creation was deferred)
+	 * last time.
+	 */
+	bool needsFullUpdate() const;
+
+	/** Returns true if applyInstanceUpdate will have to probe the terrain to
+	 * clamp the prepared instance.
+	 *
+	 * @param frame the FrameContext from the rendering loop
+	 * @param position the plane's position from the XPMPPlaneStore
+	 * @param outDistanceSqr set to the square of the prepared instance's
+	 *   distance from the camera, if a probe is needed
+	 */
+	bool needsTerrainProbe(const FrameContext &frame, const PlanePosition &position, float &outDistanceSqr) const;
+
+	/** Returns the number of instances applyInstanceUpdate will have to
+	 * create for the prepared instance.
+	 *
+	 * @param outDistanceSqr set to the square of the prepared instance's
+	 *   distance from the camera
+	 */
+	int countNewInstances(float &outDistanceSqr) const;
+
+	/** Returns true if the plane's last update was held back by the instance
+	 * creation budget.
+	 */
+	bool isWaitingForInstances() const;
+
+	/** Pushes the prepared instance data into the simulator and publishes
+	 * the plane's state.
+	 *
+	 * This calls into the XPLM, and must only be called from the main thread.
+	 *
+	 * @param frame the FrameContext from the rendering loop
+	 * @param position the plane's position from the XPMPPlaneStore
+	 * @param outDistanceSqr set to the square of the distance from the camera
+	 * @param outFlags the plane's PlaneFlags - the render flags are updated
+	 *   for this frame.
+	 */
+	void applyInstanceUpdate(const FrameContext &frame,
+	                         const PlanePosition &position,
+	                         float &outDistanceSqr,
+	                         uint32_t &outFlags);
+
+	/** Publishes the plane's distance and render flags, and records the
+	 * plane for TCAS if required, without touching the instance.
+	 *
+	 * @param outDistanceSqr set to the square of the distance from the camera
+	 * @param outFlags the plane's PlaneFlags - the render flags are updated
+	 *   for this frame.
+	 */
+	void publishState(float &outDistanceSqr, uint32_t &outFlags);
+
+	/** Re-adds the plane to the TCAS list using the results of it's last
+	 * instance update.  Used for planes the scheduler has skipped this frame.
 	 */
-	float doInstanceUpdate(const CullInfo &gl_camera);
+	void refreshTCAS();
 
 	// instanceData is public for the convenience of the main render loop only.
 	CSLInstanceData *	mInstanceData;
@@ -0,0 +1,437 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "XPMPPlaneStore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "PlaneKinematics.h"
+#include "XPMPPlane.h"
+
+using namespace std;
+
+// On 64-bit hosts, IDs are a 32-bit slot index and a 32-bit generation.  On
+// 32-bit hosts we have to make do with 20 bits of index and 12 of generation.
+static const unsigned int	kIndexBits = (sizeof(uintptr_t) >= 8) ? 32 : 20;
+static const uintptr_t		kIndexMask = (static_cast<uintptr_t>(1) << kIndexBits) - 1;
+static const uint32_t		kGenerationMask = (sizeof(uintptr_t) >= 8) ? 0xFFFFFFFFU : 0xFFFU;
+
+XPMPPlaneStore::XPMPPlaneStore() :
+	mSlotLimit(0),
+	mKinematicsCount(0)
+{
+}
+
+XPMPPlaneStore::~XPMPPlaneStore() = default;
+
+XPMPPlaneID
+XPMPPlaneStore::makeID(index_type slot, uint32_t generation)
+{
+	return reinterpret_cast<XPMPPlaneID>(
+		(static_cast<uintptr_t>(generation) << kIndexBits) | static_cast<uintptr_t>(slot));
+}
+
+bool
+XPMPPlaneStore::splitID(XPMPPlaneID id, index_type &slot, uint32_t &generation)
+{
+	auto raw = reinterpret_cast<uintptr_t>(id);
+	slot = static_cast<index_type>(raw & kIndexMask);
+	generation = static_cast<uint32_t>(raw >> kIndexBits) & kGenerationMask;
+	// generation 0 is never issued, so this also rejects null.
+	return generation != 0;
+}
+
+uint32_t
+XPMPPlaneStore::nextGeneration(uint32_t generation)
+{
+	generation = (generation + 1) & kGenerationMask;
+	return (generation == 0) ? 1 : generation;
+}
+
+XPMPPlaneID
+XPMPPlaneStore::reserveID()
+{
+	lock_guard<mutex> lock(mFreeMutex);
+	if (!mFreeSlots.empty()) {
+		const auto freeSlot = mFreeSlots.back();
+		mFreeSlots.pop_back();
+		return makeID(freeSlot.slot, freeSlot.generation);
+	}
+	// the slot table itself is only grown by the main thread, when the plane
+	// is inserted.
+	return makeID(mSlotLimit++, 1);
+}
+
+void
+XPMPPlaneStore::release(XPMPPlaneID id)
+{
+	index_type	slot;
+	uint32_t	generation;
+	if (!splitID(id, slot, generation)) {
+		return;
+	}
+	lock_guard<mutex> lock(mFreeMutex);
+	mFreeSlots.push_back(FreeSlot{slot, nextGeneration(generation)});
+}
+
+void
+XPMPPlaneStore::retireSlot(index_type slot)
+{
+	// bumping the generation invalidates outstanding IDs
+	mSlots[slot].denseIndex = kInvalidIndex;
+	mSlots[slot].generation = nextGeneration(mSlots[slot].generation);
+
+	lock_guard<mutex> lock(mFreeMutex);
+	mFreeSlots.push_back(FreeSlot{slot, mSlots[slot].generation});
+}
+
+void
+XPMPPlaneStore::insert(XPMPPlaneID id, std::unique_ptr<XPMPPlane> plane)
+{
+	index_type	slot;
+	uint32_t	generation;
+	if (!splitID(id, slot, generation)) {
+		return;
+	}
+	if (slot >= mSlots.size()) {
+		// slots reserved but not yet inserted stay invalid.
+		mSlots.resize(slot + 1, Slot{kInvalidIndex, 0});
+	}
+	auto denseIndex = static_cast<index_type>(mPlanes.size());
+	mSlots[slot] = Slot{denseIndex, generation};
+
+	mSlotOf.push_back(slot);
+	mPositions.push_back(PlanePosition{});
+	mSurfaces.push_back(XPMPPlaneSurfaces_t{});
+	mDistanceSqr.push_back(0.0f);
+	mFlags.push_back(PlaneFlag_DirtyMask);
+	mLastUpdate.push_back(0);
+	mKinematics.emplace_back();
+	mPlanes.push_back(std::move(plane));
+	mGrid.insert(slot, 0.0, 0.0);
+}
+
+XPMPPlaneStore::index_type
+XPMPPlaneStore::indexOf(XPMPPlaneID id) const
+{
+	index_type	slot;
+	uint32_t	generation;
+	if (!splitID(id, slot, generation) || slot >= mSlots.size()) {
+		return kInvalidIndex;
+	}
+	if (mSlots[slot].generation != generation) {
+		return kInvalidIndex;
+	}
+	return mSlots[slot].denseIndex;
+}
+
+XPMPPlane *
+XPMPPlaneStore::find(XPMPPlaneID id) const
+{
+	auto i = indexOf(id);
+	if (i == kInvalidIndex) {
+		return nullptr;
+	}
+	return mPlanes[i].get();
+}
+
+XPMPPlaneID
+XPMPPlaneStore::idAt(index_type i) const
+{
+	const auto slot = mSlotOf[i];
+	return makeID(slot, mSlots[slot].generation);
+}
+
+bool
+XPMPPlaneStore::erase(XPMPPlaneID id)
+{
+	auto i = indexOf(id);
+	if (i == kInvalidIndex) {
+		return false;
+	}
+	const auto slot = mSlotOf[i];
+	const auto last = static_cast<index_type>(mPlanes.size() - 1);
+	if (mKinematics[i]) {
+		mKinematicsCount--;
+	}
+
+	// move the last plane into the hole.
+	if (i != last) {
+		mSlotOf[i] = mSlotOf[last];
+		mPositions[i] = mPositions[last];
+		mSurfaces[i] = mSurfaces[last];
+		mDistanceSqr[i] = mDistanceSqr[last];
+		mFlags[i] = mFlags[last];
+		mLastUpdate[i] = mLastUpdate[last];
+		mKinematics[i] = std::move(mKinematics[last]);
+		mPlanes[i] = std::move(mPlanes[last]);
+		mSlots[mSlotOf[i]].denseIndex = i;
+	}
+	mSlotOf.pop_back();
+	mPositions.pop_back();
+	mSurfaces.pop_back();
+	mDistanceSqr.pop_back();
+	mFlags.pop_back();
+	mLastUpdate.pop_back();
+	mKinematics.pop_back();
+	mPlanes.pop_back();
+	mGrid.erase(slot);
+	retireSlot(slot);
+	return true;
+}
+
+void
+XPMPPlaneStore::clear()
+{
+	// destroy the planes first whilst the rest of the store is still intact.
+	mPlanes.clear();
+	for (auto slot: mSlotOf) {
+		retireSlot(slot);
+	}
+	mSlotOf.clear();
+	mPositions.clear();
+	mSurfaces.clear();
+	mDistanceSqr.clear();
+	mFlags.clear();
+	mLastUpdate.clear();
+	mKinematics.clear();
+	mKinematicsCount = 0;
+	mGrid.clear();
+}
+
+void
+XPMPPlaneStore::updatePosition(index_type i, const XPMPPlanePosition_t &newPosition)
+{
+	const XPMPPlanePosition_t *src = &newPosition;
+
+	// short records from older clients only overwrite the fields they have.
+	XPMPPlanePosition_t merged;
+	if (newPosition.size < sizeof(merged)) {
+		const auto &cur = mPositions[i];
+		merged.size = sizeof(merged);
+		merged.lat = cur.lat;
+		merged.lon = cur.lon;
+		merged.elevation = cur.elevation;
+		merged.pitch = cur.pitch;
+		merged.roll = cur.roll;
+		merged.heading = cur.heading;
+		strncpy(merged.label, mPlanes[i]->getLabel(), sizeof(merged.label) - 1);
+		merged.label[sizeof(merged.label) - 1] = '\0';
+		merged.offsetScale = cur.offsetScale;
+		merged.clampToGround = cur.clampToGround;
+		memcpy(&merged, &newPosition, newPosition.size);
+		src = &merged;
+	}
+
+	PlanePosition position;
+	position.lat = src->lat;
+	position.lon = src->lon;
+	position.elevation = src->elevation;
+	position.pitch = src->pitch;
+	position.roll = src->roll;
+	position.heading = src->heading;
+	position.offsetScale = src->offsetScale;
+	position.clampToGround = src->clampToGround;
+	setPosition(i, position);
+	mPlanes[i]->setLabel(src->label);
+}
+
+void
+XPMPPlaneStore::setPosition(index_type i, const PlanePosition &newPosition)
+{
+	auto &dst = mPositions[i];
+	if (dst.lat != newPosition.lat || dst.lon != newPosition.lon || dst.elevation != newPosition.elevation ||
+		dst.pitch != newPosition.pitch || dst.roll != newPosition.roll || dst.heading != newPosition.heading ||
+		dst.offsetScale != newPosition.offsetScale || dst.clampToGround != newPosition.clampToGround) {
+		mFlags[i] |= PlaneFlag_PositionDirty;
+	}
+	if (dst.lat != newPosition.lat || dst.lon != newPosition.lon) {
+		mGrid.move(mSlotOf[i], newPosition.lat, newPosition.lon);
+	}
+	dst = newPosition;
+}
+
+void
+XPMPPlaneStore::updateSurfaces(index_type i, const XPMPPlaneSurfaces_t &newSurfaces)
+{
+	XPMPPlaneSurfaces_t merged = mSurfaces[i];
+	memcpy(&merged, &newSurfaces, min(newSurfaces.size, sizeof(XPMPPlaneSurfaces_t)));
+	merged.size = sizeof(merged);
+	setSurfaces(i, merged);
+}
+
+void
+XPMPPlaneStore::setSurfaces(index_type i, const XPMPPlaneSurfaces_t &merged)
+{
+	auto &dst = mSurfaces[i];
+	const auto oldLights = dst.lights.lightFlags;
+
+	if (merged.gearPosition != dst.gearPosition || merged.flapRatio != dst.flapRatio ||
+		merged.spoilerRatio != dst.spoilerRatio || merged.speedBrakeRatio != dst.speedBrakeRatio ||
+		merged.slatRatio != dst.slatRatio || merged.wingSweep != dst.wingSweep ||
+		merged.thrust != dst.thrust || merged.yokePitch != dst.yokePitch ||
+		merged.yokeHeading != dst.yokeHeading || merged.yokeRoll != dst.yokeRoll) {
+		mFlags[i] |= PlaneFlag_SurfacesDirty;
+	}
+	if (merged.lights.lightFlags != oldLights) {
+		mFlags[i] |= PlaneFlag_LightsDirty;
+	}
+	dst = merged;
+}
+
+void
+XPMPPlaneStore::updateKinematics(index_type i, const XPMPPlaneKinematics_t &sample)
+{
+	if (!mKinematics[i]) {
+		mKinematics[i].reset(new PlaneKinematics());
+		mKinematicsCount++;
+	}
+	mKinematics[i]->addSample(sample, mSurfaces[i]);
+}
+
+// the mean radius of the earth in meters
+static const double	kEarthRadius = 6371008.8;
+static const double	kPi = 3.14159265358979323846;
+static const double	kDegToRad = kPi / 180.0;
+
+static double
+greatCircleDistance(double lat1, double lon1, double lat2, double lon2)
+{
+	const double sinDLat = sin((lat2 - lat1) * kDegToRad / 2.0);
+	const double sinDLon = sin((lon2 - lon1) * kDegToRad / 2.0);
+	const double a = sinDLat * sinDLat + cos(lat1 * kDegToRad) * cos(lat2 * kDegToRad) * sinDLon * sinDLon;
+	return 2.0 * kEarthRadius * asin(min(1.0, sqrt(a)));
+}
+
+void
+XPMPPlaneStore::queryBox(double latMin, double lonMin, double latMax, double lonMax,
+                         std::vector<index_type> &outIndices) const
+{
+	outIndices.clear();
+	if (lonMax < lonMin) {
+		lonMax += 360.0;
+	}
+	// bring lonMin into [-180, 180) so positions only ever need unwrapping
+	// in one direction.
+	const double lonSpan = lonMax - lonMin;
+	lonMin = fmod(lonMin + 180.0, 360.0);
+	if (lonMin < 0.0) {
+		lonMin += 360.0;
+	}
+	lonMin -= 180.0;
+	lonMax = lonMin + lonSpan;
+
+	mQuerySlots.clear();
+	mGrid.collectBox(latMin, lonMin, latMax, lonMax, mQuerySlots);
+	for (auto slot: mQuerySlots) {
+		const auto i = mSlots[slot].denseIndex;
+		const auto &position = mPositions[i];
+		if (position.lat < latMin || position.lat > latMax) {
+			continue;
+		}
+		double lon = position.lon;
+		if (lon < lonMin) {
+			lon += 360.0;
+		}
+		if (lon <= lonMax) {
+			outIndices.push_back(i);
+		}
+	}
+}
+
+void
+XPMPPlaneStore::queryRadius(double lat, double lon, double radiusM,
+                            std::vector<index_type> &outIndices) const
+{
+	outIndices.clear();
+	mQuerySlots.clear();
+
+	// find the box around the circle - near the poles (or for very large
+	// circles) that's every longitude.
+	const double latSpan = radiusM / (kEarthRadius * kDegToRad);
+	const double latMin = max(-90.0, lat - latSpan);
+	const double latMax = min(90.0, lat + latSpan);
+	const double cosLat = cos(max(fabs(latMin), fabs(latMax)) * kDegToRad);
+	double lonSpan = 180.0;
+	if (latMin > -90.0 && latMax < 90.0 && cosLat > 0.0) {
+		lonSpan = min(180.0, latSpan / cosLat);
+	}
+	mGrid.collectBox(latMin, lon - lonSpan, latMax, lon + lonSpan, mQuerySlots);
+
+	for (auto slot: mQuerySlots) {
+		const auto i = mSlots[slot].denseIndex;
+		const auto &position = mPositions[i];
+		if (greatCircleDistance(lat, lon, position.lat, position.lon) <= radiusM) {
+			outIndices.push_back(i);
+		}
+	}
+}
+
+void
+XPMPPlaneStore::queryNearest(double lat, double lon, size_t count,
+                             std::vector<index_type> &outIndices,
+                             std::vector<double> *outDistances) const
+{
+	outIndices.clear();
+	if (outDistances != nullptr) {
+		outDistances->clear();
+	}
+	if (count == 0 || mPlanes.empty()) {
+		return;
+	}
+
+	// widen the search until it has found enough planes - the nearest count
+	// planes must then be amongst them.
+	static const double kFirstRadius = 10000.0;
+	const double maxRadius = kPi * kEarthRadius;
+	vector<index_type> candidates;
+	for (double radius = kFirstRadius; ; radius *= 4.0) {
+		if (radius >= maxRadius) {
+			candidates.resize(mPlanes.size());
+			for (index_type i = 0; i < candidates.size(); i++) {
+				candidates[i] = i;
+			}
+			break;
+		}
+		queryRadius(lat, lon, radius, candidates);
+		if (candidates.size() >= count) {
+			break;
+		}
+	}
+
+	vector<pair<double, index_type>> byDistance;
+	byDistance.reserve(candidates.size());
+	for (auto i: candidates) {
+		byDistance.emplace_back(greatCircleDistance(lat, lon, mPositions[i].lat, mPositions[i].lon), i);
+	}
+	count = min(count, byDistance.size());
+	partial_sort(byDistance.begin(), byDistance.begin() + count, byDistance.end());
+	for (size_t n = 0; n < count; n++) {
+		outIndices.push_back(byDistance[n].second);
+		if (outDistances != nullptr) {
+			outDistances->push_back(byDistance[n].first);
+		}
+	}
+}
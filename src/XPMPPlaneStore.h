@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2020, Chris Collins.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef XPMPPLANESTORE_H
+#define XPMPPLANESTORE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "XPMPMultiplayer.h"
+#include "SpatialGrid.h"
+
+class XPMPPlane;
+class PlaneKinematics;
+
+/** PlanePosition is the per-frame part of XPMPPlanePosition_t.  The label is
+ * only needed by the map, so it's kept with the rest of the plane.
+ */
+struct PlanePosition {
+	double	lat;
+	double	lon;
+	double	elevation;
+	float	pitch;
+	float	roll;
+	float	heading;
+	float	offsetScale;
+	bool	clampToGround;
+};
+
+/** PlaneFlags are the per-frame render results and the dirty state kept with
+ * the hot plane data
+ */
+enum PlaneFlags : uint32_t {
+	PlaneFlag_TCAS =			1U << 0,	// plane is eligible for TCAS this frame
+	PlaneFlag_Culled =			1U << 1,	// plane is beyond the visibility
+	PlaneFlag_Clamped =			1U << 2,	// plane was clamped to the surface
+
+	PlaneFlag_PositionDirty =	1U << 8,	// position has changed since the last full update
+	PlaneFlag_SurfacesDirty =	1U << 9,	// surfaces (other than lights) have changed
+	PlaneFlag_LightsDirty =		1U << 10,	// lights have changed
+
+	PlaneFlag_RenderMask = PlaneFlag_TCAS | PlaneFlag_Culled | PlaneFlag_Clamped,
+	PlaneFlag_DirtyMask = PlaneFlag_PositionDirty | PlaneFlag_SurfacesDirty | PlaneFlag_LightsDirty,
+};
+
+/** XPMPPlaneStore is a slot map holding all of the planes.
+ *
+ * The XPMPPlaneIDs it issues are generational handles - a slot index and the
+ * generation of that slot, so stale IDs are detected in constant time.
+ *
+ * The data touched every frame is kept in dense, parallel arrays indexed
+ * from 0 to size()-1 so the renderer and map can walk it linearly.  Erasing a
+ * plane moves the last plane into its place, so dense indices are only stable
+ * until the next erase.
+ *
+ * Apart from reserveID() and release(), which may be called from any thread,
+ * the store must only be used from the main thread.
+ */
+class XPMPPlaneStore {
+public:
+	using index_type = uint32_t;
+	static const index_type kInvalidIndex = UINT32_MAX;
+
+	XPMPPlaneStore();
+	XPMPPlaneStore(const XPMPPlaneStore &copySrc) = delete;
+	~XPMPPlaneStore();
+
+	/** insert takes ownership of the plane and files it under an ID from
+	 * reserveID().
+	 */
+	void			insert(XPMPPlaneID id, std::unique_ptr<XPMPPlane> plane);
+
+	/** reserveID issues a new ID without creating a plane for it, so a plane
+	 * can be created under it later.  Until then, the ID is treated as stale.
+	 *
+	 * This is safe to call from any thread.
+	 */
+	XPMPPlaneID		reserveID();
+
+	/** release gives back an ID from reserveID() that was never used.
+	 *
+	 * This is safe to call from any thread.
+	 */
+	void			release(XPMPPlaneID id);
+
+	/** erase destroys the plane referred to by id.
+	 *
+	 * @return true if the plane existed, false if the id was stale.
+	 */
+	bool			erase(XPMPPlaneID id);
+
+	/** clear destroys all planes.  All outstanding IDs become stale. */
+	void			clear();
+
+	/** indexOf returns the dense index of the plane referred to by id, or
+	 * kInvalidIndex if the id is stale or invalid.
+	 */
+	index_type		indexOf(XPMPPlaneID id) const;
+
+	/** find returns the plane referred to by id, or nullptr if the id is stale
+	 * or invalid.
+	 */
+	XPMPPlane *		find(XPMPPlaneID id) const;
+
+	size_t			size() const { return mPlanes.size(); }
+	bool			empty() const { return mPlanes.empty(); }
+
+	XPMPPlaneID		idAt(index_type i) const;
+	XPMPPlane *		planeAt(index_type i) const { return mPlanes[i].get(); }
+
+	PlanePosition &			positionAt(index_type i) { return mPositions[i]; }
+	const PlanePosition &	positionAt(index_type i) const { return mPositions[i]; }
+	XPMPPlaneSurfaces_t &		surfacesAt(index_type i) { return mSurfaces[i]; }
+	const XPMPPlaneSurfaces_t &	surfacesAt(index_type i) const { return mSurfaces[i]; }
+	float &			distanceSqrAt(index_type i) { return mDistanceSqr[i]; }
+	float			distanceSqrAt(index_type i) const { return mDistanceSqr[i]; }
+	uint32_t &		flagsAt(index_type i) { return mFlags[i]; }
+	uint32_t		flagsAt(index_type i) const { return mFlags[i]; }
+	uint32_t &		lastUpdateAt(index_type i) { return mLastUpdate[i]; }
+	uint32_t		lastUpdateAt(index_type i) const { return mLastUpdate[i]; }
+	/** kinematicsAt returns the plane's kinematics history, or nullptr if
+	 * it's positioned directly.
+	 */
+	PlaneKinematics *	kinematicsAt(index_type i) const { return mKinematics[i].get(); }
+
+	/** returns the number of planes with a kinematics history */
+	size_t			kinematicsCount() const { return mKinematicsCount; }
+
+	/** updatePosition copies the client's position record into the plane at
+	 * dense index i, honouring the record's size.  The plane is marked
+	 * position dirty only if the position actually changed.
+	 */
+	void			updatePosition(index_type i, const XPMPPlanePosition_t &newPosition);
+
+	/** updateSurfaces copies the client's surfaces record into the plane at
+	 * dense index i, honouring the record's size.  The plane is marked
+	 * surfaces and/or lights dirty only if they actually changed.
+	 */
+	void			updateSurfaces(index_type i, const XPMPPlaneSurfaces_t &newSurfaces);
+
+	/** updateKinematics adds the client's position sample to the plane at
+	 * dense index i, along with it's current surfaces.  From then on, the
+	 * plane's position comes from it's kinematics history.
+	 */
+	void			updateKinematics(index_type i, const XPMPPlaneKinematics_t &sample);
+
+	/** setPosition sets the position of the plane at dense index i, marking
+	 * it position dirty if it's changed.
+	 */
+	void			setPosition(index_type i, const PlanePosition &newPosition);
+
+	/** setSurfaces sets the surfaces of the plane at dense index i, marking
+	 * the surfaces and/or lights dirty if they've changed.
+	 */
+	void			setSurfaces(index_type i, const XPMPPlaneSurfaces_t &newSurfaces);
+
+	/** queryBox finds the planes within a latitude/longitude box.
+	 *
+	 * @param latMin,latMax the latitude range, in degrees
+	 * @param lonMin,lonMax the longitude range, in degrees.  If lonMin is
+	 *   greater than lonMax, the box crosses the antimeridian.
+	 * @param outIndices receives the dense indices of the planes, in no
+	 *   particular order
+	 */
+	void			queryBox(double latMin, double lonMin, double latMax, double lonMax,
+	                         std::vector<index_type> &outIndices) const;
+
+	/** queryRadius finds the planes within radiusM meters (great circle
+	 * distance) of a point.
+	 *
+	 * @param outIndices receives the dense indices of the planes, in no
+	 *   particular order
+	 */
+	void			queryRadius(double lat, double lon, double radiusM,
+	                            std::vector<index_type> &outIndices) const;
+
+	/** queryNearest finds the (up to) count planes nearest to a point.
+	 *
+	 * @param outIndices receives the dense indices of the planes, nearest
+	 *   first
+	 * @param outDistances if not null, receives the great circle distance to
+	 *   each plane in meters
+	 */
+	void			queryNearest(double lat, double lon, size_t count,
+	                             std::vector<index_type> &outIndices,
+	                             std::vector<double> *outDistances = nullptr) const;
+
+private:
+	struct Slot {
+		index_type	denseIndex;
+		uint32_t	generation;
+	};
+
+	/** FreeSlot is a slot waiting to be reissued, with the generation it's
+	 * next ID will have.
+	 */
+	struct FreeSlot {
+		index_type	slot;
+		uint32_t	generation;
+	};
+
+	std::vector<Slot>			mSlots;
+
+	// the slots available to reserveID().  These are the only members other
+	// threads touch.
+	std::mutex					mFreeMutex;
+	std::vector<FreeSlot>		mFreeSlots;
+	index_type					mSlotLimit;		// slots below this have been issued at least once
+
+	// dense storage - all of these are the same length.
+	std::vector<index_type>						mSlotOf;
+	std::vector<PlanePosition>					mPositions;
+	std::vector<XPMPPlaneSurfaces_t>			mSurfaces;
+	std::vector<float>							mDistanceSqr;
+	std::vector<uint32_t>						mFlags;
+	std::vector<uint32_t>						mLastUpdate;	// scheduler frame of the last instance update, 0 if never
+	std::vector<std::unique_ptr<PlaneKinematics>>	mKinematics;
+	size_t										mKinematicsCount;
+	std::vector<std::unique_ptr<XPMPPlane>>		mPlanes;
+
+	SpatialGrid		mGrid;		// by slot
+	mutable std::vector<index_type>		mQuerySlots;	// scratch for the queries
+
+	static XPMPPlaneID	makeID(index_type slot, uint32_t generation);
+	static bool			splitID(XPMPPlaneID id, index_type &slot, uint32_t &generation);
+	static uint32_t		nextGeneration(uint32_t generation);
+
+	/** retireSlot invalidates the IDs issued for slot and makes it available
+	 * to reserveID() again.
+	 */
+	void				retireSlot(index_type slot);
+};
+
+#endif //XPMPPLANESTORE_H
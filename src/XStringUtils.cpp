@@ -34,35 +34,94 @@ namespace xpmp {
 	vector<string>
     tokenize(const string &str, const string &delim, int n)
 	{
-		string			dup = str;
 		vector<string>	result;
 		if (delim.empty() || n == 1)
 		{
-			result.emplace_back(std::move(dup));
-			return std::move(result);
+			result.push_back(str);
+			return result;
 		}
 
-		if (dup.empty()) return std::move(result);
-
+		size_t start = 0;
 		while (true)
 		{
-			auto 	position = dup.find_first_of(delim);
-			string	token = dup.substr(0, position);
+			if (start >= str.size()) return result;
 
-			if (!token.empty())
+			const auto position = str.find_first_of(delim, start);
+			if (position != start)
 			{
-				result.emplace_back(std::move(token));
+				result.emplace_back(str, start, position - start);
 			}
 
 			// Nothing remaining
-			if (position == string::npos) return std::move(result);
+			if (position == string::npos) return result;
+
+			start = position + 1;
+			if (n > 0 && result.size() >= static_cast<size_t>(n - 1)) {
+			    result.emplace_back(str, start);
+			    return result;
+			}
+		}
+	}
+
+	bool
+	LineScanner::next(StringRef &outLine)
+	{
+		if (mPos >= mEnd) {
+			return false;
+		}
+		const char *lineEnd = mPos;
+		while (lineEnd < mEnd && *lineEnd != '\n' && *lineEnd != '\r') {
+			++lineEnd;
+		}
+		outLine = StringRef(mPos, static_cast<size_t>(lineEnd - mPos));
+
+		mPos = lineEnd;
+		if (mPos < mEnd && *mPos == '\r') {
+			++mPos;
+		}
+		if (mPos < mEnd && *mPos == '\n') {
+			++mPos;
+		}
+		return true;
+	}
+
+	void
+	tokenize(StringRef str, const char *delim, vector<StringRef> &outTokens)
+	{
+		// a table, rather than strchr for every character.
+		bool isDelim[256] = {};
+		for (const char *d = delim; *d != '\0'; ++d) {
+			isDelim[static_cast<unsigned char>(*d)] = true;
+		}
 
-			dup = dup.substr(position + 1);
-			if (n > 0 && result.size() >= (n-1)) {
-			    result.emplace_back(std::move(dup));
-			    return std::move(result);
+		const char *pos = str.begin();
+		const char *end = str.end();
+		while (pos < end) {
+			while (pos < end && isDelim[static_cast<unsigned char>(*pos)]) {
+				++pos;
+			}
+			const char *tokenStart = pos;
+			while (pos < end && !isDelim[static_cast<unsigned char>(*pos)]) {
+				++pos;
 			}
+			if (pos > tokenStart) {
+				outTokens.emplace_back(tokenStart, static_cast<size_t>(pos - tokenStart));
+			}
+		}
+	}
+
+	StringRef
+	trim(StringRef str)
+	{
+		const char *begin = str.begin();
+		const char *end = str.end();
+		while (begin < end && isspace(static_cast<unsigned char>(*begin))) {
+			++begin;
+		}
+		while (end > begin && isspace(static_cast<unsigned char>(end[-1]))) {
+			--end;
 		}
+		return StringRef(begin, static_cast<size_t>(end - begin));
 	}
 
 	// trim from start (in place)
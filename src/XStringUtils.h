@@ -24,10 +24,98 @@
 #ifndef STRING_UTILS_H
 #define STRING_UTILS_H
 
+#include <cstddef>
+#include <cstring>
 #include <string>
 #include <vector>
 
 namespace xpmp {
+	/** StringRef is a view of a run of characters owned by something else -
+	 * usually a file read into memory - so it can be split up without copying.
+	 *
+	 * It isn't null terminated, and is only valid as long as the characters
+	 * it refers to.
+	 */
+	class StringRef {
+	public:
+		StringRef() :
+			mData(nullptr),
+			mSize(0)
+		{
+		}
+
+		StringRef(const char *data, size_t size) :
+			mData(data),
+			mSize(size)
+		{
+		}
+
+		StringRef(const char *str) :
+			mData(str),
+			mSize(strlen(str))
+		{
+		}
+
+		StringRef(const std::string &str) :
+			mData(str.data()),
+			mSize(str.size())
+		{
+		}
+
+		const char *	data() const { return mData; }
+		size_t			size() const { return mSize; }
+		bool			empty() const { return mSize == 0; }
+		const char *	begin() const { return mData; }
+		const char *	end() const { return mData + mSize; }
+		char			operator[](size_t i) const { return mData[i]; }
+
+		/** returns a copy of the characters */
+		std::string		str() const { return std::string(mData, mSize); }
+
+		bool	operator==(const StringRef &rhs) const
+		{
+			return mSize == rhs.mSize && (mSize == 0 || memcmp(mData, rhs.mData, mSize) == 0);
+		}
+		bool	operator!=(const StringRef &rhs) const { return !(*this == rhs); }
+
+	private:
+		const char *	mData;
+		size_t			mSize;
+	};
+
+	inline bool operator==(const std::string &lhs, const StringRef &rhs) { return StringRef(lhs) == rhs; }
+	inline bool operator!=(const std::string &lhs, const StringRef &rhs) { return StringRef(lhs) != rhs; }
+
+	/** LineScanner splits a buffer into lines without copying it.  \n, \r\n
+	 * and \r line endings are all accepted, and aren't part of the lines.
+	 */
+	class LineScanner {
+	public:
+		explicit LineScanner(StringRef buffer) :
+			mPos(buffer.begin()),
+			mEnd(buffer.end())
+		{
+		}
+
+		/** next finds the next line.
+		 *
+		 * @return false once the buffer is used up.
+		 */
+		bool	next(StringRef &outLine);
+
+	private:
+		const char *	mPos;
+		const char *	mEnd;
+	};
+
+	/** tokenize splits str at any of the characters in delim, appending the
+	 * non-empty tokens to outTokens.  The tokens refer to str's characters.
+	 */
+	void	tokenize(StringRef str, const char *delim, std::vector<StringRef> &outTokens);
+
+	/** trim returns str without any leading or trailing whitespace */
+	StringRef	trim(StringRef str);
+
 	/** tokenize takes the string and splits it into no more than n tokens.
      *
      * @param str the string to split
@@ -29,6 +29,7 @@
 #include <XPLMUtilities.h>
 
 #include "XPMPMultiplayer.h"
+#include "XStringUtils.h"
 
 void	StringToUpper(std::string&);
 
@@ -36,53 +37,97 @@ bool	HasExtNoCase(const std::string& inStr, const char * inExt);
 
 bool    DoesFileExist(const std::string &filePath);
 
+/** XPLMDumpCapture redirects everything the current thread sends through
+ * XPLMDump into a string for as long as it's in scope, so work done off the
+ * main thread (where the XPLM can't be used) can be logged from it later.
+ */
+class XPLMDumpCapture {
+public:
+	explicit XPLMDumpCapture(std::string &outLog) :
+		mPrevious(sink())
+	{
+		sink() = &outLog;
+	}
+
+	XPLMDumpCapture(const XPLMDumpCapture &copySrc) = delete;
+
+	~XPLMDumpCapture()
+	{
+		sink() = mPrevious;
+	}
+
+	/** returns the string the current thread's output is captured to, or
+	 * nullptr if it isn't being captured.
+	 */
+	static std::string *&sink()
+	{
+		static thread_local std::string *sSink = nullptr;
+		return sSink;
+	}
+
+private:
+	std::string *	mPrevious;
+};
+
 struct XPLMDump {
 	XPLMDump() { }
 
 	XPLMDump(const std::string& inFileName, int lineNum, const char * line) {
-		XPLMDebugString(XPMP_CLIENT_NAME " WARNING: Parse Error in file ");
-		XPLMDebugString(inFileName.c_str());
-		XPLMDebugString(" line ");
+		write(XPMP_CLIENT_NAME " WARNING: Parse Error in file ");
+		write(inFileName.c_str());
+		write(" line ");
 		char buf[32];
 		sprintf(buf,"%d", lineNum);
-		XPLMDebugString(buf);
-		XPLMDebugString(".\n              ");
-		XPLMDebugString(line);
-		XPLMDebugString(".\n");
+		write(buf);
+		write(".\n              ");
+		write(line);
+		write(".\n");
 	}
 
-	XPLMDump(const std::string& inFileName, int lineNum, const std::string& line) {
-		XPLMDebugString(XPMP_CLIENT_NAME " WARNING: Parse Error in file ");
-		XPLMDebugString(inFileName.c_str());
-		XPLMDebugString(" line ");
-		char buf[32];
-		sprintf(buf,"%d", lineNum);
-		XPLMDebugString(buf);
-		XPLMDebugString(".\n              ");
-		XPLMDebugString(line.c_str());
-		XPLMDebugString(".\n");
+	XPLMDump(const std::string& inFileName, int lineNum, const std::string& line) :
+		XPLMDump(inFileName, lineNum, line.c_str())
+	{
+	}
+
+	XPLMDump(const std::string& inFileName, int lineNum, xpmp::StringRef line) :
+		XPLMDump(inFileName, lineNum, line.str())
+	{
 	}
 
 	XPLMDump& operator<<(const char * rhs) {
-		XPLMDebugString(rhs);
+		write(rhs);
 		return *this;
 	}
 	XPLMDump& operator<<(const std::string& rhs) {
-		XPLMDebugString(rhs.c_str());
+		write(rhs.c_str());
+		return *this;
+	}
+	XPLMDump& operator<<(xpmp::StringRef rhs) {
+		write(rhs.str().c_str());
 		return *this;
 	}
 	XPLMDump& operator<<(int n) {
 		char buf[255];
 		sprintf(buf, "%d", n);
-		XPLMDebugString(buf);
+		write(buf);
 		return *this;
 	}
 	XPLMDump& operator<<(size_t n) {
 		char buf[255];
 		sprintf(buf, "%u", static_cast<unsigned>(n));
-		XPLMDebugString(buf);
+		write(buf);
 		return *this;
 	}
+
+private:
+	static void write(const char *str) {
+		auto *capture = XPLMDumpCapture::sink();
+		if (capture != nullptr) {
+			*capture += str;
+		} else {
+			XPLMDebugString(str);
+		}
+	}
 };
 
 #endif
@@ -24,17 +24,50 @@
 
 #include "Obj8Attachment.h"
 
-#include <queue>
+#include <algorithm>
+#include <limits>
 #include <XPLMScenery.h>
 #include <XUtils.h>
 
-std::queue<Obj8Attachment *>	Obj8Attachment::loadQueue;
+#include "Obj8CSL.h"
+#include "RenderStats.h"
+
+std::vector<Obj8Attachment *>   Obj8Attachment::sLoadQueue;
+std::vector<Obj8Attachment::LoadInFlight> Obj8Attachment::sLoading;
+std::uintptr_t                  Obj8Attachment::sNextLoadId = 1;
+unsigned int                    Obj8Attachment::sLoadFrame = 0;
+std::vector<Obj8Attachment *>   Obj8Attachment::sLoaded;
 std::unordered_map<std::string,std::weak_ptr<Obj8Attachment>> Obj8Attachment::sAttachmentCache;
+std::mutex                      Obj8Attachment::sAttachmentCacheMutex;
+std::vector<Obj8Attachment *>   Obj8Attachment::sPooled;
+float                           Obj8Attachment::sNow = 0.0f;
+int                             Obj8Attachment::sCreationsLeft = -1;
+float                           Obj8Attachment::sCreationCutoffSqr = std::numeric_limits<float>::max();
+
+// parked instances are moved this far (in meters) below the local origin,
+// well out of sight.
+static const double kParkedDepth = 100000.0;
 
 void
 Obj8Attachment::loadCallback(XPLMObjectRef inObject, void *inRefcon)
 {
-    auto *sThis = reinterpret_cast<Obj8Attachment *>(inRefcon);
+    ScopedPhaseTimer timer(RenderPhase::Obj8Load);
+    const auto id = reinterpret_cast<std::uintptr_t>(inRefcon);
+    auto loading = std::find_if(sLoading.begin(), sLoading.end(),
+                                [id](const LoadInFlight &load) { return load.id == id; });
+    Obj8Attachment *sThis = nullptr;
+    if (loading != sLoading.end()) {
+        sThis = loading->attachment;
+        sLoading.erase(loading);
+    }
+
+    // the attachment may have gone away whilst it was loading.
+    if (sThis == nullptr) {
+        if (inObject != nullptr) {
+            XPLMUnloadObject(inObject);
+        }
+        return;
+    }
 
     sThis->mHandle = inObject;
     if (nullptr == inObject) {
@@ -43,21 +76,15 @@ Obj8Attachment::loadCallback(XPLMObjectRef inObject, void *inRefcon)
     } else {
         XPLMDump() << XPMP_CLIENT_NAME << " did load obj8: " << sThis->mFile << "\n";
         sThis->mLoadState = Obj8LoadState::Loaded;
-    }
-
-    if (!loadQueue.empty()) {
-        Obj8Attachment *nextAtt = nullptr;
-        nextAtt = loadQueue.front();
-        loadQueue.pop();
-        if (nextAtt) {
-            XPLMLoadObjectAsync(nextAtt->mFile.c_str(), &Obj8Attachment::loadCallback, reinterpret_cast<void *>(nextAtt));
-        }
+        sThis->mLastUsed = sNow;
+        sLoaded.push_back(sThis);
     }
 }
 
 std::shared_ptr<Obj8Attachment>
 Obj8Attachment::getAttachmentForFile(const std::string &filename)
 {
+    std::lock_guard<std::mutex> lock(sAttachmentCacheMutex);
     auto wpIter = sAttachmentCache.find(filename);
     if (wpIter != sAttachmentCache.end()) {
         auto sp = wpIter->second.lock();
@@ -71,26 +98,216 @@ Obj8Attachment::getAttachmentForFile(const std::string &filename)
 }
 
 void
-Obj8Attachment::enqueueLoad() {
-    if (mLoadState != Obj8LoadState::None) {
+Obj8Attachment::requestLoad(float distanceSqr)
+{
+    if (mFile.empty()) {
         return;
     }
-    if (mFile.empty()) {
+    if (mLoadState == Obj8LoadState::None) {
+        mLoadState = Obj8LoadState::Queued;
+        sLoadQueue.push_back(this);
+    } else if (mRequestFrame == sLoadFrame) {
+        // several planes have asked this frame - the closest one counts.
+        distanceSqr = std::min(distanceSqr, mRequestDistanceSqr);
+    }
+    mRequestDistanceSqr = distanceSqr;
+    mRequestedAt = sNow;
+    mRequestFrame = sLoadFrame;
+}
+
+void
+Obj8Attachment::processLoadQueue(int maxInFlight)
+{
+    sLoadFrame++;
+
+    // drop the requests from planes that have gone away (or no longer want
+    // the object), so they can't hold up the ones that are still wanted.
+    sLoadQueue.erase(std::remove_if(sLoadQueue.begin(), sLoadQueue.end(),
+                                    [](Obj8Attachment *a) {
+                                        const float age = sNow - a->mRequestedAt;
+                                        if (age >= 0.0f && age < kMaxRequestAge) {
+                                            return false;
+                                        }
+                                        a->mLoadState = Obj8LoadState::None;
+                                        return true;
+                                    }),
+                     sLoadQueue.end());
+
+    size_t toStart = sLoadQueue.size();
+    if (maxInFlight > 0) {
+        const auto limit = static_cast<size_t>(maxInFlight);
+        toStart = (sLoading.size() >= limit) ? 0 : std::min(toStart, limit - sLoading.size());
+    }
+    if (toStart == 0) {
         return;
     }
-    mLoadState = Obj8LoadState::Loading;
-    if (loadQueue.empty()) {
-        XPLMLoadObjectAsync(mFile.c_str(), &Obj8Attachment::loadCallback, reinterpret_cast<void *>(this));
-    } else {
-        loadQueue.push(this);
+    std::partial_sort(sLoadQueue.begin(), sLoadQueue.begin() + toStart, sLoadQueue.end(),
+                      [](const Obj8Attachment *a, const Obj8Attachment *b) {
+                          return a->mRequestDistanceSqr < b->mRequestDistanceSqr;
+                      });
+    for (size_t i = 0; i < toStart; i++) {
+        auto *attachment = sLoadQueue[i];
+        attachment->mLoadState = Obj8LoadState::Loading;
+        const auto id = sNextLoadId++;
+        sLoading.push_back(LoadInFlight{id, attachment});
+        XPLMLoadObjectAsync(attachment->mFile.c_str(), &Obj8Attachment::loadCallback, reinterpret_cast<void *>(id));
     }
-};
+    sLoadQueue.erase(sLoadQueue.begin(), sLoadQueue.begin() + toStart);
+}
 
 
-Obj8Attachment::~Obj8Attachment()
+XPLMInstanceRef
+Obj8Attachment::acquireInstance()
+{
+    XPLMInstanceRef instance = nullptr;
+    if (!mIdle.empty()) {
+        instance = mIdle.back().instance;
+        mIdle.pop_back();
+    } else if (mLoadState == Obj8LoadState::Loaded) {
+        if (sCreationsLeft > 0) {
+            sCreationsLeft--;
+        }
+        instance = XPLMCreateInstance(mHandle, Obj8CSL::dref_names);
+    }
+    if (instance != nullptr) {
+        mActiveInstances++;
+        mLastUsed = sNow;
+    }
+    return instance;
+}
+
+void
+Obj8Attachment::setCreationBudget(int budget)
 {
+    sCreationsLeft = (budget > 0) ? budget : -1;
+    sCreationCutoffSqr = std::numeric_limits<float>::max();
+}
+
+void
+Obj8Attachment::parkInstance(XPLMInstanceRef instance)
+{
+    if (instance == nullptr) {
+        return;
+    }
+    XPLMDrawInfo_t parked = {};
+    parked.structSize = sizeof(parked);
+    parked.y = static_cast<float>(-kParkedDepth);
+    const float dataRefValues[Obj8DataRefCount] = {};
+    XPLMInstanceSetPosition(instance, &parked, dataRefValues);
+
+    if (mIdle.empty()) {
+        sPooled.push_back(this);
+    }
+    mIdle.push_back(IdleInstance{instance, sNow});
+    if (mActiveInstances > 0) {
+        mActiveInstances--;
+    }
+    mLastUsed = sNow;
+}
+
+void
+Obj8Attachment::unload()
+{
+    if (!mIdle.empty()) {
+        for (const auto &idle: mIdle) {
+            XPLMDestroyInstance(idle.instance);
+        }
+        mIdle.clear();
+        sPooled.erase(std::remove(sPooled.begin(), sPooled.end(), this), sPooled.end());
+    }
     if (mHandle != nullptr) {
         XPLMUnloadObject(mHandle);
-        mLoadState = Obj8LoadState::None;
+        mHandle = nullptr;
+    }
+    mLoadState = Obj8LoadState::None;
+}
+
+void
+Obj8Attachment::evictUnusedObjects(int maxLoaded)
+{
+    if (maxLoaded <= 0 || sLoaded.size() <= static_cast<size_t>(maxLoaded)) {
+        return;
+    }
+    // the loaded objects are kept in no particular order, so gather up the
+    // ones that could go and take the least recently used.
+    std::vector<Obj8Attachment *> unused;
+    for (auto *attachment: sLoaded) {
+        const float unusedFor = sNow - attachment->mLastUsed;
+        if (attachment->mActiveInstances == 0 && (unusedFor >= kMinUnusedTime || unusedFor < 0.0f)) {
+            unused.push_back(attachment);
+        }
+    }
+    const size_t evictCount = std::min(unused.size(), sLoaded.size() - static_cast<size_t>(maxLoaded));
+    if (evictCount == 0) {
+        return;
+    }
+    std::partial_sort(unused.begin(), unused.begin() + evictCount, unused.end(),
+                      [](const Obj8Attachment *a, const Obj8Attachment *b) {
+                          return a->mLastUsed < b->mLastUsed;
+                      });
+    unused.resize(evictCount);
+    for (auto *attachment: unused) {
+        XPLMDump() << XPMP_CLIENT_NAME << " unloading unused obj8: " << attachment->mFile << "\n";
+        attachment->unload();
+    }
+    sLoaded.erase(std::remove_if(sLoaded.begin(), sLoaded.end(),
+                                 [](const Obj8Attachment *a) { return a->mLoadState != Obj8LoadState::Loaded; }),
+                  sLoaded.end());
+}
+
+void
+Obj8Attachment::trimIdle(float now)
+{
+    // the pool is oldest first, so the expired and excess instances are all
+    // at the front.
+    size_t expired = 0;
+    while (expired < mIdle.size() &&
+           (now - mIdle[expired].parkedAt >= kMaxIdleTime || now < mIdle[expired].parkedAt)) {
+        expired++;
+    }
+    if (mIdle.size() - expired > kMaxIdleInstances) {
+        expired = mIdle.size() - kMaxIdleInstances;
+    }
+    for (size_t i = 0; i < expired; i++) {
+        XPLMDestroyInstance(mIdle[i].instance);
+    }
+    mIdle.erase(mIdle.begin(), mIdle.begin() + expired);
+}
+
+void
+Obj8Attachment::trimIdleInstances(float now)
+{
+    sNow = now;
+    for (auto *attachment: sPooled) {
+        attachment->trimIdle(now);
+    }
+    sPooled.erase(std::remove_if(sPooled.begin(), sPooled.end(),
+                                 [](const Obj8Attachment *a) { return a->mIdle.empty(); }),
+                  sPooled.end());
+}
+
+void
+Obj8Attachment::destroyIdleInstances()
+{
+    for (auto *attachment: sPooled) {
+        for (const auto &idle: attachment->mIdle) {
+            XPLMDestroyInstance(idle.instance);
+        }
+        attachment->mIdle.clear();
+    }
+    sPooled.clear();
+}
+
+Obj8Attachment::~Obj8Attachment()
+{
+    // a load that's running is orphaned - it still counts against the loads
+    // in flight until loadCallback() cleans up after it.
+    sLoadQueue.erase(std::remove(sLoadQueue.begin(), sLoadQueue.end(), this), sLoadQueue.end());
+    for (auto &load: sLoading) {
+        if (load.attachment == this) {
+            load.attachment = nullptr;
+        }
     }
+    sLoaded.erase(std::remove(sLoaded.begin(), sLoaded.end(), this), sLoaded.end());
+    unload();
 }
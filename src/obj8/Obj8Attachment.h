@@ -25,23 +25,50 @@
 #ifndef OBJ8ATTACHMENT_H
 #define OBJ8ATTACHMENT_H
 
+#include <cstdint>
 #include <string>
 #include <utility>
-#include <queue>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
+#include <XPLMInstance.h>
 #include <XPLMScenery.h>
 
 #include "Obj8Common.h"
 
 /** Obj8Attachment is a single obj8 component loaded and ready for rendering.
+ *
+ * Objects are loaded asynchronously, on request.  Requests wait in a queue
+ * ordered by the distance of the closest plane asking for the object, and
+ * processLoadQueue() starts the closest few each frame.  A request that
+ * nobody has repeated for kMaxRequestAge seconds is dropped.
+ *
+ * Loaded objects that no plane has used for at least kMinUnusedTime seconds
+ * may be unloaded again, least recently used first, by evictUnusedObjects()
+ * to keep the number loaded within a budget.  They're loaded again if
+ * they're asked for.
+ *
+ * It also keeps a pool of idle instances of the object.  Planes park the
+ * instances they no longer need (out of sight) instead of destroying them,
+ * and the next plane to need the object takes one from the pool rather than
+ * creating a new one.  Instances that sit idle for more than kMaxIdleTime
+ * seconds, or beyond the first kMaxIdleInstances, are destroyed by
+ * trimIdleInstances().
+ *
+ * Creating instances (rather than reusing parked ones) is limited to a
+ * per-frame budget, which can be restricted to the closest planes with
+ * setCreationCutoff().
  */
 class Obj8Attachment {
 public:
     /** use this to construct Obj8Attachments - it'll handle deduplication if
      * necessary.
      *
+     * This is safe to call from any thread, so CSL packages can be parsed in
+     * parallel.
+     *
      * @param filename POSIX path to the obj8 to load
      * @return a std::shared_ptr for the requested obj8 attachment
      */
@@ -49,27 +76,23 @@ public:
 
 	Obj8Attachment(const Obj8Attachment &copySrc) = delete;
 
-	Obj8Attachment(Obj8Attachment &&moveSrc) noexcept:
-            mFile(std::move(moveSrc.mFile)),
-            mHandle(nullptr),
-            mLoadState(Obj8LoadState::None)
-    {
-        mHandle = moveSrc.mHandle;
-        moveSrc.mHandle = nullptr;
-
-        mLoadState = moveSrc.mLoadState;
-        moveSrc.mLoadState = Obj8LoadState::None;
-    }
+	Obj8Attachment(Obj8Attachment &&moveSrc) = delete;
 
 	virtual ~Obj8Attachment();
 
-	/** try to get the object handle.  Queue it for loading if it's not available.
+	/** try to get the object handle.  Queue it for loading if it's not
+	 * available - or if it's already queued, bring it forward if the caller is
+	 * closer than the others asking for it.
+	 *
+	 * @param distanceSqr the square of the distance from the camera to the
+	 *   plane that wants the object
 	 * @returns The XPLMObjectRef for this attachment
 	 */
-	XPLMObjectRef	getObjectHandle() {
+	XPLMObjectRef	getObjectHandle(float distanceSqr) {
         switch (mLoadState) {
             case Obj8LoadState::None:
-                enqueueLoad();
+            case Obj8LoadState::Queued:
+                requestLoad(distanceSqr);
                 return nullptr;
             case Obj8LoadState::Loaded:
                 return mHandle;
@@ -84,24 +107,143 @@ public:
 	    return mLoadState;
 	}
 
+	/** returns the path of the obj8, relative to the X-Plane folder */
+	const std::string & getFile() const {
+	    return mFile;
+	}
+
+    /** how long (in seconds) a parked instance is kept for */
+    static constexpr float kMaxIdleTime = 30.0f;
+    /** the most parked instances kept for each attachment */
+    static const size_t kMaxIdleInstances = 64;
+
+    /** how long (in seconds) a load request is kept without being repeated */
+    static constexpr float kMaxRequestAge = 2.0f;
+
+    /** processLoadQueue drops the load requests nobody has repeated
+     * recently, then starts loading the closest of the rest until there are
+     * maxInFlight loads running.  Called once per frame.
+     *
+     * @param maxInFlight the most loads to have running at once, or 0 for no
+     *   limit
+     */
+    static void         processLoadQueue(int maxInFlight);
+
+    /** how long (in seconds) an object must go unused before it's evicted */
+    static constexpr float kMinUnusedTime = 10.0f;
+
+    /** evictUnusedObjects unloads the least recently used objects that have
+     * no instances in use, along with any instances of them that are
+     * parked, until no more than maxLoaded objects are loaded.  Called once
+     * per frame.
+     *
+     * @param maxLoaded the most objects to keep loaded, or 0 for no limit
+     */
+    static void         evictUnusedObjects(int maxLoaded);
+
+    /** acquireInstance returns an instance of the object, reusing a parked
+     * one if there is one.  If the object isn't loaded yet, nullptr is
+     * returned - use getObjectHandle() to ask for it to be loaded.
+     *
+     * Creating a new instance counts against the creation budget, but isn't
+     * refused - check canCreateInstances() first.
+     *
+     * The instance must be positioned before it's next drawn.
+     */
+    XPLMInstanceRef     acquireInstance();
+
+    /** returns true if acquireInstance() can reuse a parked instance */
+    bool                hasIdleInstances() const { return !mIdle.empty(); }
+
+    /** setCreationBudget resets the creation budget and cutoff for a new
+     * frame.
+     *
+     * @param budget the most instances to create this frame, or 0 for no limit
+     */
+    static void         setCreationBudget(int budget);
+
+    /** setCreationCutoff stops planes further than sqrt(distanceSqr) meters
+     * from the camera from creating instances for the rest of the frame.
+     */
+    static void         setCreationCutoff(float distanceSqr) { sCreationCutoffSqr = distanceSqr; }
+
+    /** canCreateInstances returns true if a plane sqrt(distanceSqr) meters
+     * from the camera may create count new instances - i.e. they fit in
+     * what's left of the budget, and it's within the cutoff.
+     */
+    static bool         canCreateInstances(float distanceSqr, int count)
+    {
+        return sCreationsLeft < 0 || (count <= sCreationsLeft && distanceSqr <= sCreationCutoffSqr);
+    }
+
+    /** parkInstance moves an instance acquired from this attachment out of
+     * sight and keeps it for reuse.
+     */
+    void                parkInstance(XPLMInstanceRef instance);
+
+    /** trimIdleInstances destroys the parked instances (of every attachment)
+     * that are over the limits.  Called once per frame.
+     *
+     * @param now the simulator time in seconds
+     */
+    static void         trimIdleInstances(float now);
+
+    /** destroyIdleInstances destroys every parked instance */
+    static void         destroyIdleInstances();
+
 protected:
 	std::string			mFile;
 	XPLMObjectRef		mHandle;
 	Obj8LoadState		mLoadState;
+	float				mRequestDistanceSqr;	// the closest requester's distance, while queued
+	float				mRequestedAt;			// when the load was last requested
+	unsigned int		mRequestFrame;			// the processLoadQueue frame the load was last requested in
+	int					mActiveInstances;		// instances acquired and not yet parked
+	float				mLastUsed;				// when an instance was last acquired or parked
+
+	struct IdleInstance {
+	    XPLMInstanceRef     instance;
+	    float               parkedAt;
+	};
+	std::vector<IdleInstance>	mIdle;	// oldest first
 
     explicit Obj8Attachment(std::string fileName):
         mFile(std::move(fileName)),
         mHandle(nullptr),
-        mLoadState(Obj8LoadState::None)
+        mLoadState(Obj8LoadState::None),
+        mRequestDistanceSqr(0.0f),
+        mRequestedAt(0.0f),
+        mRequestFrame(0),
+        mActiveInstances(0),
+        mLastUsed(0.0f)
     {
     }
 
 
 private:
     static std::unordered_map<std::string,std::weak_ptr<Obj8Attachment>> sAttachmentCache;
+    static std::mutex   sAttachmentCacheMutex;
     static void	loadCallback(XPLMObjectRef inObject, void *inRefcon);
-    static std::queue<Obj8Attachment *>	loadQueue;
-    void enqueueLoad();
+    static std::vector<Obj8Attachment *>    sLoadQueue;     // the attachments in the Queued state
+    // a load that's running.  XPLM is handed the id rather than the
+    // attachment, as the attachment may be gone (and another made in it's
+    // place) by the time the load finishes.
+    struct LoadInFlight {
+        std::uintptr_t      id;
+        Obj8Attachment *    attachment;     // nullptr once orphaned
+    };
+    static std::vector<LoadInFlight>        sLoading;       // the loads running, orphaned or not
+    static std::uintptr_t                   sNextLoadId;
+    static unsigned int                     sLoadFrame;     // bumped by each processLoadQueue
+    static std::vector<Obj8Attachment *>    sLoaded;        // the attachments in the Loaded state
+    void requestLoad(float distanceSqr);
+
+    static std::vector<Obj8Attachment *>    sPooled;    // the attachments with parked instances
+    static float                            sNow;       // the time passed to the last trimIdleInstances
+    static int                              sCreationsLeft;     // < 0 if unlimited
+    static float                            sCreationCutoffSqr;
+    void trimIdle(float now);
+    void unload();
 };
 
 #endif //OBJ8ATTACHMENT_H
@@ -55,6 +55,8 @@ const char * Obj8CSL::dref_names[] = {
 	"libxplanemp/controls/nav_lites_on",
 	nullptr
 };
+static_assert(sizeof(Obj8CSL::dref_names) / sizeof(Obj8CSL::dref_names[0]) == Obj8DataRefCount + 1,
+	"Obj8DataRefCount must match the number of animation datarefs");
 
 std::vector<float> Obj8CSL::dref_values;
 
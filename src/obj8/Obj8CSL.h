@@ -72,6 +72,8 @@ public:
 
     std::string getModelName() const override;
 
+    const std::string &getObjectName() const { return mObjectName; }
+
     std::string getModelType() const override;
 
     static void Init();
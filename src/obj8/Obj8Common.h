@@ -32,8 +32,12 @@ enum class Obj8DrawType {
 };
 const size_t Obj8DrawTypeCount=3;
 
+// the number of animation datarefs we feed to each instance (see Obj8CSL::dref_names)
+const size_t Obj8DataRefCount=16;
+
 enum class Obj8LoadState {
 	None = 0,		// not loaded, no attempt yet.
+	Queued,			// waiting for it's turn to load.
 	Loading,		// async load requested.
 	Loaded,			// (a)sync load complete
 	Failed			// (a)sync load failed
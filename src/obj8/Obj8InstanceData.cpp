@@ -30,11 +30,9 @@
 #include "Obj8CSL.h"
 
 void
-Obj8InstanceData::updateInstance(
+Obj8InstanceData::prepareInstance(
     CSL *csl,
-    double x,
-    double y,
-    double z,
+    const FrameContext &frame,
     double pitch,
     double roll,
     double heading,
@@ -44,95 +42,241 @@ Obj8InstanceData::updateInstance(
     auto *myCSL = dynamic_cast<Obj8CSL *>(csl);
     assert(myCSL != nullptr);
 
-    // determine which instance type we want.
-    //FIXME: use lowlod + lights as appropriate.
-    Obj8DrawType desiredObj = Obj8DrawType::Solid;
-	auto fullRenderDistance = gConfiguration.maxFullAircraftRenderingDistance * 1000.0f;
-    if (mDistanceSqr > (fullRenderDistance * fullRenderDistance)) {
-        desiredObj = Obj8DrawType::LightsOnly;
-        if (!myCSL->hasAttachmentsFor(desiredObj)) {
-            desiredObj = Obj8DrawType::LowLevelOfDetail;
-            if (!myCSL->hasAttachmentsFor(desiredObj)) {
-                desiredObj = Obj8DrawType::Solid;
-            }
+    mDesiredDrawType = desiredDrawType(myCSL);
+    mPrefetchSolid = (mDesiredDrawType != Obj8DrawType::Solid) && mLod.wantsPrefetch(frame);
+
+    // build the state objects.
+    mDrawInfo.structSize = sizeof(mDrawInfo);
+    mDrawInfo.heading = heading;
+    mDrawInfo.pitch = pitch;
+    mDrawInfo.roll = roll;
+
+    // these must be in the same order as defined by dref_names
+    mDataRefValues[0] = state->gearPosition;
+    mDataRefValues[1] = state->flapRatio;
+    mDataRefValues[2] = state->spoilerRatio;
+    mDataRefValues[3] = state->speedBrakeRatio;
+    mDataRefValues[4] = state->slatRatio;
+    mDataRefValues[5] = state->wingSweep;
+    mDataRefValues[6] = state->thrust;
+    mDataRefValues[7] = state->yokePitch;
+    mDataRefValues[8] = state->yokeHeading;
+    mDataRefValues[9] = state->yokeRoll;
+    mDataRefValues[10] = static_cast<float>((state->thrust < 0.0) ? 1.0 : 0.0);
+    mDataRefValues[11] = static_cast<float>(lights.taxiLights);
+    mDataRefValues[12] = static_cast<float>(lights.landLights);
+    mDataRefValues[13] = static_cast<float>(lights.bcnLights);
+    mDataRefValues[14] = static_cast<float>(lights.strbLights);
+    mDataRefValues[15] = static_cast<float>(lights.navLights);
+}
+
+Obj8DrawType
+Obj8InstanceData::desiredDrawType(const Obj8CSL *csl) const
+{
+    // determine which instance type we want.  The reduced band prefers the
+    // low LOD model, and the distant band the lights alone, but either will
+    // make do with the other, and failing that, the full model.
+    switch (mLod.getBand()) {
+    case LodBand::Full:
+        break;
+    case LodBand::Reduced:
+        if (csl->hasAttachmentsFor(Obj8DrawType::LowLevelOfDetail)) {
+            return Obj8DrawType::LowLevelOfDetail;
+        }
+        if (csl->hasAttachmentsFor(Obj8DrawType::LightsOnly)) {
+            return Obj8DrawType::LightsOnly;
         }
+        break;
+    case LodBand::Distant:
+        if (csl->hasAttachmentsFor(Obj8DrawType::LightsOnly)) {
+            return Obj8DrawType::LightsOnly;
+        }
+        if (csl->hasAttachmentsFor(Obj8DrawType::LowLevelOfDetail)) {
+            return Obj8DrawType::LowLevelOfDetail;
+        }
+        break;
     }
+    return Obj8DrawType::Solid;
+}
+
+bool
+Obj8InstanceData::needsPrepare(CSL *csl, const FrameContext & /*frame*/) const
+{
+    auto *myCSL = static_cast<Obj8CSL *>(csl);
+    return desiredDrawType(myCSL) != mDesiredDrawType;
+}
+
+void
+Obj8InstanceData::applyInstance(CSL *csl)
+{
+    auto *myCSL = static_cast<Obj8CSL *>(csl);
 
     // Handle each drawtype individually... (there's only three)
-    if (desiredObj == Obj8DrawType::Solid) {
-        instancePartsForType(myCSL, Obj8DrawType::Solid);
+    //
+    // If the creation budget won't stretch to the desired type this frame,
+    // the plane keeps whatever it's drawn with now until it does.
+    mCreationDeferred = false;
+    const auto drawnType = (mDesiredDrawType == Obj8DrawType::Solid) ?
+        Obj8DrawType::LowLevelOfDetail : Obj8DrawType::Solid;
+    if (mDesiredDrawType == Obj8DrawType::LightsOnly) {
+        // the body stays until the lights are actually there to replace it.
+        if (!instancePartsForType(myCSL, Obj8DrawType::LightsOnly)) {
+            mCreationDeferred = true;
+        } else if (hasPartsForType(Obj8DrawType::LightsOnly)) {
+            resetPartsForType(myCSL, Obj8DrawType::Solid);
+            resetPartsForType(myCSL, Obj8DrawType::LowLevelOfDetail);
+        }
     } else {
-        resetPartsForType(myCSL,Obj8DrawType::Solid);
+        if (instancePartsForType(myCSL, mDesiredDrawType)) {
+            resetPartsForType(myCSL, drawnType);
+        } else {
+            mCreationDeferred = true;
+        }
+        if (!instancePartsForType(myCSL, Obj8DrawType::LightsOnly)) {
+            mCreationDeferred = true;
+        }
     }
-    if (desiredObj == Obj8DrawType::LowLevelOfDetail) {
-        instancePartsForType(myCSL, Obj8DrawType::LowLevelOfDetail);
-    } else {
-        resetPartsForType(myCSL, Obj8DrawType::LowLevelOfDetail);
+    if (mPrefetchSolid) {
+        prefetchPartsForType(myCSL, Obj8DrawType::Solid);
     }
-    instancePartsForType(myCSL, Obj8DrawType::LightsOnly);
 
-    // build the state objects.
-    XPLMDrawInfo_t objPosition = {};
+    // if anything is still loading, we have to come back and try again.
+    mPending = false;
+    for (const auto &instanceSet: mInstances) {
+        for (const auto &instance: instanceSet) {
+            if (instance == nullptr) {
+                mPending = true;
+            }
+        }
+    }
 
-    objPosition.structSize = sizeof(objPosition);
-    objPosition.x = x;
-    objPosition.y = y;
-    objPosition.z = z;
-    objPosition.heading = heading;
-    objPosition.pitch = pitch;
-    objPosition.roll = roll;
+    // the position may have been adjusted by surface clamping since we were prepared.
+    mDrawInfo.x = mX;
+    mDrawInfo.y = mY;
+    mDrawInfo.z = mZ;
 
-    // these must be in the same order as defined by dref_names
-    float dataRefValues[] = {
-        state->gearPosition,
-        state->flapRatio,
-        state->spoilerRatio,
-        state->speedBrakeRatio,
-        state->slatRatio,
-        state->wingSweep,
-        state->thrust,
-        state->yokePitch,
-        state->yokeHeading,
-        state->yokeRoll,
-        static_cast<float>((state->thrust < 0.0) ? 1.0 : 0.0),
-        static_cast<float>(lights.taxiLights),
-        static_cast<float>(lights.landLights),
-        static_cast<float>(lights.bcnLights),
-        static_cast<float>(lights.strbLights),
-        static_cast<float>(lights.navLights)
-    };
     for (auto &instanceSet: mInstances) {
         for (auto &instance: instanceSet) {
             if (instance) {
-                XPLMInstanceSetPosition(instance, &objPosition, dataRefValues);
+                XPLMInstanceSetPosition(instance, &mDrawInfo, mDataRefValues);
             }
         }
     }
 }
 
+void
+Obj8InstanceData::releaseInstance(CSL *)
+{
+    resetModel();
+}
+
+void
+Obj8InstanceData::prefetchPartsForType(const Obj8CSL *csl, Obj8DrawType drawType)
+{
+    auto attSet = csl->getAttachmentsFor(drawType);
+    if (attSet == nullptr) {
+        return;
+    }
+    for (const auto &attachment: *attSet) {
+        attachment->getObjectHandle(mDistanceSqr);
+    }
+}
+
+int
+Obj8InstanceData::countNewInstances(CSL *csl) const
+{
+    auto *myCSL = static_cast<Obj8CSL *>(csl);
+    int count = countNewInstancesForType(myCSL, Obj8DrawType::LightsOnly);
+    if (mDesiredDrawType != Obj8DrawType::LightsOnly) {
+        count += countNewInstancesForType(myCSL, mDesiredDrawType);
+    }
+    return count;
+}
+
+bool
+Obj8InstanceData::hasPartsForType(Obj8DrawType drawType) const
+{
+    for (const auto &instance: mInstances[static_cast<int>(drawType)]) {
+        if (instance == nullptr) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int
+Obj8InstanceData::countNewInstancesForType(const Obj8CSL *csl, Obj8DrawType drawType) const
+{
+    auto attSet = csl->getAttachmentsFor(drawType);
+    if (attSet == nullptr) {
+        return 0;
+    }
+    // if the set has changed, all of it's instances are new.
+    const auto instIdx = static_cast<int>(drawType);
+    const bool sameSet = (mInstanceSetPtrs[instIdx] == static_cast<const void *>(attSet));
+    int count = 0;
+    for (size_t i = 0; i < attSet->size(); i++) {
+        const auto &attachment = (*attSet)[i];
+        if (sameSet && mInstances[instIdx][i] != nullptr) {
+            continue;
+        }
+        if (attachment->getLoadState() == Obj8LoadState::Loaded && !attachment->hasIdleInstances()) {
+            count++;
+        }
+    }
+    return count;
+}
+
 void
 Obj8InstanceData::resetPartsForType(const Obj8CSL *, Obj8DrawType drawType)
 {
+    // the instances go back to their attachments' pools for the next plane.
     const auto instIdx = static_cast<int>(drawType);
-    for (auto &instance: mInstances[instIdx]) {
-        XPLMDestroyInstance(instance);
-        instance = nullptr;
+    const auto *attSet = static_cast<const Obj8CSL::attachment_array *>(mInstanceSetPtrs[instIdx]);
+    auto &instances = mInstances[instIdx];
+    for (size_t i = 0; i < instances.size(); i++) {
+        if (instances[i] == nullptr) {
+            continue;
+        }
+        if (attSet != nullptr && i < attSet->size()) {
+            (*attSet)[i]->parkInstance(instances[i]);
+        } else {
+            XPLMDestroyInstance(instances[i]);
+        }
+        instances[i] = nullptr;
     }
-    mInstances[instIdx].clear();
+    instances.clear();
     mInstanceSetPtrs[instIdx] = nullptr;
 }
 
-void
+bool
 Obj8InstanceData::instancePartsForType(const Obj8CSL *csl,
                                        Obj8DrawType drawType)
 {
     auto attSet = csl->getAttachmentsFor(drawType);
     if (attSet == nullptr || attSet->empty()) {
         resetPartsForType(nullptr, drawType);
-        return;
+        return true;
     }
 
     const auto instIdx = static_cast<int>(drawType);
+    const bool sameSet = (mInstanceSetPtrs[instIdx] == static_cast<const void *>(attSet));
+
+    // all or nothing - a set half made would draw half a plane.  Objects
+    // that aren't loaded yet don't count, but are queued for loading.
+    int newInstances = 0;
+    for (size_t i = 0; i < attSet->size(); i++) {
+        const auto &attachment = (*attSet)[i];
+        if (sameSet && mInstances[instIdx][i] != nullptr) {
+            continue;
+        }
+        if (attachment->getObjectHandle(mDistanceSqr) != nullptr && !attachment->hasIdleInstances()) {
+            newInstances++;
+        }
+    }
+    if (newInstances > 0 && !Obj8Attachment::canCreateInstances(mDistanceSqr, newInstances)) {
+        return false;
+    }
 
     if (mInstanceSetPtrs[instIdx] != static_cast<const void *>(attSet)) {
         // flush the instances we need to recreate them as the set has changed.
@@ -145,13 +289,10 @@ Obj8InstanceData::instancePartsForType(const Obj8CSL *csl,
     const auto &attachments = *attSet;
     for (unsigned int i = 0; i < attachments.size(); i++) {
         if (instances[i] == nullptr) {
-        	auto *objHandle = attachments[i]->getObjectHandle();
-        	if (nullptr != objHandle) {
-				instances[i] = XPLMCreateInstance(attachments[i]->getObjectHandle(),
-					                              Obj8CSL::dref_names);
-            }
+            instances[i] = attachments[i]->acquireInstance();
         }
     }
+    return true;
 }
 
 void
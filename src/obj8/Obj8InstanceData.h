@@ -31,17 +31,27 @@
 #include "Obj8Attachment.h"
 #include "CSL.h"
 
+class Obj8CSL;
+
 /** a single renderable instance of a Obj8CSL */
 class Obj8InstanceData : public CSLInstanceData {
 public:
     const void *  mInstanceSetPtrs[Obj8DrawTypeCount];
     std::vector<XPLMInstanceRef> mInstances[Obj8DrawTypeCount];
 
+    // prepared state - populated by prepareInstance, consumed by applyInstance
+    Obj8DrawType    mDesiredDrawType = Obj8DrawType::Solid;
+    bool            mPrefetchSolid = false;     // load the solid parts ahead of the plane coming into range
+    XPLMDrawInfo_t  mDrawInfo;
+    float           mDataRefValues[Obj8DataRefCount];
+
     //std::deque<std::pair<Obj8Attachment*,XPLMInstanceRef>>     mInstances;
 
 	Obj8InstanceData():
 	    mInstanceSetPtrs{nullptr,},
-	    mInstances{}
+	    mInstances{},
+	    mDrawInfo{},
+	    mDataRefValues{}
     {};
 
 	virtual ~Obj8InstanceData() {
@@ -51,22 +61,48 @@ public:
 	friend class Obj8CSL;
 
 protected:
-	void updateInstance(
+	void prepareInstance(
 		CSL *csl,
-		double x,
-		double y,
-		double z,
+		const FrameContext &frame,
 		double pitch,
 		double roll,
 		double heading,
 		xpmp_LightStatus lights,
 		XPLMPlaneDrawState_t *state) override;
 
+	void applyInstance(CSL *csl) override;
+
+	void releaseInstance(CSL *csl) override;
+
+	bool needsPrepare(CSL *csl, const FrameContext &frame) const override;
+
+	int countNewInstances(CSL *csl) const override;
+
 	void resetPartsForType(const Obj8CSL *csl, Obj8DrawType drawType);
-	void instancePartsForType(const Obj8CSL *csl, Obj8DrawType drawType);
+
+	/** makes sure there's an instance for each of the parts of drawType.
+	 *
+	 * @return false if the creation budget wouldn't allow it, in which case
+	 *   nothing is changed.
+	 */
+	bool instancePartsForType(const Obj8CSL *csl, Obj8DrawType drawType);
 
 private:
 	void resetModel();
+
+	/** returns the draw type to use for the current distance */
+	Obj8DrawType desiredDrawType(const Obj8CSL *csl) const;
+
+	/** queues the parts of drawType that aren't loaded for loading */
+	void prefetchPartsForType(const Obj8CSL *csl, Obj8DrawType drawType);
+
+	/** returns true if every part of drawType has it's instance - none of
+	 * them are still waiting for their object to load.
+	 */
+	bool hasPartsForType(Obj8DrawType drawType) const;
+
+	/** returns the number of instances instancePartsForType would create */
+	int countNewInstancesForType(const Obj8CSL *csl, Obj8DrawType drawType) const;
 };
 
 #endif //OBJ8INSTANCEDATA_H